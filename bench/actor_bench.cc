@@ -0,0 +1,504 @@
+#include <vector>
+#include <cstdlib>
+
+#include "./bench.h"
+
+#include "../src/message.h"
+#include "../src/compound_message.h"
+#include "../src/actor.h"
+#include "../src/actor_batch.h"
+#include "../src/director.h"
+
+using namespace ActorModel;
+
+
+/*
+ * Message and CompoundMessage benchmarks
+ *
+ * These run between ranks 0 and 1. Any other ranks sit them out.
+ */
+
+// Bounce a message of the given size between ranks 0 and 1.
+struct MessagePingPong {
+    MessagePingPong(int bytes_in, int rounds_in):
+        bytes(bytes_in), rounds(rounds_in)
+    {}
+
+    void operator()(void) {
+        int rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        if(rank > 1) return;
+
+        std::vector<char> data(bytes);
+        Message message;
+        bool wait = true;
+
+        for(int i=0; i<rounds; i++) {
+            if(rank == 0) {
+                Message::send<char>(1, 0, &data[0], bytes, MPI_COMM_WORLD);
+                message.receive(1, 0, MPI_COMM_WORLD, wait);
+            } else {
+                message.receive(0, 0, MPI_COMM_WORLD, wait);
+                Message::send<char>(0, 0, &data[0], bytes, MPI_COMM_WORLD);
+            }
+        }
+    }
+
+    int bytes;
+    int rounds;
+};
+
+// Stream messages of the given size from rank 0 to rank 1.
+struct MessageStream {
+    MessageStream(int bytes_in, int count_in):
+        bytes(bytes_in), count(count_in)
+    {}
+
+    void operator()(void) {
+        int rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        if(rank > 1) return;
+
+        std::vector<char> data(bytes);
+        Message message;
+        bool wait = true;
+
+        if(rank == 0) {
+            for(int i=0; i<count; i++) {
+                Message::send<char>(1, 0, &data[0], bytes, MPI_COMM_WORLD);
+            }
+
+            // Wait for the last message to be taken
+            message.receive(1, 0, MPI_COMM_WORLD, wait);
+        } else {
+            for(int i=0; i<count; i++) {
+                message.receive(0, 0, MPI_COMM_WORLD, wait);
+            }
+
+            int done = 1;
+            Message::send<int>(0, 0, done, MPI_COMM_WORLD);
+        }
+    }
+
+    int bytes;
+    int count;
+};
+
+// Bounce a compound message of the given data size between
+// ranks 0 and 1.
+struct CompoundMessagePingPong {
+    CompoundMessagePingPong(int bytes_in, int rounds_in):
+        bytes(bytes_in), rounds(rounds_in)
+    {}
+
+    void operator()(void) {
+        int rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        if(rank > 1) return;
+
+        std::vector<char> data(bytes);
+        Actor::Message::MetaData metadata = Actor::Message::MetaData();
+        CompoundMessage message;
+        int other = 1 - rank;
+
+        for(int i=0; i<rounds; i++) {
+            if(rank == 0) {
+                CompoundMessage::send_message<char, Actor::Message::MetaData>(
+                    other, 0, &data[0], bytes, &metadata, MPI_COMM_WORLD
+                );
+                while(!message.receive_message(other, 0, MPI_COMM_WORLD));
+            } else {
+                while(!message.receive_message(other, 0, MPI_COMM_WORLD));
+                CompoundMessage::send_message<char, Actor::Message::MetaData>(
+                    other, 0, &data[0], bytes, &metadata, MPI_COMM_WORLD
+                );
+            }
+        }
+    }
+
+    int bytes;
+    int rounds;
+};
+
+
+/*
+ * Actor benchmarks
+ *
+ * These run a whole Director, so they include the cost of scheduling
+ * and syncing directors.
+ */
+
+int bench_rounds = 0;
+
+// Answers every message with the same message, until told to stop.
+class PongActor: public Actor {
+public:
+    enum { PING, STOP };
+
+    void main(void) {
+        Message message;
+        while(get_message(&message)) {
+            if(message.tag() == STOP) {
+                die();
+                return;
+            }
+
+            send_message<int>(message.sender(), message.data<int>(), PING);
+        }
+
+        wait_for_message();
+    }
+};
+
+// Sends bench_rounds messages, one at a time, to a PongActor
+// on a given rank.
+template<int PONG_RANK>
+class PingActor: public Actor {
+public:
+    PingActor(): _received(-1) {}
+
+    void main(void) {
+        if(_received == -1) {
+            _pong = give_birth<PongActor>(PONG_RANK);
+            send_message<int>(_pong, 0, PongActor::PING);
+            _received = 0;
+        }
+
+        Message message;
+        while(get_message(&message)) {
+            _received++;
+
+            if(_received == bench_rounds) {
+                bool stop = true;
+                send_message<bool>(_pong, stop, PongActor::STOP);
+                die();
+                return;
+            }
+
+            send_message<int>(_pong, _received, PongActor::PING);
+        }
+
+        wait_for_message();
+    }
+
+private:
+    Id _pong;
+    int _received;
+};
+
+// Answers every message sent to it, until told to stop.
+class LeafActor: public PongActor {};
+
+// Sends a message to bench_leaves leaves and waits for all of them
+// to answer, bench_rounds times.
+int bench_leaves = 0;
+class HubActor: public Actor {
+public:
+    HubActor(): _round(-1), _received(0) {}
+
+    void main(void) {
+        if(_round == -1) {
+            for(int i=0; i<bench_leaves; i++) {
+                _leaves.push_back(give_birth<LeafActor>());
+            }
+
+            _round = 0;
+            fan_out();
+        }
+
+        Message message;
+        while(get_message(&message)) {
+            _received++;
+
+            if(_received < bench_leaves) continue;
+
+            _received = 0;
+            _round++;
+
+            if(_round == bench_rounds) {
+                bool stop = true;
+                for(size_t i=0; i<_leaves.size(); i++) {
+                    send_message<bool>(_leaves[i], stop, LeafActor::STOP);
+                }
+
+                die();
+                return;
+            }
+
+            fan_out();
+        }
+
+        wait_for_message();
+    }
+
+private:
+    void fan_out(void) {
+        for(size_t i=0; i<_leaves.size(); i++) {
+            send_message<int>(_leaves[i], _round, LeafActor::PING);
+        }
+    }
+
+    std::vector<Id> _leaves;
+    int _round;
+    int _received;
+};
+
+// Dies as soon as it is run.
+class ShortLivedActor: public Actor {
+public:
+    void main(void) {
+        die();
+    }
+};
+
+// Gives birth to bench_rounds short lived actors spread over all ranks.
+class ParentActor: public Actor {
+public:
+    void main(void) {
+        for(int i=0; i<bench_rounds; i++) {
+            give_birth<ShortLivedActor>();
+        }
+
+        die();
+    }
+};
+
+// Never does anything, and never dies.
+class IdleActor: public Actor {
+public:
+    void main(void) {}
+};
+
+// Moves a point along at a fixed velocity.
+class MoverActor: public Actor {
+public:
+    MoverActor(): x(0.0f), v(1.0f) {}
+
+    void main(void) {
+        x += v;
+    }
+
+    float x;
+    float v;
+};
+
+// Moves many points along at fixed velocities, as one actor.
+class MoverBatch: public ActorBatch {
+public:
+    void add(void) {
+        add_member();
+        x.push_back(0.0f);
+        v.push_back(1.0f);
+    }
+
+    void main(void) {
+        for(size_t i=0; i<x.size(); i++) {
+            x[i] += v[i];
+        }
+    }
+
+    void remove_member_data(size_t index) {
+        x[index] = x.back(); x.pop_back();
+        v[index] = v.back(); v.pop_back();
+    }
+
+    std::vector<float> x;
+    std::vector<float> v;
+};
+
+
+// Register every actor type used in the benchmarks, in the same
+// order on every process.
+void register_bench_actors(Director& director) {
+    director.register_actor<PongActor>();
+    director.register_actor<LeafActor>();
+    director.register_actor<ShortLivedActor>();
+}
+
+// Delete the actors added to a director, once it has been destroyed.
+template<class T>
+void delete_all(std::vector<T*>& actors) {
+    for(size_t i=0; i<actors.size(); i++) delete actors[i];
+    actors.clear();
+}
+
+// Run a Director with a single actor of type T on rank 0 until
+// every actor has died.
+template<class T>
+struct RunActor {
+    RunActor(int rounds_in, int leaves_in=0):
+        rounds(rounds_in), leaves(leaves_in)
+    {}
+
+    void operator()(void) {
+        bench_rounds = rounds;
+        bench_leaves = leaves;
+
+        // Actors added to a director are left for the caller to delete
+        T *actor = NULL;
+        {
+            Director director;
+            register_bench_actors(director);
+
+            if(director.is_root()) {
+                actor = director.add_actor<T>();
+            }
+
+            director.run();
+        }
+        delete actor;
+    }
+
+    int rounds;
+    int leaves;
+};
+
+// Run a Director with a number of idle actors on every rank for
+// a fixed number of ticks.
+struct DirectorTicks {
+    DirectorTicks(int actors_in, int ticks_in):
+        actors(actors_in), ticks(ticks_in)
+    {}
+
+    void operator()(void) {
+        std::vector<IdleActor*> idle_actors;
+        {
+            Director director;
+            register_bench_actors(director);
+
+            for(int i=0; i<actors; i++) {
+                idle_actors.push_back(director.add_actor<IdleActor>());
+            }
+
+            director.run(ticks);
+        }
+        delete_all(idle_actors);
+    }
+
+    int actors;
+    int ticks;
+};
+
+// Move a number of points on every rank, either as separate actors
+// or as a single batch, until every point has moved the given number
+// of times.
+template<bool BATCHED>
+struct MovePoints {
+    MovePoints(int points_in, int moves_in):
+        points(points_in), moves(moves_in)
+    {}
+
+    void operator()(void) {
+        std::vector<Actor*> movers;
+        {
+            Director director;
+            register_bench_actors(director);
+
+            if(BATCHED) {
+                MoverBatch *batch = director.add_actor<MoverBatch>();
+                for(int i=0; i<points; i++) batch->add();
+                movers.push_back(batch);
+
+                director.run(moves);
+            } else {
+                for(int i=0; i<points; i++) {
+                    movers.push_back(director.add_actor<MoverActor>());
+                }
+
+                director.run(moves*points);
+            }
+        }
+        delete_all(movers);
+    }
+
+    int points;
+    int moves;
+};
+
+
+int main(int argc, char* argv[]) {
+    Director::initialize(&argc, &argv);
+    Director::set_buffer_size(64*1024*1024);
+
+    if(argc > 1) bench_repeats = std::atoi(argv[1]);
+    if(argc > 2) bench_json = (std::string(argv[2]) == "json");
+
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    print_bench_header();
+
+    int message_sizes[] = {8, 1024, 65536};
+    for(int i=0; i<3 && size > 1; i++) {
+        int bytes = message_sizes[i];
+        int rounds = 1000;
+        int count = std::min(10000, 16*1024*1024/bytes);
+
+        run_bench(
+            "message_ping_pong", bytes, rounds,
+            MessagePingPong(bytes, rounds)
+        );
+        run_bench(
+            "message_stream", bytes, count,
+            MessageStream(bytes, count)
+        );
+        run_bench(
+            "compound_message_ping_pong", bytes, rounds,
+            CompoundMessagePingPong(bytes, rounds)
+        );
+    }
+
+    run_bench(
+        "actor_ping_pong_same_rank", 0, 1000,
+        RunActor<PingActor<0> >(1000)
+    );
+    if(size > 1) {
+        run_bench(
+            "actor_ping_pong_cross_rank", 0, 1000,
+            RunActor<PingActor<1> >(1000)
+        );
+    }
+
+    int leaf_counts[] = {4, 16, 64};
+    for(int i=0; i<3; i++) {
+        int leaves = leaf_counts[i];
+        int rounds = 100;
+
+        run_bench(
+            "fan_out_fan_in", leaves, rounds*leaves,
+            RunActor<HubActor>(rounds, leaves)
+        );
+    }
+
+    run_bench("birth_rate", 0, 1000, RunActor<ParentActor>(1000));
+
+    int actor_counts[] = {1, 10, 100, 1000};
+    for(int i=0; i<4; i++) {
+        int actors = actor_counts[i];
+        int ticks = 1000;
+
+        run_bench(
+            "director_tick", actors, ticks,
+            DirectorTicks(actors, ticks)
+        );
+    }
+
+    int point_counts[] = {100, 1000};
+    for(int i=0; i<2; i++) {
+        int points = point_counts[i];
+        int moves = 100;
+
+        run_bench(
+            "move_points_actors", points, points*moves,
+            MovePoints<false>(points, moves)
+        );
+        run_bench(
+            "move_points_batch", points, points*moves,
+            MovePoints<true>(points, moves)
+        );
+    }
+
+    print_bench_footer();
+
+    Director::finalize();
+}
@@ -0,0 +1,126 @@
+#ifndef ACTOR_BENCH_H_
+#define ACTOR_BENCH_H_
+
+#include "../src/backend.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+
+/**
+ * A very small benchmark harness.
+ *
+ * A benchmark is a class with an operator() that runs some number of
+ * operations on every process. Each benchmark is run once to warm up,
+ * then timed over a number of repeats. The time of a repeat is the
+ * longest taken by any process, and the median and minimum over the
+ * repeats are reported, which are much steadier between runs than
+ * the mean.
+ *
+ * Results are printed by rank 0 as CSV, one line per benchmark, or as
+ * a JSON array of objects with the same fields, one per benchmark.
+ */
+
+
+// The number of timed repeats of each benchmark.
+int bench_repeats = 7;
+
+// Whether results are printed as JSON rather than CSV.
+bool bench_json = false;
+
+// The number of results printed so far.
+int bench_results = 0;
+
+
+// Print the CSV header line, or open the JSON array.
+void print_bench_header(void) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if(rank != 0) return;
+
+    if(bench_json) {
+        std::cout << "[";
+        return;
+    }
+
+    std::cout
+        << "benchmark,parameter,ranks,operations,repeats,"
+        << "median_s,min_s,median_per_op_s,ops_per_s"
+        << std::endl;
+}
+
+// Close the JSON array. Nothing is needed to end CSV.
+void print_bench_footer(void) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if(rank != 0 || !bench_json) return;
+
+    std::cout << std::endl << "]" << std::endl;
+}
+
+
+// Run and time a benchmark, and print its results.
+// This is a collective routine. All processes must call it at the
+// same time.
+template<class B>
+void run_bench(
+    std::string const& name, long parameter, long operations, B benchmark
+) {
+    int rank;
+    int size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Warm up
+    benchmark();
+
+    std::vector<double> times;
+    for(int i=0; i<bench_repeats; i++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+
+        double start = MPI_Wtime();
+        benchmark();
+        double time = MPI_Wtime() - start;
+
+        double max_time;
+        MPI_Allreduce(
+            &time, &max_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD
+        );
+
+        times.push_back(max_time);
+    }
+
+    std::sort(times.begin(), times.end());
+    double median = times[times.size()/2];
+    double min = times[0];
+
+    if(rank != 0) return;
+
+    if(bench_json) {
+        std::cout
+            << (bench_results > 0 ? "," : "") << std::endl
+            << "{\"benchmark\":\"" << name << "\""
+            << ",\"parameter\":" << parameter << ",\"ranks\":" << size
+            << ",\"operations\":" << operations
+            << ",\"repeats\":" << bench_repeats
+            << std::scientific << std::setprecision(4)
+            << ",\"median_s\":" << median << ",\"min_s\":" << min
+            << ",\"median_per_op_s\":" << median/operations
+            << ",\"ops_per_s\":" << operations/median << "}";
+    } else {
+        std::cout
+            << name << "," << parameter << "," << size << ","
+            << operations << "," << bench_repeats << ","
+            << std::scientific << std::setprecision(4)
+            << median << "," << min << ","
+            << median/operations << "," << operations/median
+            << std::endl;
+    }
+
+    bench_results++;
+}
+
+
+#endif  // ACTOR_BENCH_H_
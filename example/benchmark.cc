@@ -0,0 +1,88 @@
+#include <cstdlib>
+#include <iostream>
+
+#include "../src/director.h"
+#include "./benchmark.h"
+
+#include "./cell.h"
+#include "./frog.h"
+#include "./grid.h"
+
+/**
+ * Run the frog model for a fixed amount of work and report how fast
+ * it went as a line of CSV:
+ *  ranks,grid,frogs,hops_per_frog,seed,seconds,actor_hops_per_second
+ *
+ * Arguments, all optional, in order:
+ *  grid (WxH, or N for an NxN grid), frog_count, hops_per_frog, seed
+ */
+int main(int argc, char *argv[]) {
+
+    ActorModel::Director::initialize(&argc, &argv);
+
+    // scope ensures classes are destroyed before Director::finalize
+    {
+        Grid::Shape grid_shape = {4, 4};
+        int frog_count = 64;
+        int hops_per_frog = 200;
+        unsigned long seed = 1;
+
+        if(argc > 1 && !Grid::parse_shape(argv[1], &grid_shape)) {
+            std::cerr << "Invalid grid: " << argv[1] << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        long num_cells = static_cast<long>(grid_shape.width)*grid_shape.height;
+        if(argc > 2) frog_count = atoi(argv[2]);
+        if(argc > 3) hops_per_frog = atoi(argv[3]);
+        if(argc > 4) seed = strtoul(argv[4], NULL, 10);
+
+        // Every frog is told about every cell at birth, so make room
+        // for the cell lists as well as the usual messages.
+        ActorModel::Director::set_buffer_size(
+            50000
+            + 2*static_cast<long>(frog_count)*num_cells*sizeof(ActorModel::Id)
+        );
+
+        ActorModel::Director director(MPI_COMM_WORLD, 50000);
+
+        director.register_actor<Cell>();
+        director.register_actor<Frog>();
+
+        int size;
+        MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start_time = MPI_Wtime();
+
+        if(director.is_root()) {
+            Benchmark *benchmark = director.add_actor<Benchmark>();
+            benchmark->initialize(
+                grid_shape.width, grid_shape.height,
+                frog_count, hops_per_frog, seed
+            );
+        }
+
+        director.run();
+
+        double time = MPI_Wtime() - start_time;
+        double max_time;
+        MPI_Reduce(&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+        if(director.is_root()) {
+            double actor_hops = static_cast<double>(frog_count)*hops_per_frog;
+
+            std::cout << size << ","
+                      << grid_shape.width << "x" << grid_shape.height << ","
+                      << frog_count << ","
+                      << hops_per_frog << ","
+                      << seed << ","
+                      << max_time << ","
+                      << actor_hops/max_time
+                      << std::endl;
+        }
+    }
+
+    ActorModel::Director::finalize();
+
+    return EXIT_SUCCESS;
+}
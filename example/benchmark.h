@@ -0,0 +1,106 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include <vector>
+
+#include "../src/actor.h"
+#include "./cell.h"
+#include "./frog.h"
+#include "./grid.h"
+
+/**
+ * Benchmark managing actor.
+ *
+ * This actor sets up a grid of cells and a population of frogs that
+ * each make a fixed number of hops, with their own deterministic
+ * random number streams. Once every frog has finished, the cells are
+ * killed and the run ends, so the amount of work done doesn't depend
+ * on the speed of the machine or the number of processes.
+ */
+class Benchmark: public ActorModel::Actor {
+public:
+    Benchmark(): _frog_count(0), _frogs_finished(0) {}
+
+    void main(void) {
+        Message message;
+        while(get_message(&message)) {
+            switch(message.tag()) {
+
+                // Frogs register when they're born and when they die
+                case Frog::REGISTER_ACTOR: {
+                    bool is_alive = message.data<bool>();
+
+                    if(!is_alive) _frogs_finished++;
+                } break;
+
+            }
+        }
+
+        if(_frogs_finished == _frog_count) {
+            bool ignore = true;
+            send_to_group<bool>(_cell_group, ignore, Cell::DIE);
+
+            die();
+            return;
+        }
+
+        // Nothing to do until a frog finishes
+        wait_for_message();
+    }
+
+
+    /**
+     * Call this function once to set up the benchmark
+     */
+    void initialize(
+        int grid_width=4,
+        int grid_height=4,
+        int frog_count=64,
+        int hop_limit=200,
+        unsigned long seed=1
+    ) {
+        _frog_count = frog_count;
+
+        // Generate grid of cells, split into blocks over the ranks
+        Grid::Shape grid_shape = {grid_width, grid_height};
+        int cell_count = grid_width*grid_height;
+
+        int rank_count;
+        MPI_Comm_size(MPI_COMM_WORLD, &rank_count);
+
+        _cell_list.resize(cell_count);
+        for(int i=0; i<cell_count; i++) {
+            _cell_list[i] = give_birth<Cell>(
+                Grid::rank_of_cell(grid_shape, i, rank_count)
+            );
+            _cell_group.add(_cell_list[i]);
+        }
+
+        // Generate frogs, each with its own random number stream
+        for(int i=0; i<frog_count; i++) {
+            Frog::Coords coords = {0.0, 0.0};
+            ActorModel::Id my_id = id();
+
+            Frog::BenchmarkSettings settings;
+            settings.hop_limit = hop_limit;
+
+            Frog::give_birth_for_benchmark(
+                this, &_cell_list[0], grid_shape, coords, my_id,
+                CounterRandom::from_seed(seed, i), settings
+            );
+        }
+    }
+
+
+private:
+
+    int _frog_count;
+    int _frogs_finished;
+
+    std::vector<ActorModel::Id> _cell_list;
+
+    // The cells, for messaging all at once
+    ActorModel::Group _cell_group;
+};
+
+#endif  // BENCHMARK_H_
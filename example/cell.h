@@ -40,6 +40,10 @@ public:
          * and sent to the cell, informing it of what Actor Id
          * to reply to and what tag to reply with.
          * The cell replies with the PopulationData type.
+         *
+         * If the request was sent with ask, or is part of a gather
+         * over a group of cells, the cell answers it with reply instead
+         * and the Id and tag in the request are ignored.
          */
         POPULATION_DATA,
 
@@ -87,9 +91,13 @@ public:
                     data.populationInflux = _populationInflux;
                     data.infectionLevel   = _infectionLevel;
 
-                    send_message<PopulationData>(
-                        request.reply, data, request.tag
-                    );
+                    if(message.expects_reply()) {
+                        reply<PopulationData>(message, data);
+                    } else {
+                        send_message<PopulationData>(
+                            request.reply, data, request.tag
+                        );
+                    }
                 } break;
 
                 case SET_POPULATION_DATA: {
@@ -105,6 +113,9 @@ public:
 
             }
         }
+
+        // Cells only act on messages, so don't run until the next one
+        wait_for_message();
     }
 
     /*
@@ -2,6 +2,112 @@
 #define CIRCULAR_BUFFER_H_
 
 #include <cstddef>
+#include <functional>
+
+
+/**
+ * Wrap an index into a ring of a given size.
+ *
+ * Rings with a power of two size mask the index rather than
+ * taking the remainder, which saves a division on every access.
+ */
+template<size_t size, bool power_of_two = ((size & (size-1)) == 0)>
+struct CircularBufferIndex {
+    static size_t wrap(size_t index) {
+        return index % size;
+    }
+};
+
+template<size_t size>
+struct CircularBufferIndex<size, true> {
+    static size_t wrap(size_t index) {
+        return index & (size-1);
+    }
+};
+
+
+/**
+ * The best value in the last size values pushed into a ring, where
+ * Better(a, b) is true if a should be chosen over b.
+ *
+ * This is a monotonic queue. Values which can never be the best again,
+ * because a better value was pushed after them, are dropped, so the
+ * front of the queue is always the best value. Each push is amortized
+ * O(1).
+ */
+template<class T, size_t size, class Better>
+class MonotonicWindow {
+public:
+    // The ring starts out filled with size copies of T()
+    MonotonicWindow(): _front(0), _count(1), _pushed(size) {
+        _values[0] = T();
+        _times[0] = size-1;
+    }
+
+    T const& best(void) const {
+        return _values[_front];
+    }
+
+    void push(T const& data) {
+        // Drop the front if it has fallen out of the ring
+        if(_count > 0 && _times[_front] + size <= _pushed) {
+            _front = CircularBufferIndex<size>::wrap(_front+1);
+            _count--;
+        }
+
+        // Drop values from the back which data is at least as good as
+        Better better;
+        while(_count > 0 && !better(_values[back()], data)) {
+            _count--;
+        }
+
+        size_t position = CircularBufferIndex<size>::wrap(_front+_count);
+        _values[position] = data;
+        _times[position] = _pushed;
+        _count++;
+        _pushed++;
+    }
+
+private:
+    size_t back(void) const {
+        return CircularBufferIndex<size>::wrap(_front+_count-1);
+    }
+
+    T _values[size];
+    size_t _times[size];  // when each value was pushed
+    size_t _front;
+    size_t _count;
+    size_t _pushed;  // the number of values pushed so far
+};
+
+
+/**
+ * The minimum and maximum of a circular buffer.
+ * These are only tracked if track is true, so buffers which don't
+ * need them don't pay for them.
+ */
+template<class T, size_t size, bool track>
+class CircularBufferExtrema {
+public:
+    T const& min(void) const { return _min.best(); }
+    T const& max(void) const { return _max.best(); }
+
+    void push(T const& data) {
+        _min.push(data);
+        _max.push(data);
+    }
+
+private:
+    MonotonicWindow<T, size, std::less<T> > _min;
+    MonotonicWindow<T, size, std::greater<T> > _max;
+};
+
+template<class T, size_t size>
+class CircularBufferExtrema<T, size, false> {
+public:
+    void push(T const&) {}
+};
+
 
 /**
  * The circular buffer class is a ring of data where
@@ -12,30 +118,57 @@
  * pushed item and moving back in reverse chronological order.
  * If the index passed in is larger than the size of the ring,
  * it will return to the start of the ring.
+ *
+ * The sum of the ring is kept up to date as values are pushed, so
+ * reading it is O(1). If track_extrema is true, the minimum and maximum
+ * are kept as well.
  */
-template<class T, size_t size>
+template<class T, size_t size, bool track_extrema = false>
 class CircularBuffer {
 public:
-    CircularBuffer(): _marker(0) {
+    CircularBuffer(): _marker(0), _sum() {
         // Buffer initialized to identity operator using copy operator
         for(size_t i=0; i<size; i++) {
             _buffer[i] = T();
         }
     }
 
-    T& operator[](size_t index) {
-        return _buffer[(_marker+index)%size];
+    // Items are read only, so the sum can't be bypassed
+    T const& operator[](size_t index) const {
+        return _buffer[CircularBufferIndex<size>::wrap(_marker+index)];
     }
 
     // Move back one space and place the data in the current position
     void push(T data) {
-        _marker = (_marker+size-1)%size;
+        _marker = CircularBufferIndex<size>::wrap(_marker+size-1);
+
+        _sum -= _buffer[_marker];
+        _sum += data;
+        _extrema.push(data);
+
         _buffer[_marker] = data;
     }
 
+    // The sum of every item in the ring
+    T const& sum(void) const {
+        return _sum;
+    }
+
+    // The smallest and largest items in the ring.
+    // Only available if track_extrema is true.
+    T const& min(void) const {
+        return _extrema.min();
+    }
+
+    T const& max(void) const {
+        return _extrema.max();
+    }
+
 private:
     T _buffer[size];
     size_t _marker;  // marks beginning and end of buffer
+    T _sum;
+    CircularBufferExtrema<T, size, track_extrema> _extrema;
 };
 
 #endif  // CIRCULAR_BUFFER_H_
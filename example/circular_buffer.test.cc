@@ -0,0 +1,85 @@
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+#include "./circular_buffer.h"
+
+#include "../test/super_quick_test.h"
+#include "../src/director.h"
+
+using namespace ActorModel;
+
+
+/*
+ * Check a buffer against a plain history of everything pushed into it.
+ */
+template<size_t size>
+void test_against_history(void) {
+    CircularBuffer<int, size, true> buffer;
+    std::vector<int> history(size, 0);
+
+    std::srand(size);
+    for(size_t n=0; n<5*size; n++) {
+        int value = std::rand()%100 - 50;
+
+        buffer.push(value);
+        history.push_back(value);
+
+        int sum = 0;
+        int min = value;
+        int max = value;
+        for(size_t i=0; i<size; i++) {
+            int item = history[history.size()-1 - i];
+
+            REQUIRE(buffer[i] == item);
+
+            sum += item;
+            min = std::min(min, item);
+            max = std::max(max, item);
+        }
+
+        // Indices wrap around the ring
+        REQUIRE(buffer[size] == buffer[0]);
+
+        REQUIRE(buffer.sum() == sum);
+        REQUIRE(buffer.min() == min);
+        REQUIRE(buffer.max() == max);
+    }
+}
+
+void test_circular_buffer(void) {
+    // Sizes which are and aren't powers of two
+    test_against_history<1>();
+    test_against_history<7>();
+    test_against_history<16>();
+    test_against_history<500>();
+}
+
+void test_circular_buffer_initial(void) {
+    CircularBuffer<int, 8, true> buffer;
+
+    for(size_t i=0; i<8; i++) {
+        REQUIRE(buffer[i] == 0);
+    }
+    REQUIRE(buffer.sum() == 0);
+    REQUIRE(buffer.min() == 0);
+    REQUIRE(buffer.max() == 0);
+
+    // The initial zeros are still in the ring until overwritten
+    buffer.push(3);
+    REQUIRE(buffer.sum() == 3);
+    REQUIRE(buffer.min() == 0);
+    REQUIRE(buffer.max() == 3);
+}
+
+
+int main(int argc, char *argv[]) {
+    Director::initialize(&argc, &argv);
+
+    INIT_SQT();
+
+    RUN_TEST(test_circular_buffer);
+    RUN_TEST(test_circular_buffer_initial);
+
+    Director::finalize();
+}
@@ -0,0 +1,173 @@
+#ifndef COUNTER_RANDOM_H_
+#define COUNTER_RANDOM_H_
+
+#include <cstddef>
+#include <stdint.h>
+
+
+/**
+ * A counter based random number generator (Philox4x32-10).
+ *
+ * Rather than stepping a hidden state, each random number is found by
+ * encrypting a counter with a key. A generator is just its key, so
+ * every actor can have its own stream without sharing any state, and
+ * the numbers an actor draws depend only on its key and on which
+ * numbers it asks for, not on which process it runs on or the order
+ * actors are run in.
+ *
+ * Numbers are drawn by step (e.g. a frog's hop count) and by index
+ * within the step:
+ *
+ *  float draws[3];
+ *  random.uniforms(step, draws, 3);  // same as uniform(step, 0..2)
+ *
+ * New, independent streams are split off with child, so a parent can
+ * hand its n-th child the key random.child(n).
+ *
+ * A CounterRandom is plain data, so it can be sent in a message.
+ */
+class CounterRandom {
+public:
+    CounterRandom(uint32_t key0=0, uint32_t key1=0) {
+        _key[0] = key0;
+        _key[1] = key1;
+    }
+
+    // A generator for the stream numbered index of a seed.
+    static CounterRandom from_seed(uint64_t seed, uint64_t index=0) {
+        return CounterRandom(
+            static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)
+        ).child(index);
+    }
+
+    // An independent generator for the child numbered index.
+    CounterRandom child(uint64_t index) const {
+        uint32_t block[4] = {
+            static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32),
+            0, CHILD_DOMAIN
+        };
+        philox(block);
+
+        return CounterRandom(block[0], block[1]);
+    }
+
+    // The random number at index of step, uniform on (0, 1).
+    float uniform(uint64_t step, uint32_t index) const {
+        uint32_t block[4];
+        counter(step, index/4, block);
+        philox(block);
+
+        return to_float(block[index%4]);
+    }
+
+    // Fill out with the first count random numbers of step.
+    //
+    // Blocks are generated side by side, a lane per block, so the
+    // rounds over the lanes can be vectorized by the compiler. A few
+    // numbers, like the draws for a single step, only take a couple
+    // of lanes.
+    void uniforms(uint64_t step, float *out, size_t count) const {
+        if(count <= 4*2) {
+            uniforms_in_lanes<2>(step, out, count);
+        } else {
+            uniforms_in_lanes<8>(step, out, count);
+        }
+    }
+
+    uint32_t key(int word) const {
+        return _key[word];
+    }
+
+    // Encrypt one counter block in place.
+    void philox(uint32_t block[4]) const {
+        uint32_t lanes[4][1] = {{block[0]}, {block[1]}, {block[2]}, {block[3]}};
+        philox_lanes<1>(lanes);
+
+        for(int word=0; word<4; word++) block[word] = lanes[word][0];
+    }
+
+
+private:
+    // Counters with this last word make child keys, not draws
+    static const uint32_t CHILD_DOMAIN = 0xffffffffu;
+
+    // Philox constants
+    static const uint32_t MULTIPLIER0 = 0xD2511F53u;
+    static const uint32_t MULTIPLIER1 = 0xCD9E8D57u;
+    static const uint32_t WEYL0 = 0x9E3779B9u;
+    static const uint32_t WEYL1 = 0xBB67AE85u;
+    static const int ROUNDS = 10;
+
+    // Fill out with the first count random numbers of step, generating
+    // lanes blocks at a time.
+    template<size_t lanes>
+    void uniforms_in_lanes(uint64_t step, float *out, size_t count) const {
+        uint32_t block[4][lanes];
+
+        for(size_t first=0; first<count; first += 4*lanes) {
+            for(size_t lane=0; lane<lanes; lane++) {
+                uint32_t lane_counter[4];
+                counter(step, first/4 + lane, lane_counter);
+
+                for(int word=0; word<4; word++) {
+                    block[word][lane] = lane_counter[word];
+                }
+            }
+
+            philox_lanes<lanes>(block);
+
+            for(size_t i=0; i<4*lanes && first+i<count; i++) {
+                out[first+i] = to_float(block[i%4][i/4]);
+            }
+        }
+    }
+
+    // The counter for block number block_index of step
+    static void counter(uint64_t step, uint64_t block_index, uint32_t out[4]) {
+        out[0] = static_cast<uint32_t>(block_index);
+        out[1] = static_cast<uint32_t>(step);
+        out[2] = static_cast<uint32_t>(step >> 32);
+        out[3] = static_cast<uint32_t>(block_index >> 32);
+    }
+
+    // Map 32 random bits onto (0, 1), keeping the top 24 bits
+    static float to_float(uint32_t bits) {
+        return ((bits >> 8) + 0.5f)*(1.0f/16777216.0f);
+    }
+
+    // Encrypt a number of blocks held word by word, block[word][lane].
+    template<size_t lanes>
+    void philox_lanes(uint32_t block[4][lanes]) const {
+        uint32_t key0 = _key[0];
+        uint32_t key1 = _key[1];
+
+        for(int round=0; round<ROUNDS; round++) {
+            for(size_t lane=0; lane<lanes; lane++) {
+                uint64_t product0 =
+                    static_cast<uint64_t>(MULTIPLIER0)*block[0][lane];
+                uint64_t product1 =
+                    static_cast<uint64_t>(MULTIPLIER1)*block[2][lane];
+
+                uint32_t next0 =
+                    static_cast<uint32_t>(product1 >> 32)
+                    ^ block[1][lane] ^ key0;
+                uint32_t next2 =
+                    static_cast<uint32_t>(product0 >> 32)
+                    ^ block[3][lane] ^ key1;
+
+                block[0][lane] = next0;
+                block[1][lane] = static_cast<uint32_t>(product1);
+                block[2][lane] = next2;
+                block[3][lane] = static_cast<uint32_t>(product0);
+            }
+
+            key0 += WEYL0;
+            key1 += WEYL1;
+        }
+    }
+
+    uint32_t _key[2];
+};
+
+
+#endif  // COUNTER_RANDOM_H_
@@ -0,0 +1,83 @@
+#include <vector>
+
+#include "./counter_random.h"
+
+#include "../test/super_quick_test.h"
+#include "../src/director.h"
+
+using namespace ActorModel;
+
+
+void test_philox_known_answers(void) {
+    // Known answers for Philox4x32-10 from the Random123 library
+    uint32_t zeros[4] = {0, 0, 0, 0};
+    CounterRandom(0, 0).philox(zeros);
+    REQUIRE(zeros[0] == 0x6627e8d5u);
+    REQUIRE(zeros[1] == 0xe169c58du);
+    REQUIRE(zeros[2] == 0xbc57ac4cu);
+    REQUIRE(zeros[3] == 0x9b00dbd8u);
+
+    uint32_t pi[4] = {0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u};
+    CounterRandom(0xa4093822u, 0x299f31d0u).philox(pi);
+    REQUIRE(pi[0] == 0xd16cfe09u);
+    REQUIRE(pi[1] == 0x94fdccebu);
+    REQUIRE(pi[2] == 0x5001e420u);
+    REQUIRE(pi[3] == 0x24126ea1u);
+}
+
+
+void test_counter_random_streams(void) {
+    CounterRandom random = CounterRandom::from_seed(7);
+
+    // Batches match single draws, for counts that don't fill a batch
+    int counts[] = {1, 5, 32, 33, 100};
+    for(int c=0; c<5; c++) {
+        std::vector<float> batch(counts[c]);
+        random.uniforms(3, &batch[0], counts[c]);
+
+        for(int i=0; i<counts[c]; i++) {
+            REQUIRE(batch[i] == random.uniform(3, i));
+        }
+    }
+
+    // Draws are on (0, 1), with a sensible mean
+    std::vector<float> draws(10000);
+    random.uniforms(0, &draws[0], draws.size());
+    double sum = 0;
+    for(size_t i=0; i<draws.size(); i++) {
+        REQUIRE(draws[i] > 0.0f && draws[i] < 1.0f);
+        sum += draws[i];
+    }
+    REQUIRE(std::abs(sum/draws.size() - 0.5) < 0.01);
+
+    // Steps, seeds and children give different streams
+    REQUIRE(random.uniform(0, 0) != random.uniform(1, 0));
+    REQUIRE(
+        CounterRandom::from_seed(7, 0).uniform(0, 0)
+            != CounterRandom::from_seed(7, 1).uniform(0, 0)
+    );
+    REQUIRE(
+        CounterRandom::from_seed(7).uniform(0, 0)
+            != CounterRandom::from_seed(8).uniform(0, 0)
+    );
+    REQUIRE(random.child(0).uniform(0, 0) != random.child(1).uniform(0, 0));
+    REQUIRE(random.child(0).uniform(0, 0) != random.uniform(0, 0));
+
+    // The same stream gives the same numbers on every process
+    float first = CounterRandom::from_seed(7, 2).child(5).uniform(11, 3);
+    float root_first = first;
+    MPI_Bcast(&root_first, 1, MPI_FLOAT, 0, super_quick_test_comm);
+    REQUIRE(first == root_first);
+}
+
+
+int main(int argc, char *argv[]) {
+    Director::initialize(&argc, &argv);
+
+    INIT_SQT();
+
+    RUN_TEST(test_philox_known_answers);
+    RUN_TEST(test_counter_random_streams);
+
+    Director::finalize();
+}
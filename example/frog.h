@@ -1,16 +1,17 @@
 #ifndef FROG_H_
 #define FROG_H_
 
+#include <cmath>
+#include <algorithm>
+
 #include "../src/actor.h"
-#include "./provided-functions/frog-functions.h"
 
 #include "./circular_buffer.h"
+#include "./counter_random.h"
 
 #include "./grid.h"
 #include "./cell.h"
 
-long RNG_state;
-
 class Frog: public ActorModel::Actor {
 public:
     Frog():
@@ -23,6 +24,12 @@ public:
 
         _register_actor(-1, -1),
 
+        _grid_shape(),
+
+        _random(),
+        _births(0),
+        _hop_limit(0),
+
         _total_hops(0),
         _main_state(0)
     {}
@@ -32,11 +39,17 @@ public:
     static const int test_death_hop_count = 700;
     static const int test_birth_hop_count = 300;
 
+    // The number of cells a frog keeps a channel open to at once
+    static const size_t landed_channel_count = 8;
+
     // Special message data types
     struct Coords {
         float x;
         float y;
     };
+    struct BenchmarkSettings {
+        int hop_limit;
+    };
     
     // Frog message tags
     enum {
@@ -105,7 +118,41 @@ public:
          * A frog receiving this message will die. The message data
          * will be ignored.
          */
-        DIE
+        DIE,
+
+        /**
+         * Message tag: BENCHMARK
+         * Message data: BenchmarkSettings
+         *
+         * A frog receiving this message will not give birth or die
+         * of disease, and will die once it has made hop_limit hops.
+         *
+         * This must be received before the frog is initialized.
+         */
+        BENCHMARK,
+
+        /**
+         * Message tag: GRID_SHAPE
+         * Message data: Grid::Shape
+         *
+         * A frog receiving this message will take the cells in the
+         * next CELL_LIST it receives to form a grid of this shape.
+         * Without it, the grid is taken to be square.
+         */
+        GRID_SHAPE,
+
+        /**
+         * Message tag: RANDOM_STREAM
+         * Message data: CounterRandom
+         *
+         * A frog receiving this message will draw its random numbers
+         * from the received generator. Its hops and decisions then
+         * depend only on the generator and the cell data it sees,
+         * not on which process it runs on.
+         *
+         * This must be received before the frog starts hopping.
+         */
+        RANDOM_STREAM
     };
 
 
@@ -118,6 +165,8 @@ public:
      *
      * _main_state == AWAITING_CELL_DATA
      *     means frog is awaiting population data from cell.
+     *     The reply is routed to update_population_data while
+     *     checking messages.
      */
     void main(void) {
         Message message;
@@ -135,10 +184,31 @@ public:
                     message.data<ActorModel::Id>(
                         &_cell_list[0], cell_list_size
                     );
+                    close_landed_channels();
+
+                    // Without a matching shape, the grid is square
+                    if(
+                        _grid_shape.width*_grid_shape.height != cell_list_size
+                    ) {
+                        int side = static_cast<int>(
+                            std::sqrt(static_cast<float>(cell_list_size)) + 0.5
+                        );
+
+                        _grid_shape.width = side;
+                        _grid_shape.height = side;
+                    }
 
                     init();
                 } break;
 
+                case GRID_SHAPE: {
+                    _grid_shape = message.data<Grid::Shape>();
+                } break;
+
+                case RANDOM_STREAM: {
+                    _random = message.data<CounterRandom>();
+                } break;
+
                 case INITIAL_COORDS: {
                     _coords = message.data<Coords>();
 
@@ -163,37 +233,52 @@ public:
                  * Update own data according to cell data
                  */
                 case POPULATION_DATA: {
-                    Cell::PopulationData data =
-                        message.data<Cell::PopulationData>();
-
-                    _totalPopulationInflux += data.populationInflux;
-
-                    _infectionLevels.push(data.infectionLevel);
-
-                    _main_state = READY_TO_HOP;
+                    update_population_data(
+                        message.data<Cell::PopulationData>()
+                    );
                 } break;
 
                 /* Die! */
                 case DIE: {
                     die();
-                }
+                } break;
+
+                /*
+                 * Optional benchmark message
+                 */
+                case BENCHMARK: {
+                    BenchmarkSettings settings =
+                        message.data<BenchmarkSettings>();
+
+                    _hop_limit = settings.hop_limit;
+                } break;
 
             }
         }
 
         // Do the regular tasks if initialized
         if(_main_state == READY_TO_HOP) {
+            draw_random_numbers();
             hop();
 
-            test_birth();
-            test_disease();
-            test_death();
+            if(_hop_limit > 0) {
+                // Benchmark frogs do a fixed amount of work
+                test_disease();
+                if(_total_hops >= _hop_limit) die();
+            } else {
+                test_birth();
+                test_disease();
+                test_death();
+            }
 
             if(!is_dead()) {
                 request_cell_data();
                 _main_state = AWAITING_CELL_DATA;
             }
         }
+
+        // Nothing more can happen until a message arrives
+        wait_for_message();
     }
 
 
@@ -203,21 +288,43 @@ public:
      */
     static ActorModel::Id give_birth_and_initialize(
         Actor* parent,
-        ActorModel::Id *cell_list, int cell_list_count,
+        ActorModel::Id *cell_list, Grid::Shape grid_shape,
         Coords& coords,
-        ActorModel::Id& register_actor
+        ActorModel::Id& register_actor,
+        CounterRandom random
     ) {
         ActorModel::Id child_id = parent->give_birth<Frog>();
 
-        // Initialize child
-        parent->send_message<ActorModel::Id>(
-            child_id, cell_list, cell_list_count, CELL_LIST
+        initialize_child(
+            parent, child_id, cell_list, grid_shape, coords, register_actor,
+            random
         );
-        parent->send_message<Frog::Coords>(
-            child_id, coords, INITIAL_COORDS
+
+        return child_id;
+    }
+
+    /**
+     * Give birth to a frog that runs in benchmark mode and fully
+     * initialize it. The benchmark settings are sent first so they
+     * arrive before the frog starts hopping.
+     */
+    static ActorModel::Id give_birth_for_benchmark(
+        Actor* parent,
+        ActorModel::Id *cell_list, Grid::Shape grid_shape,
+        Coords& coords,
+        ActorModel::Id& register_actor,
+        CounterRandom random,
+        BenchmarkSettings& settings
+    ) {
+        ActorModel::Id child_id = parent->give_birth<Frog>();
+
+        parent->send_message<BenchmarkSettings>(
+            child_id, settings, BENCHMARK
         );
-        parent->send_message<ActorModel::Id>(
-            child_id, register_actor, REGISTER_ACTOR
+
+        initialize_child(
+            parent, child_id, cell_list, grid_shape, coords, register_actor,
+            random
         );
 
         return child_id;
@@ -249,6 +356,27 @@ public:
 
 
 private:
+    /* Send a newly born frog everything it needs to start. */
+    static void initialize_child(
+        Actor* parent, ActorModel::Id child_id,
+        ActorModel::Id *cell_list, Grid::Shape grid_shape,
+        Coords& coords,
+        ActorModel::Id& register_actor,
+        CounterRandom random
+    ) {
+        parent->send_message<CounterRandom>(child_id, random, RANDOM_STREAM);
+        parent->send_message<Grid::Shape>(child_id, grid_shape, GRID_SHAPE);
+        parent->send_message<ActorModel::Id>(
+            child_id, cell_list, grid_shape.width*grid_shape.height, CELL_LIST
+        );
+        parent->send_message<Frog::Coords>(
+            child_id, coords, INITIAL_COORDS
+        );
+        parent->send_message<ActorModel::Id>(
+            child_id, register_actor, REGISTER_ACTOR
+        );
+    }
+
     /* Update initialization state of frog. */
     void init(void) {
         if(_main_state <  INITIALIZED) _main_state++;
@@ -274,41 +402,111 @@ private:
     }
 
     /*
-     * Send a request to the cell we're currently on
-     * for its population data.
+     * Ask the cell we're currently on for its population data.
      */
     void request_cell_data(void) {
-        int cell_num = getCellFromPosition(_coords.x, _coords.y);
+        int cell_num = cell_from_position(_coords);
 
         Cell::PopulationDataRequest data;
         data.tag = POPULATION_DATA;
         data.reply = id();
 
-        send_message<Cell::PopulationDataRequest>(
-            _cell_list[cell_num], data, Cell::POPULATION_DATA
+        ask(
+            _cell_list[cell_num], data, Cell::POPULATION_DATA,
+            &Frog::update_population_data
         );
     }
 
+    /*
+     * Update historical values with the population data of a cell.
+     */
+    void update_population_data(Cell::PopulationData data) {
+        _totalPopulationInflux += data.populationInflux;
+
+        _infectionLevels.push(data.infectionLevel);
+
+        _main_state = READY_TO_HOP;
+    }
+
+    /*
+     * Find the cell in the grid a position lies in.
+     */
+    int cell_from_position(Coords coords) {
+        return Grid::cell_from_position(_grid_shape, coords.x, coords.y);
+    }
+
+    /*
+     * Find the random numbers for the coming hop, drawn by hop count.
+     */
+    void draw_random_numbers(void) {
+        _random.uniforms(_total_hops, _draws, DRAW_COUNT);
+    }
+
+    /* A random number on (0, 1) for a use in the coming hop. */
+    float random_number(int draw) {
+        return _draws[draw];
+    }
+
     /*
      * Move around the environment.
+     * Steps of up to 1 in each direction, wrapping around the edges.
      */
     void hop(void) {
-        Coords old_coords = _coords;
-        frogHop(
-            old_coords.x, old_coords.y,
-            &_coords.x, &_coords.y,
-            &RNG_state
-        );
+        float x = _coords.x + random_number(HOP_X);
+        float y = _coords.y + random_number(HOP_Y);
+        _coords.x = x - static_cast<int>(x);
+        _coords.y = y - static_cast<int>(y);
 
-        int cell_num = getCellFromPosition(_coords.x, _coords.y);
+        int cell_num = cell_from_position(_coords);
 
-        send_message<bool>(
-            _cell_list[cell_num], _is_infected, Cell::LANDED
-        );
+        landed_channel(cell_num).send(_is_infected);
 
         _total_hops++;
     }
 
+    /*
+     * Get a channel to a cell for telling it the frog has landed there.
+     * A frog often lands on the same few cells again and again, so the
+     * channels to the last few cells it landed on are kept open, and
+     * the least recently used is closed to make way for a new one.
+     */
+    Channel<bool>& landed_channel(int cell_num) {
+        size_t oldest = 0;
+        for(size_t i=0; i<_landed_channels.size(); i++) {
+            LandedChannel& landed = _landed_channels[i];
+
+            if(landed.cell_num == cell_num) {
+                landed.last_hop = _total_hops;
+                return landed.channel;
+            }
+
+            if(landed.last_hop < _landed_channels[oldest].last_hop) {
+                oldest = i;
+            }
+        }
+
+        if(_landed_channels.size() < landed_channel_count) {
+            _landed_channels.push_back(LandedChannel());
+            oldest = _landed_channels.size()-1;
+        } else {
+            close_channel(_landed_channels[oldest].channel);
+        }
+
+        LandedChannel& landed = _landed_channels[oldest];
+        landed.cell_num = cell_num;
+        landed.last_hop = _total_hops;
+        landed.channel = open_channel<bool>(_cell_list[cell_num], Cell::LANDED);
+
+        return landed.channel;
+    }
+
+    void close_landed_channels(void) {
+        for(size_t i=0; i<_landed_channels.size(); i++) {
+            close_channel(_landed_channels[i].channel);
+        }
+        _landed_channels.clear();
+    }
+
     /*
      * Test to see if this frog will give birth to another.
      * If so, give birth.
@@ -318,11 +516,15 @@ private:
             float averagePopulationInflux =
                 static_cast<float>(_totalPopulationInflux)/test_birth_hop_count;
 
-            if(willGiveBirth(averagePopulationInflux, &RNG_state)) {
+            float scaled = averagePopulationInflux/2000.0;
+            float probability = std::atan(scaled*scaled)/(4*scaled);
+
+            if(random_number(BIRTH) < probability) {
                 give_birth_and_initialize(
                     this,
-                    &_cell_list[0], _cell_list.size(),
-                    _coords, _register_actor
+                    &_cell_list[0], _grid_shape,
+                    _coords, _register_actor,
+                    _random.child(_births++)
                 );
             }
 
@@ -336,20 +538,20 @@ private:
      * If so, set the frog to infected.
      */
     void test_disease(void) {
-        float average = 0.0;
-        for(int i=0; i<infectionLevel_history_length; i++) {
-            average += _infectionLevels[i];
-        }
+        float average = _infectionLevels.sum();
         average = average/infectionLevel_history_length;
 
-        if(willCatchDisease(average, &RNG_state)) {
+        float probability =
+            std::atan(std::min(average, 40000.0f)/2000.0)/M_PI;
+
+        if(random_number(DISEASE) < probability) {
             _is_infected = true;
         }
     }
 
     void test_death(void) {
         if(_is_infected && (_total_hops % test_death_hop_count) == 0) {
-            if(willDie(&RNG_state)) {
+            if(random_number(DEATH) < 0.166666666) {
                 die();
             }
         }
@@ -369,9 +571,39 @@ private:
     // The grid the frog lives on
     std::vector<ActorModel::Id> _cell_list;
 
+    // Channels for telling the cells the frog has landed on most
+    // recently that it has landed on them, and when each was last used
+    struct LandedChannel {
+        int cell_num;
+        int last_hop;
+        Channel<bool> channel;
+    };
+    std::vector<LandedChannel> _landed_channels;
+
     // The actor the frog must notify about birth and death
     ActorModel::Id _register_actor;
 
+    // The shape of the grid the frog lives on
+    Grid::Shape _grid_shape;
+
+    // The frog's random number generator, the number of children it
+    // has given generators to, and the random numbers for the coming hop.
+    CounterRandom _random;
+    int _births;
+    enum {
+        HOP_X,
+        HOP_Y,
+        BIRTH,
+        DISEASE,
+        DEATH,
+        DRAW_COUNT
+    };
+    float _draws[DRAW_COUNT];
+
+    // The number of hops a benchmark frog makes before dying,
+    // or 0 if the frog isn't in benchmark mode.
+    int _hop_limit;
+
     // Track the total number of hops a frog has made
     int _total_hops;
 
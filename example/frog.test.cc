@@ -1,3 +1,5 @@
+#include <vector>
+
 #include "./frog.h"
 
 #include "../test/super_quick_test.h"
@@ -19,6 +21,10 @@ public:
         send_message<Id>(frog_id, cell_list, cell_count, Frog::CELL_LIST);
     }
 
+    void send_grid_shape(Grid::Shape shape, Id frog_id) {
+        send_message<Grid::Shape>(frog_id, shape, Frog::GRID_SHAPE);
+    }
+
     void send_starting_position(float x, float y, Id frog_id) {
         Frog::Coords coords = {x, y};
         send_message<Frog::Coords>(frog_id, coords, Frog::INITIAL_COORDS);
@@ -70,13 +76,13 @@ void test_frog_setup(void) {
 
         Grid grid;
 
-        Cell *cells[grid.num_cells];
+        std::vector<Cell*> cells(grid.num_cells());
 
-        for(int i=0; i<grid.num_cells; i++) {
+        for(int i=0; i<grid.num_cells(); i++) {
             cells[i] = director.add_actor<Cell>();
         }
 
-        for(int i=0; i<grid.num_cells; i++) {
+        for(int i=0; i<grid.num_cells(); i++) {
             grid.cell_ids[i] = cells[i]->id();
         }
 
@@ -84,17 +90,17 @@ void test_frog_setup(void) {
         test->send_register_actor(frog->id());
 
         // Send cell data to frog and receive it
-        test->send_grid(grid.cell_ids, grid.num_cells, frog->id());
+        test->send_grid(&grid.cell_ids[0], grid.num_cells(), frog->id());
         frog->main();
 
-        for(int i=0; i<grid.num_cells; i++) {
+        for(int i=0; i<grid.num_cells(); i++) {
             REQUIRE(frog->cell_list(i).rank() == cells[i]->id().rank());
             REQUIRE(frog->cell_list(i).gid()   == cells[i]->id().gid());
         }
 
         // Require that frog has done nothing until initial
         // position has been set
-        for(int i=0; i<grid.num_cells; i++) {
+        for(int i=0; i<grid.num_cells(); i++) {
             // receive potential hop
             cells[i]->main();
             REQUIRE(cells[i]->populationInflux() == 0);
@@ -110,7 +116,7 @@ void test_frog_setup(void) {
         // Frog should wait until cells have replied with population data
         REQUIRE(sqt_fleq(frog->coords().x, coord_x));
         REQUIRE(sqt_fleq(frog->coords().y, coord_y));
-        for(int i=0; i<grid.num_cells; i++) {
+        for(int i=0; i<grid.num_cells(); i++) {
             cells[i]->main();
         }
 
@@ -120,7 +126,7 @@ void test_frog_setup(void) {
         // Check that population influx has now increased
         int totalPopulationInflux = 0;
         int totalInfectionLevel = 0;
-        for(int i=0; i<grid.num_cells; i++) {
+        for(int i=0; i<grid.num_cells(); i++) {
             cells[i]->main();
             totalPopulationInflux += cells[i]->populationInflux();
             totalInfectionLevel   += cells[i]->infectionLevel();
@@ -141,23 +147,23 @@ void test_frog_cell_interaction(void) {
 
         Grid grid;
 
-        Cell *cells[grid.num_cells];
-        for(int i=0; i<grid.num_cells; i++) {
+        std::vector<Cell*> cells(grid.num_cells());
+        for(int i=0; i<grid.num_cells(); i++) {
             cells[i] = director.add_actor<Cell>();
         }
 
-        for(int i=0; i<grid.num_cells; i++) {
+        for(int i=0; i<grid.num_cells(); i++) {
             grid.cell_ids[i] = cells[i]->id();
         }
 
         // Send cell data to frog and receive it
-        test->send_grid(grid.cell_ids, grid.num_cells, frog->id());
+        test->send_grid(&grid.cell_ids[0], grid.num_cells(), frog->id());
         test->send_starting_position(0.0, 0.0, frog->id());
         test->send_register_actor(frog->id());
         frog->main();
 
         // Update cells after frog hop
-        for(int i=0; i<grid.num_cells; i++) {
+        for(int i=0; i<grid.num_cells(); i++) {
             cells[i]->main();
         }
 
@@ -166,7 +172,7 @@ void test_frog_cell_interaction(void) {
         {
             int initialPopulationInflux = 0;
             int initialInfectionLevel   = 0;
-            for(int i=0; i<grid.num_cells; i++) {
+            for(int i=0; i<grid.num_cells(); i++) {
                 initialPopulationInflux += cells[i]->populationInflux();
                 initialInfectionLevel   += cells[i]->infectionLevel();
             }
@@ -175,7 +181,7 @@ void test_frog_cell_interaction(void) {
 
             int finalPopulationInflux = 0;
             int finalInfectionLevel   = 0;
-            for(int i=0; i<grid.num_cells; i++) {
+            for(int i=0; i<grid.num_cells(); i++) {
                 cells[i]->main();
 
                 finalPopulationInflux += cells[i]->populationInflux();
@@ -191,7 +197,7 @@ void test_frog_cell_interaction(void) {
         {
             int initialPopulationInflux = 0;
             int initialInfectionLevel   = 0;
-            for(int i=0; i<grid.num_cells; i++) {
+            for(int i=0; i<grid.num_cells(); i++) {
                 initialPopulationInflux += cells[i]->populationInflux();
                 initialInfectionLevel   += cells[i]->infectionLevel();
             }
@@ -201,7 +207,7 @@ void test_frog_cell_interaction(void) {
 
             int finalPopulationInflux = 0;
             int finalInfectionLevel   = 0;
-            for(int i=0; i<grid.num_cells; i++) {
+            for(int i=0; i<grid.num_cells(); i++) {
                 cells[i]->main();
 
                 finalPopulationInflux += cells[i]->populationInflux();
@@ -227,12 +233,12 @@ void test_frog_cell_history(void) {
         Grid grid;
         Cell *test_cell = director.add_actor<Cell>();
 
-        for(int i=0; i<grid.num_cells; i++) {
+        for(int i=0; i<grid.num_cells(); i++) {
             grid.cell_ids[i] = test_cell->id();
         }
 
         // Send cell data to frog
-        test->send_grid(grid.cell_ids, grid.num_cells, frog->id());
+        test->send_grid(&grid.cell_ids[0], grid.num_cells(), frog->id());
         test->send_starting_position(0.0, 0.0, frog->id());
 
         int totalPopulationInflux = 0;
@@ -292,6 +298,12 @@ void test_frog_cell_history(void) {
             );
         }
 
+        int infection_sum = 0;
+        for(int i=0; i<Frog::infectionLevel_history_length; i++) {
+            infection_sum += infection_history[i];
+        }
+        REQUIRE(frog->infectionLevels().sum() == infection_sum);
+
     }
 }
 
@@ -309,12 +321,12 @@ void test_sick_frogs(void) {
         Grid grid;
         Cell *test_cell = director.add_actor<Cell>();
 
-        for(int i=0; i<grid.num_cells; i++) {
+        for(int i=0; i<grid.num_cells(); i++) {
             grid.cell_ids[i] = test_cell->id();
         }
 
         // Send cell data to frogs
-        test->send_grid(grid.cell_ids, grid.num_cells, frog->id());
+        test->send_grid(&grid.cell_ids[0], grid.num_cells(), frog->id());
         test->send_starting_position(0.0, 0.0, frog->id());
         test->send_register_actor(frog->id());
 
@@ -382,12 +394,12 @@ void test_frog_birth(void) {
         test_cell = director.add_actor<Cell>();
 
         Grid grid;
-        for(int i=0; i<grid.num_cells; i++) {
+        for(int i=0; i<grid.num_cells(); i++) {
             grid.cell_ids[i] = test_cell->id();
         }
 
         // Send cell data to frogs
-        test->send_grid(grid.cell_ids, grid.num_cells, frog->id());
+        test->send_grid(&grid.cell_ids[0], grid.num_cells(), frog->id());
         test->send_starting_position(0.0, 0.0, frog->id());
         test->send_register_actor(frog->id());
 
@@ -460,6 +472,62 @@ void test_frog_birth(void) {
 }
 
 
+void test_frog_grid_shape(void) {
+    // Cells are numbered row by row, and split into blocks over ranks
+    Grid::Shape shape = {8, 2};
+    REQUIRE(Grid::cell_from_position(shape, 0.0, 0.0) == 0);
+    REQUIRE(Grid::cell_from_position(shape, 0.95, 0.0) == 7);
+    REQUIRE(Grid::cell_from_position(shape, 0.95, 0.7) == 15);
+    REQUIRE(Grid::rank_of_cell(shape, 0, 4) == 0);
+    REQUIRE(Grid::rank_of_cell(shape, 7, 4) == 1);
+    REQUIRE(Grid::rank_of_cell(shape, 15, 4) == 3);
+
+    Grid::Shape parsed;
+    REQUIRE(Grid::parse_shape("8x2", &parsed));
+    REQUIRE(parsed.width == 8 && parsed.height == 2);
+    REQUIRE(Grid::parse_shape("5", &parsed));
+    REQUIRE(parsed.width == 5 && parsed.height == 5);
+    REQUIRE(!Grid::parse_shape("0x4", &parsed));
+
+    Director director;
+
+    if(director.is_root()) {
+        TestFrogSetup *test =
+            director.add_actor<TestFrogSetup>();
+        Frog *frog = director.add_actor<Frog>();
+
+        Grid grid(shape.width, shape.height);
+
+        std::vector<Cell*> cells(grid.num_cells());
+        for(int i=0; i<grid.num_cells(); i++) {
+            cells[i] = director.add_actor<Cell>();
+            grid.cell_ids[i] = cells[i]->id();
+        }
+
+        test->send_grid_shape(grid.shape, frog->id());
+        test->send_grid(&grid.cell_ids[0], grid.num_cells(), frog->id());
+        test->send_starting_position(0.95, 0.7, frog->id());
+        test->send_register_actor(frog->id());
+        frog->main();
+
+        // Answer the request for population data, then hop
+        for(int i=0; i<grid.num_cells(); i++) {
+            cells[i]->main();
+        }
+        frog->main();
+
+        // The frog should land on the cell under its new position
+        Frog::Coords coords = frog->coords();
+        int landed = Grid::cell_from_position(grid.shape, coords.x, coords.y);
+
+        for(int i=0; i<grid.num_cells(); i++) {
+            cells[i]->main();
+            REQUIRE(cells[i]->populationInflux() == (i == landed ? 1 : 0));
+        }
+    }
+}
+
+
 int main(int argc, char *argv[]) {
     Director::initialize(&argc, &argv);
     Director::set_buffer_size(100000);
@@ -471,6 +539,7 @@ int main(int argc, char *argv[]) {
     RUN_TEST(test_frog_cell_history);
     RUN_TEST(test_sick_frogs);
     RUN_TEST(test_frog_birth);
+    RUN_TEST(test_frog_grid_shape);
 
     Director::finalize();
 }
@@ -1,16 +1,74 @@
 #ifndef GRID_H_
 #define GRID_H_
 
+#include <vector>
+#include <cstdio>
+
 #include "../src/id.h"
 
 
+/**
+ * A width x height grid of cells covering the unit square.
+ *
+ * Cells are numbered row by row, so the cell at column i and row j
+ * is number i + width*j. The default 4x4 grid matches the numbering
+ * used by getCellFromPosition.
+ */
 struct Grid {
 public:
-    // Hard coded grid size
-    static const int num_cells = 16;
+    // The dimensions of a grid, in cells.
+    struct Shape {
+        int width;
+        int height;
+    };
+
+    Grid(int width=4, int height=4): cell_ids(width*height) {
+        shape.width = width;
+        shape.height = height;
+    }
+
+    int num_cells(void) const {
+        return shape.width*shape.height;
+    }
+
+    // Find the cell a position in the unit square lies in.
+    static int cell_from_position(Shape const& shape, float x, float y) {
+        return static_cast<int>(x*shape.width)
+            + shape.width*static_cast<int>(y*shape.height);
+    }
+
+    // Find the rank a cell should live on when the cells are split
+    // into contiguous blocks over rank_count ranks.
+    static int rank_of_cell(Shape const& shape, int cell, int rank_count) {
+        long cell_count = static_cast<long>(shape.width)*shape.height;
+        long rank_cells = cell*static_cast<long>(rank_count);
+
+        return static_cast<int>(rank_cells/cell_count);
+    }
+
+    // Read a shape given as "WxH", or as "N" for an N x N grid.
+    // Returns false if the text isn't a valid shape.
+    static bool parse_shape(char const *text, Shape *shape) {
+        int width;
+        int height;
+        char extra;
+
+        int count = std::sscanf(text, "%dx%d%c", &width, &height, &extra);
+        if(count == 1) height = width;
+        else if(count != 2) return false;
+
+        if(width <= 0 || height <= 0) return false;
+
+        shape->width = width;
+        shape->height = height;
+
+        return true;
+    }
+
+    Shape shape;
 
     // A list of ids of every cell in the grid
-    ActorModel::Id cell_ids[num_cells];
+    std::vector<ActorModel::Id> cell_ids;
 };
 
 
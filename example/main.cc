@@ -6,6 +6,7 @@
 
 #include "./cell.h"
 #include "./frog.h"
+#include "./grid.h"
 
 int main(int argc, char *argv[]) {
 
@@ -14,8 +15,19 @@ int main(int argc, char *argv[]) {
     // scope ensures classes are destroyed before Director::finalize
     {
 
-        // Set a big enough message buffer to run the simulation
-        ActorModel::Director::set_buffer_size(50000);
+        // The grid is given as WxH, or N for an NxN grid
+        Grid::Shape grid_shape = {4, 4};
+        if(argc > 5 && !Grid::parse_shape(argv[5], &grid_shape)) {
+            std::cerr << "Invalid grid: " << argv[5] << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        long num_cells = static_cast<long>(grid_shape.width)*grid_shape.height;
+
+        // Set a big enough message buffer to run the simulation,
+        // with room for the cell lists sent to newborn frogs
+        ActorModel::Director::set_buffer_size(
+            50000 + 100*num_cells*sizeof(ActorModel::Id)
+        );
 
         /**
          * Create a director.
@@ -32,12 +44,6 @@ int main(int argc, char *argv[]) {
         director.register_actor<Cell>();
         director.register_actor<Frog>();
 
-        // Initialize Frog's RNG
-        int rank;
-        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-        RNG_state = -1-rank;
-        initialiseRNG(&RNG_state);
-
         // Set up our simulation parameters
         if(director.is_root()) {
             Simulation *simulation = director.add_actor<Simulation>();
@@ -48,26 +54,24 @@ int main(int argc, char *argv[]) {
             int max_frog_count = 100;
             double frog_output_interval = 0.005; // in seconds
 
-            int num_cells = 16;
 
             double year_length = 0.01; // in seconds
             int years_to_model = 100;
 
+            unsigned long seed = 1;
+
             // Parse our input parameters, if any
             if(argc > 1) initial_frog_count = atoi(argv[1]);
             if(argc > 2) infected_frog_count = atoi(argv[2]);
             if(argc > 3) max_frog_count = atoi(argv[3]);
             if(argc > 4) frog_output_interval = atof(argv[4]);
 
-            /*
-             * Ignore this argument, because biologist's enumeration
-             * scheme is hard coded for 16 cells.
-             */
-            // if(argc > 5) num_cells = atoi(argv[5]);
 
             if(argc > 6) year_length = atof(argv[6]);
             if(argc > 7) years_to_model = atoi(argv[7]);
 
+            if(argc > 8) seed = strtoul(argv[8], NULL, 10);
+
             simulation->initialize(
                 &director,
 
@@ -76,15 +80,21 @@ int main(int argc, char *argv[]) {
                 max_frog_count,
                 frog_output_interval,
 
-                num_cells,
+                grid_shape.width,
+                grid_shape.height,
 
                 year_length,
-                years_to_model
+                years_to_model,
+
+                seed
             );
         }
 
         director.run();
 
+        // Summarize where the time went, away from the simulation data
+        director.print_statistics(std::cerr);
+
     }
 
     ActorModel::Director::finalize();
@@ -0,0 +1,65 @@
+#!/usr/bin/env bash
+#
+# Sweep the frog model benchmark over a range of process counts.
+#
+# Strong scaling keeps the grid and the total number of frogs fixed,
+# while weak scaling keeps the number of cells and of frogs per process
+# fixed, growing the grid with the processes. The grid used is given
+# in each row. Results are written as CSV to standard output.
+#
+# Usage: ./scaling.sh [ranks...]
+#  eg ./scaling.sh 1 2 4 8 16 32
+#
+# The problem can be set with these environment variables:
+#  GRID            the grid for strong scaling, as WxH or N for NxN
+#                  (default 4x4)
+#  FROGS           total frogs for strong scaling (default 256)
+#  CELLS_PER_RANK  cells per process for weak scaling (default 16)
+#  FROGS_PER_RANK  frogs per process for weak scaling (default 64)
+#  HOPS            hops made by every frog (default 200)
+#  SEED            random number seed (default 1)
+#  REPEATS         runs of each configuration (default 3)
+#  MPIEXEC         command used to launch (default mpiexec)
+
+set -e
+
+cd "$(dirname "$0")"
+make -s benchmark
+
+RANK_COUNTS=${@:-1 2 4 8}
+
+GRID=${GRID:-4x4}
+FROGS=${FROGS:-256}
+CELLS_PER_RANK=${CELLS_PER_RANK:-16}
+FROGS_PER_RANK=${FROGS_PER_RANK:-64}
+HOPS=${HOPS:-200}
+SEED=${SEED:-1}
+REPEATS=${REPEATS:-3}
+MPIEXEC=${MPIEXEC:-mpiexec}
+
+# The squarest WxH grid with the given number of cells
+square_grid() {
+    local cells=$1
+    local width=1
+    local w
+
+    for ((w=1; w*w<=cells; w++)); do
+        if ((cells % w == 0)); then width=$w; fi
+    done
+
+    echo "$((cells/width))x$width"
+}
+
+echo "mode,ranks,grid,frogs,hops_per_frog,seed,seconds,actor_hops_per_second"
+
+for ranks in $RANK_COUNTS; do
+    for repeat in $(seq $REPEATS); do
+        echo -n "strong,"
+        $MPIEXEC -n $ranks ./benchmark $GRID $FROGS $HOPS $SEED
+
+        echo -n "weak,"
+        $MPIEXEC -n $ranks ./benchmark \
+            $(square_grid $((CELLS_PER_RANK*ranks))) \
+            $((FROGS_PER_RANK*ranks)) $HOPS $SEED
+    done
+done
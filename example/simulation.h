@@ -1,12 +1,12 @@
 #ifndef SIMULATION_H_
 #define SIMULATION_H_
 
-#include <sys/time.h>
 #include <vector>
 
 #include "../src/actor.h"
 #include "./cell.h"
 #include "./frog.h"
+#include "./grid.h"
 
 /**
  * Simulation managing actor.
@@ -18,39 +18,54 @@ class Simulation: public ActorModel::Actor {
 public:
     Simulation(): _director(NULL) {}
 
+    // Simulation timer tags.
+    // These must not clash with the tags the simulation is sent
+    // by cells and frogs.
+    enum {
+        /**
+         * Timer tag: YEAR_END
+         *
+         * Fired at the end of every year.
+         */
+        YEAR_END=10,
+
+        /**
+         * Timer tag: FROG_OUTPUT
+         *
+         * Fired every frog_output_interval.
+         */
+        FROG_OUTPUT
+    };
+
     void main(void) {
         // Receive and output cell data
         Message message;
         while(get_message(&message)) {
             switch(message.tag()) {
 
-                // Receive and output requested cell data.
+                // Receive and output the gathered cell data.
+                // The data arrives in the same order as the cell list.
                 case Cell::POPULATION_DATA: {
-                    Cell::PopulationData population_data =
-                        message.data<Cell::PopulationData>();
-
-                    ActorModel::Id cell_id = message.sender();
-                    int cellnum=-1;
-                    // Find which cell's data we just received
-                    for(int i=0; i<_cell_list_size; i++) {
-                        ActorModel::Id test = _cell_list[i];
-
-                        if(
-                            test.rank() == cell_id.rank() &&
-                            test.gid() == cell_id.gid()
-                        ) {
-                            cellnum = i;
-
-                            break;
-                        }
-                    }
+                    int cell_count =
+                        message.data_size<Cell::PopulationData>();
+
+                    std::vector<Cell::PopulationData> population_data(
+                        cell_count
+                    );
+                    message.data<Cell::PopulationData>(
+                        &population_data[0], cell_count
+                    );
 
                     // Output the data to the screen
-                    std::cout << "DATA: ("
-                              << cellnum << ","
-                              << population_data.populationInflux << ","
-                              << population_data.infectionLevel << ")"
-                              << std::endl;
+                    for(int cellnum=0; cellnum<cell_count; cellnum++) {
+                        std::cout << "DATA: ("
+                                  << cellnum << ","
+                                  << population_data[cellnum].populationInflux
+                                  << ","
+                                  << population_data[cellnum].infectionLevel
+                                  << ")"
+                                  << std::endl;
+                    }
                 } break;
 
                 // Track the current number of frogs in the system
@@ -61,77 +76,22 @@ public:
                     else         _frog_count--;
                 } break;
 
-            }
-        }
-
-        // Find current time
-        double now = second();
-
-        // Perform yearly actions
-        if(now > _year_end) {
-            // Increment current year
-            _current_year++;
-
-            // Reset year timer
-            _year_end = now + _year_length;
-
-            if(_current_year <= _years_to_model) {
-                // Add a little padding before output
-                std::cout << std::endl;
-
-                // Output current year
-                std::cout << "YEAR: " << _current_year << std::endl;
-
-                // Output frog population
-                std::cout << "FROG POPULATION: " << _frog_count << std::endl;
-
-                if(_frog_count > _max_frog_count) {
-                    std::cout
-                        << "ERROR: Frog count exceeded "
-                        << _max_frog_count
-                        << "!"
-                        << std::endl;
-
-                    _director->end();
-
-                    // return early without requesting cell data
-                    return;
-                }
-
-                // Request Cell data to (hopefully) output on next tick
-                for(int i=0; i<_cell_list_size; i++) {
-                    // The following assumes messages arrive in order
+                // Perform yearly actions
+                case YEAR_END: {
+                    end_year();
+                } break;
 
-                    // Request cell data
-                    Cell::PopulationDataRequest request;
-                    request.tag = Cell::POPULATION_DATA;
-                    request.reply = id();
-                    send_message<Cell::PopulationDataRequest>(
-                        _cell_list[i], request, Cell::POPULATION_DATA
-                    );
+                // Output frogs at requested frequency
+                case FROG_OUTPUT: {
+                    std::cout << "FROG POPULATION: " << _frog_count
+                              << std::endl;
+                } break;
 
-                    // Clean cell in monsoon
-                    Cell::PopulationData data = {0, 0};
-                    send_message<Cell::PopulationData>(
-                        _cell_list[i], data, Cell::SET_POPULATION_DATA
-                    );
-                }
-            } else {
-                // The simulation time is up. Kill the director.
-                _director->end();
             }
-
         }
 
-        // Output frogs at requested frequency
-        if(now > _next_frog_output) {
-            _next_frog_output = now + _frog_output_interval;
-
-            // Output frog population
-            std::cout << "FROG POPULATION: " << _frog_count << std::endl;
-        }
-
-
+        // Nothing to do until the next message or timer
+        wait_for_message();
     }
 
 
@@ -146,10 +106,13 @@ public:
         int max_frog_count=100,
         double frog_output_interval=0.5,
 
-        int cell_list_size=16,
+        int grid_width=4,
+        int grid_height=4,
 
         float year_length=2.0,
-        int years_to_model=100
+        int years_to_model=100,
+
+        unsigned long seed=1
     ) {
         _director = director;
 
@@ -158,31 +121,43 @@ public:
         _max_frog_count = max_frog_count;
         _frog_output_interval = frog_output_interval;
 
-        _cell_list_size = cell_list_size;
+        _grid_shape.width = grid_width;
+        _grid_shape.height = grid_height;
+        _cell_list_size = grid_width*grid_height;
 
         _year_length = year_length;
         _years_to_model = years_to_model;
 
         _frog_count = 0;
         _current_year = 0;
-        _year_end = 0.0;
-        _next_frog_output = 0.0;
+
+        // Start the first year straight away
+        schedule_after(0.0, YEAR_END);
+        schedule_every(_frog_output_interval, FROG_OUTPUT);
 
 
-        // Generate grid of cells
+        // Generate grid of cells, split into blocks over the ranks
+        int rank_count;
+        MPI_Comm_size(MPI_COMM_WORLD, &rank_count);
+
         _cell_list.resize(_cell_list_size);
         for(int i=0; i<_cell_list_size; i++) {
-            _cell_list[i] = give_birth<Cell>();
+            _cell_list[i] = give_birth<Cell>(
+                Grid::rank_of_cell(_grid_shape, i, rank_count)
+            );
+            _cell_group.add(_cell_list[i]);
         }
 
 
-        // Generate and initialize frogs
+        // Generate and initialize frogs, each with its own
+        // random number stream
         for(int i=0; i<_initial_frog_count; i++) {
             Frog::Coords coords = {0.0, 0.0};
             ActorModel::Id my_id = id();
 
             ActorModel::Id frog_id = Frog::give_birth_and_initialize(
-                this, &_cell_list[0], _cell_list_size, coords, my_id
+                this, &_cell_list[0], _grid_shape, coords, my_id,
+                CounterRandom::from_seed(seed, i)
             );
 
 
@@ -196,17 +171,67 @@ public:
         }
     }
 
-    double second(void) {
-        struct timeval tp;
-        struct timezone tzp;
 
-        gettimeofday(&tp, &tzp);
+private:
 
-        return ( ((double) tp.tv_sec) + ((double) tp.tv_usec) * 1.0e-6 );
-    }
+    /*
+     * Move on to the next year, outputting the population data
+     * and resetting the cells.
+     */
+    void end_year(void) {
+        // Increment current year
+        _current_year++;
 
+        if(_current_year > _years_to_model) {
+            // The simulation time is up. Kill the director.
+            _director->end();
 
-private:
+            return;
+        }
+
+        // Start the timer for the next year
+        schedule_after(_year_length, YEAR_END);
+
+        // Add a little padding before output
+        std::cout << std::endl;
+
+        // Output current year
+        std::cout << "YEAR: " << _current_year << std::endl;
+
+        // Output frog population
+        std::cout << "FROG POPULATION: " << _frog_count << std::endl;
+
+        if(_frog_count > _max_frog_count) {
+            std::cout
+                << "ERROR: Frog count exceeded "
+                << _max_frog_count
+                << "!"
+                << std::endl;
+
+            _director->end();
+
+            // return early without requesting cell data
+            return;
+        }
+
+        // Request Cell data to (hopefully) output on next tick.
+        // The following assumes messages arrive in order.
+
+        // Gather cell data from every cell
+        Cell::PopulationDataRequest request;
+        request.tag = Cell::POPULATION_DATA;
+        request.reply = id();
+        gather_group<Cell::PopulationDataRequest>(
+            _cell_group, request,
+            Cell::POPULATION_DATA, Cell::POPULATION_DATA
+        );
+
+        // Clean cells in monsoon
+        Cell::PopulationData data = {0, 0};
+        send_to_group<Cell::PopulationData>(
+            _cell_group, data, Cell::SET_POPULATION_DATA
+        );
+    }
 
     int _initial_frog_count;
     int _initial_infected_frog_count;
@@ -219,11 +244,13 @@ private:
     ActorModel::Director *_director;
 
     int _current_year;
-    double _year_end;
-    double _next_frog_output;
 
     std::vector<ActorModel::Id> _cell_list;
     int _cell_list_size;
+    Grid::Shape _grid_shape;
+
+    // The cells, for messaging all at once
+    ActorModel::Group _cell_group;
 
     int _frog_count;
 };
@@ -2,11 +2,27 @@
 #define ACTOR_ACTOR_H_
 
 #include <iostream>
-#include <mpi.h>
+#include <queue>
+#include <deque>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <typeinfo>
+#include "./backend.h"
 
 #include "./id.h"
 #include "./distributed_factory.h"
 #include "./compound_message.h"
+#include "./persistent_message.h"
+#include "./shared_transport.h"
+#include "./exchange.h"
+#include "./group.h"
+#include "./collector.h"
+#include "./timers.h"
+#include "./statistics.h"
+#include "./trace.h"
+#include "./checkpoint.h"
 
 
 namespace ActorModel {
@@ -38,10 +54,27 @@ public:
      */
 
     // Constructor
-    Actor(): _is_dead(false), _id() {}
+    Actor():
+        _is_dead(false), _is_waiting_for_message(false), _id(),
+        _lineage(0), _children(0), _mailbox_window(0),
+        _is_timing_messages(false), _request_count(0),
+        _registered_aliases(0), _reads_pipeline(true)
+    {}
 
     // Destructor
-    virtual ~Actor(){}
+    virtual ~Actor() {
+        // Clean up handlers for replies that never arrived
+        for(
+            std::map<int, ReplyHandler*>::iterator it = _reply_handlers.begin();
+            it != _reply_handlers.end(); ++it
+        ) {
+            delete it->second;
+        }
+
+        for(size_t i=0; i<_channels.size(); i++) {
+            delete _channels[i];
+        }
+    }
 
     // The main function that must be overloaded when defining a new actor.
     virtual void main(void)=0;
@@ -57,17 +90,35 @@ public:
         return _is_dead;
     }
 
+    // Ask the Director not to run this actor again until a new
+    // message has been delivered to it. An actor waiting for a
+    // message costs nothing to schedule.
+    void wait_for_message(void) {
+        _is_waiting_for_message = true;
+    }
+
 
     // Get the id of this actor.
     Id id(void) {
         return _id;
     }
 
+    // Get the performance counters of this actor.
+    ActorCounters const& counters(void) const {
+        return _counters;
+    }
+
 
     // Give birth to a child. The id of the child is returned immediately.
+    // If no rank is given, the child is placed where the placement puts
+    // its lineage, or in a balanced manner.
     template<class T>
-    Id give_birth(void) {
-        return _distributed_factory->request_distributed_child<T>();
+    Id give_birth(int rank=-1) {
+        uint64_t lineage = Placement::child_lineage(_lineage, _children++);
+
+        return _distributed_factory->request_distributed_child<T>(
+            rank, lineage
+        );
     }
 
 
@@ -81,8 +132,27 @@ public:
         struct MetaData {
             Id sender_id;
             int tag;
+            int collective_id;
+            int correlation_id;
+            int in_reply_to;
+            int credits;
+            int flags;
+        };
+
+        // The metadata of a message stamped with when it was sent, by
+        // MPI_Wtime on the sender. Only timed messages carry the stamp.
+        struct TimedMetaData {
+            MetaData metadata;
+            double sent_at;
         };
 
+        // Values of credits. A message either takes one of its sender's
+        // credits, or returns credits to the actor it's sent to.
+        enum { UNCOUNTED = 0, TAKES_CREDIT = 1, RETURNS_CREDITS = -1 };
+
+        // Bits of flags. A timed message has TimedMetaData.
+        enum { IS_TIMED = 1 };
+
         // Get the id of the sender.
         Id sender(void) {
             return metadata<MetaData>().sender_id;
@@ -92,20 +162,69 @@ public:
         int tag(void) {
             return metadata<MetaData>().tag;
         }
+
+        // Check if the message is a request to contribute to a
+        // gather or reduction.
+        bool is_collective(void) {
+            return metadata<MetaData>().collective_id != 0;
+        }
+
+        // Get the id of the collective the message belongs to.
+        int collective_id(void) {
+            return metadata<MetaData>().collective_id;
+        }
+
+        // Check if the message was sent with ask and awaits a reply.
+        bool is_request(void) {
+            return metadata<MetaData>().correlation_id != 0;
+        }
+
+        // Check if the sender expects an answer through reply.
+        bool expects_reply(void) {
+            return is_request() || is_collective();
+        }
+
+        // Get the correlation id of a request.
+        int correlation_id(void) {
+            return metadata<MetaData>().correlation_id;
+        }
+
+        // Get the correlation id of the request this message replies to.
+        // This is 0 if the message isn't a reply.
+        int in_reply_to(void) {
+            return metadata<MetaData>().in_reply_to;
+        }
+
+        // Get the gid of the actor the message was sent to.
+        int receiver_gid(void) {
+            return CompoundMessage::tag();
+        }
+
+        // Get when the message was sent, by MPI_Wtime on the sender,
+        // if it was timed, or 0.
+        double sent_at(void) {
+            if(!(metadata<MetaData>().flags & IS_TIMED)) return 0.0;
+            return metadata<TimedMetaData>().sent_at;
+        }
+
+        // Get when the message arrived on this process, by MPI_Wtime,
+        // if messages are being timed.
+        double arrived_at(void) const {
+            return _arrived_at;
+        }
+
+        Message(): _arrived_at(0.0) {}
+
+    private:
+        friend class Actor;
+
+        double _arrived_at;
     };
 
     // Send an array of data
     template<class T>
     void send_message(Id const& actor_id, T *data, size_t data_count, int tag) {
-        Message::MetaData metadata;
-
-        metadata.sender_id = _id;
-        metadata.tag       = tag;
-
-        Message::send_message<T, Message::MetaData>(
-            actor_id.rank(), actor_id.gid(),
-            data, data_count, &metadata, _comm
-        );
+        send_tagged_message<T>(actor_id, data, data_count, tag, 0, 0);
     }
 
     // Send an individual datum
@@ -114,36 +233,1037 @@ public:
         send_message<T>(actor_id, &data, 1, tag);
     }
 
+
+    /**
+     * Pieces for flow control
+     *
+     * With a mailbox window set (see Director::set_mailbox_window), an
+     * actor can only have so many messages sent to another that the
+     * receiver hasn't taken yet. Each message takes a credit, and the
+     * receiver hands credits back as it takes messages with get_message,
+     * or as their replies are routed.
+     *
+     * A message sent without credit is held by the sender, in order,
+     * until credit returns, and the Director doesn't run the sender
+     * again until everything it held has been sent. Only a window of
+     * messages can be held for each receiver. Sending another throws
+     * MailboxFull, so an actor that sends more than twice the window
+     * to one receiver in a single run must either catch it, or use
+     * try_send_message, which sends nothing if the message would be
+     * held. Actors that flood each other in a cycle should do so, as
+     * neither runs to take messages while both are held up.
+     *
+     * With a window set, send_to_group sends each member its own
+     * message, so each takes a credit like any other.
+     */
+
+    // Check if a message to an actor would be sent straight away.
+    bool can_send(Id const& actor_id) {
+        if(_mailbox_window <= 0) return true;
+
+        int gid = actor_id.gid();
+        if(_held_messages.count(gid) != 0) return false;
+
+        std::map<int, int>::iterator used = _credits_used.find(gid);
+        return used == _credits_used.end() || used->second < _mailbox_window;
+    }
+
+    // Check if a message to an actor would be sent or held, rather
+    // than throw MailboxFull.
+    bool can_hold(Id const& actor_id) {
+        if(_mailbox_window <= 0) return true;
+
+        std::map<int, HeldQueue>::iterator queue =
+            _held_messages.find(actor_id.gid());
+        return queue == _held_messages.end()
+            || queue->second.messages.size() < static_cast<size_t>(_mailbox_window);
+    }
+
+    // Exception class to throw when a message is sent to an actor
+    // with a full window of messages already held for it.
+    class MailboxFull: public std::exception {
+        virtual const char* what() const throw() {
+            return "Mailbox full!";
+        }
+    };
+
+    // Check if any messages are held waiting for credit.
+    bool is_held_up(void) const {
+        return !_held_messages.empty();
+    }
+
+    // Get the number of messages delivered to this actor by the
+    // Director and not yet taken.
+    size_t mailbox_size(void) const {
+        return _mailbox.size();
+    }
+
+    // Send an array of data if it can be sent straight away, and
+    // return whether it was.
+    template<class T>
+    bool try_send_message(
+        Id const& actor_id, T *data, size_t data_count, int tag
+    ) {
+        if(!can_send(actor_id)) return false;
+
+        send_message<T>(actor_id, data, data_count, tag);
+        return true;
+    }
+
+    // Send an individual datum if it can be sent straight away.
+    template<class T>
+    bool try_send_message(Id const& actor_id, T data, int tag) {
+        return try_send_message<T>(actor_id, &data, 1, tag);
+    }
+
+    // Send an array of data to every actor in a group.
+    // Only one message is sent to each rank the group lives on,
+    // and the Director on that rank hands it to the local members.
+    // With a mailbox window set, each member is sent its own message
+    // instead, and nothing is sent if any of them would throw
+    // MailboxFull.
+    template<class T>
+    void send_to_group(
+        Group const& group, T *data, size_t data_count, int tag
+    ) {
+        if(_mailbox_window > 0) {
+            for(size_t i=0; i<group.size(); i++) {
+                if(!can_hold(group[i])) throw MailboxFull();
+            }
+
+            for(size_t i=0; i<group.size(); i++) {
+                send_tagged_message<T>(group[i], data, data_count, tag, 0, 0);
+            }
+            return;
+        }
+
+        GroupMessage::send<T>(group, _id, tag, data, data_count, _group_comm);
+
+        count_sent(data_count*sizeof(T));
+    }
+
+    // Send an individual datum to every actor in a group.
+    template<class T>
+    void send_to_group(Group const& group, T data, int tag) {
+        send_to_group<T>(group, &data, 1, tag);
+    }
+
+
+    /**
+     * Pieces for channels
+     *
+     * A channel sends messages with the same tag and number of values
+     * to the same actor over and over, as an actor reporting to another
+     * every tick does. Where the messages go through MPI, the sends are
+     * set up once as persistent requests and restarted for each message.
+     * Messages to actors on the same node, or staged for an exchange
+     * (see Director::set_exchange_mode), are sent as usual.
+     *
+     * Messages sent on a channel are received like any other.
+     * A channel lasts until it is closed or the actor that opened it
+     * dies, and isn't saved in checkpoints, so open channels as they're
+     * needed.
+     *
+     *  if(!_landed.is_open()) _landed = open_channel<bool>(cell, LANDED);
+     *  _landed.send(is_infected);
+     */
+
+    template<class T>
+    class Channel {
+    public:
+        Channel(): _actor(NULL), _data_count(0), _tag(0), _message(NULL) {}
+
+        // Check if the channel has been opened.
+        bool is_open(void) const {
+            return _actor != NULL;
+        }
+
+        // Send the channel's number of values.
+        void send(T *data) {
+            _actor->send_on_channel<T>(
+                _message, _receiver, data, _data_count, _tag
+            );
+        }
+
+        // Send an individual datum on a channel of single values.
+        void send(T data) {
+            send(&data);
+        }
+
+    private:
+        friend class Actor;
+
+        Channel(
+            Actor *actor, Id const& receiver, size_t data_count, int tag,
+            PersistentMessage *message
+        ):
+            _actor(actor), _receiver(receiver),
+            _data_count(data_count), _tag(tag), _message(message)
+        {}
+
+        Actor *_actor;
+        Id _receiver;
+        size_t _data_count;
+        int _tag;
+
+        // The persistent sends, or NULL if the receiver is on this node.
+        PersistentMessage *_message;
+    };
+
+    // Open a channel for sending data_count values to an actor
+    // with the given tag.
+    template<class T>
+    Channel<T> open_channel(Id const& actor_id, int tag, size_t data_count=1) {
+        PersistentMessage *message = NULL;
+
+        if(
+            !_transport->is_local(actor_id.process())
+            && !_exchange->is_enabled()
+        ) {
+            message = new PersistentMessage(
+                actor_id.process(), actor_id.gid(),
+                metadata_bytes(_is_timing_messages), data_count*sizeof(T),
+                _comm
+            );
+            _channels.push_back(message);
+        }
+
+        return Channel<T>(this, actor_id, data_count, tag, message);
+    }
+
+    // Close a channel, freeing its persistent sends once they finish.
+    // The channel is left unopened.
+    template<class T>
+    void close_channel(Channel<T>& channel) {
+        std::vector<PersistentMessage*>::iterator it = std::find(
+            _channels.begin(), _channels.end(), channel._message
+        );
+        if(it != _channels.end()) {
+            delete *it;
+            _channels.erase(it);
+        }
+
+        channel = Channel<T>();
+    }
+
+    /**
+     * Pieces for request/reply messaging
+     *
+     * A request sent with ask carries a correlation id. The receiver
+     * answers it with reply, and the reply is routed straight to
+     * whatever is waiting on it rather than being returned by
+     * get_message. Any number of requests can be outstanding at once.
+     *
+     * Replies are routed whenever the asking actor checks for messages,
+     * either through get_message or Future::ready.
+     */
+
+    // A handle on the reply to a request.
+    template<class R>
+    class Future {
+    public:
+        Future(): _actor(NULL), _correlation_id(0) {}
+
+        // Check if the reply has arrived.
+        bool ready(void) {
+            _actor->route_replies();
+            return _actor->_replies.count(_correlation_id) != 0;
+        }
+
+        // Get the reply. This should only be called once ready()
+        // returns true, and only once per request.
+        R get(void) {
+            std::map<int, Message>::iterator it =
+                _actor->_replies.find(_correlation_id);
+
+            R reply = it->second.template data<R>();
+            _actor->_replies.erase(it);
+
+            return reply;
+        }
+
+    private:
+        friend class Actor;
+
+        Future(Actor *actor, int correlation_id):
+            _actor(actor), _correlation_id(correlation_id)
+        {}
+
+        Actor *_actor;
+        int _correlation_id;
+    };
+
+    // Send a request and get a Future for the reply.
+    template<class R, class T>
+    Future<R> ask(Id const& actor_id, T request, int tag) {
+        int correlation_id = send_request<T>(actor_id, request, tag);
+
+        return Future<R>(this, correlation_id);
+    }
+
+    // Send a request, and call a member function of this actor
+    // with the reply when it arrives.
+    //  ask(cell_id, request, Cell::POPULATION_DATA, &Frog::update);
+    template<class R, class T, class A>
+    void ask(Id const& actor_id, T request, int tag, void (A::*handler)(R)) {
+        int correlation_id = send_request<T>(actor_id, request, tag);
+
+        _reply_handlers[correlation_id] =
+            new MemberReplyHandler<A, R>(static_cast<A*>(this), handler);
+    }
+
+    // Answer a message sent with ask, gather_group or reduce_group.
+    // Requests are answered with the same tag they were sent with.
+    template<class T>
+    void reply(Message& request, T value) {
+        if(request.is_collective()) {
+            contribute<T>(request, value);
+        } else {
+            send_tagged_message<T>(
+                request.sender(), &value, 1, request.tag(),
+                0, request.correlation_id()
+            );
+        }
+    }
+
+
+    /**
+     * Pieces for gathering and reducing values over a group
+     *
+     * The data passed is sent to every member of the group with the
+     * given tag, and each member should answer by calling contribute
+     * with the message it received. Partial results are combined on
+     * each rank before being sent back, and the final result is
+     * delivered to this actor as a single message tagged reply_tag.
+     *
+     * If a member dies without contributing, the result will never
+     * be delivered.
+     */
+
+    // Gather a value from every member of a group. The result is an
+    // array of the contributed values in the order of the group.
+    template<class T>
+    void gather_group(
+        Group const& group, T *data, size_t data_count,
+        int tag, int reply_tag
+    ) {
+        start_collective<T>(
+            group, data, data_count, tag, reply_tag, Collector::GATHER
+        );
+    }
+
+    template<class T>
+    void gather_group(Group const& group, T data, int tag, int reply_tag) {
+        gather_group<T>(group, &data, 1, tag, reply_tag);
+    }
+
+    // Reduce a value from every member of a group using the
+    // registered reduction operation Op. The result is a single
+    // Op::value_type.
+    template<class Op, class T>
+    void reduce_group(
+        Group const& group, T *data, size_t data_count,
+        int tag, int reply_tag
+    ) {
+        start_collective<T>(
+            group, data, data_count, tag, reply_tag,
+            _collector->get_reduction_id<Op>()
+        );
+    }
+
+    template<class Op, class T>
+    void reduce_group(Group const& group, T data, int tag, int reply_tag) {
+        reduce_group<Op, T>(group, &data, 1, tag, reply_tag);
+    }
+
+    // Answer a gather or reduction request with a value.
+    // Every contribution to a collective must be of the same type.
+    template<class T>
+    void contribute(Message& request, T value) {
+        _collector->contribute(
+            request.collective_id(), _id.gid(), &value, sizeof(T)
+        );
+    }
+
+
+    /**
+     * Pieces for timers
+     *
+     * When a timer fires, the Director delivers a message with the
+     * timer's tag to this actor, sent from this actor. The message
+     * data is the int id of the timer. An actor waiting for a message
+     * is woken by its timers, so it needn't poll the clock.
+     */
+
+    // Fire a timer once, after delay seconds.
+    // Returns an id that can be used to cancel the timer.
+    int schedule_after(double delay, int tag) {
+        return _timers->schedule(_id.gid(), tag, delay);
+    }
+
+    // Fire a timer every period seconds, starting one period from now.
+    int schedule_every(double period, int tag) {
+        return _timers->schedule(_id.gid(), tag, period, period);
+    }
+
+    // Stop a timer from firing again.
+    void cancel_timer(int timer_id) {
+        _timers->cancel(timer_id);
+    }
+
+
+    /**
+     * Pieces for checkpoints
+     *
+     * An actor opts in to checkpoints by overriding save to write its
+     * fields and return true, and restore to read them back in the
+     * same order. The Director saves the rest, such as the actor's id
+     * and the messages in its mailbox. A checkpoint can't be taken
+     * while any actor hasn't opted in, or is waiting on a reply
+     * handler set with ask.
+     *
+     * On restart, restore is called on an actor made by the factory,
+     * in place of it being constructed and run up to the checkpoint.
+     */
+    virtual bool save(CheckpointWriter&) {
+        return false;
+    }
+
+    virtual void restore(CheckpointReader&) {}
+
+
     // Check and receive a message if one is waiting.
+    // Messages already delivered locally by the Director are
+    // returned before any waiting in the MPI pipeline.
+    // Replies to requests sent with ask are routed to their
+    // handlers and aren't returned.
     bool get_message(Message* my_message) {
-        return my_message->receive_message(MPI_ANY_SOURCE, _id.gid(), _comm);
+        while(next_message(my_message)) {
+            if(!route_reply(*my_message)) {
+                count_received(*my_message);
+
+                return true;
+            }
+        }
+
+        _counters.empty_polls++;
+
+        return false;
+    }
+
+
+protected:
+
+    // Have messages sent to another gid on this process delivered
+    // to this actor too. This is used by actors standing in for others.
+    void add_alias(int gid) {
+        _aliases.push_back(gid);
+    }
+
+    // Stop messages sent to an alias being delivered to this actor.
+    // The Director treats the gid as dead from then on.
+    void remove_alias(int gid) {
+        std::vector<int>::iterator it =
+            std::find(_aliases.begin(), _aliases.end(), gid);
+        if(it == _aliases.end()) return;
+
+        if(static_cast<size_t>(it - _aliases.begin()) < _registered_aliases) {
+            _registered_aliases--;
+        }
+        _aliases.erase(it);
+
+        _removed_aliases.push_back(gid);
+    }
+
+    // Send a message on behalf of sender_id, with the given
+    // correlation ids in the metadata.
+    template<class T>
+    void send_tagged_message(
+        Id const& sender_id, Id const& actor_id,
+        T *data, size_t data_count, int tag,
+        int correlation_id, int in_reply_to
+    ) {
+        Message::TimedMetaData stamped;
+        Message::MetaData& metadata = stamped.metadata;
+
+        metadata.sender_id      = sender_id;
+        metadata.tag            = tag;
+        metadata.collective_id  = 0;
+        metadata.correlation_id = correlation_id;
+        metadata.in_reply_to    = in_reply_to;
+        metadata.credits        = Message::UNCOUNTED;
+        stamp_sent(stamped);
+
+        if(!can_hold(actor_id)) throw MailboxFull();
+
+        count_sent(actor_id, data_count*sizeof(T));
+
+        if(_mailbox_window > 0) {
+            metadata.credits = Message::TAKES_CREDIT;
+
+            if(!can_send(actor_id)) {
+                hold_message(actor_id, stamped, data, data_count*sizeof(T));
+                return;
+            }
+
+            _credits_used[actor_id.gid()]++;
+        }
+
+        dispatch_message(actor_id, stamped, data, data_count*sizeof(T));
+    }
+
+    // Send a message through shared memory, the exchange, or MPI,
+    // whichever suits the actor it's sent to. The send time is only
+    // sent if the message is timed.
+    void dispatch_message(
+        Id const& actor_id, Message::TimedMetaData const& stamped,
+        void const *data, size_t data_bytes
+    ) {
+        dispatch_message(
+            _transport, _exchange, _comm, actor_id, stamped, data, data_bytes
+        );
+    }
+
+    static void dispatch_message(
+        SharedTransport *transport, Exchange *exchange, MPI_Comm comm,
+        Id const& actor_id, Message::TimedMetaData stamped,
+        void const *data, size_t data_bytes
+    ) {
+        bool is_timed = stamped.metadata.flags & Message::IS_TIMED;
+
+        if(transport->is_local(actor_id.process())) {
+            transport->send(
+                actor_id.process(), actor_id.gid(),
+                &stamped, metadata_bytes(is_timed), data, data_bytes
+            );
+        } else if(exchange->is_enabled()) {
+            exchange->send(
+                actor_id.process(), actor_id.gid(),
+                &stamped, metadata_bytes(is_timed), data, data_bytes
+            );
+        } else if(is_timed) {
+            Message::send_message<char, Message::TimedMetaData>(
+                actor_id.process(), actor_id.gid(),
+                static_cast<char*>(const_cast<void*>(data)), data_bytes,
+                &stamped, comm
+            );
+        } else {
+            Message::send_message<char, Message::MetaData>(
+                actor_id.process(), actor_id.gid(),
+                static_cast<char*>(const_cast<void*>(data)), data_bytes,
+                &stamped.metadata, comm
+            );
+        }
+
+        Trace::send(
+            stamped.metadata.sender_id.gid(), actor_id.process(), actor_id.gid()
+        );
+    }
+
+    // The number of bytes of metadata sent with a message.
+    static size_t metadata_bytes(bool is_timed) {
+        return is_timed
+            ? sizeof(Message::TimedMetaData) : sizeof(Message::MetaData);
     }
 
 
 private:
 
-    // Initialize an actor with a given id, communicator
-    // and distributed factory.
+    // Initialize an actor with a given id, communicators, shared
+    // memory transport, exchange, distributed factory, collector,
+    // timers, the statistics of the rank it's on, and the mailbox
+    // window and message timing of its Director.
     void initialize_comms(
-        Id id, MPI_Comm comm,
-        DistributedFactory<Actor> *distributed_factory
+        Id id, MPI_Comm comm, MPI_Comm group_comm,
+        SharedTransport *transport, Exchange *exchange,
+        DistributedFactory<Actor> *distributed_factory,
+        Collector *collector, Timers *timers, Statistics *statistics,
+        int mailbox_window, bool is_timing_messages
     ) {
         _id = id;
         _comm = comm;
+        _transport = transport;
+        _exchange = exchange;
+        _group_comm = group_comm;
         _distributed_factory = distributed_factory;
+        _collector = collector;
+        _timers = timers;
+        _statistics = statistics;
+        _mailbox_window = mailbox_window;
+        _is_timing_messages = is_timing_messages;
+    }
+
+    // Start a gather or reduction over a group.
+    template<class T>
+    void start_collective(
+        Group const& group, T *data, size_t data_count,
+        int tag, int reply_tag, int op
+    ) {
+        int collective_id = _collector->new_collective_id();
+
+        _collector->expect_result(
+            collective_id, op, group.rank_count(), group.size(),
+            _id, reply_tag
+        );
+
+        GroupMessage::send<T>(
+            group, _id, tag, data, data_count, _group_comm,
+            collective_id, op
+        );
+
+        count_sent(data_count*sizeof(T));
     }
 
+    // Hand a message to the actor without going through MPI.
+    void deliver(Message const& message) {
+        Message delivered = message;
+        stamp_arrival(delivered);
+
+        if(!take_credit(delivered)) _mailbox.push(delivered);
+    }
+
+    // Check if the actor asked to wait for a message and has none
+    // waiting in its mailbox. The request is cleared after checking.
+    bool is_waiting_for_message(void) {
+        bool is_waiting = _is_waiting_for_message && _mailbox.empty();
+        _is_waiting_for_message = false;
+
+        return is_waiting;
+    }
+
+    // Send a message with the given correlation ids in the metadata.
+    template<class T>
+    void send_tagged_message(
+        Id const& actor_id, T *data, size_t data_count, int tag,
+        int correlation_id, int in_reply_to
+    ) {
+        send_tagged_message<T>(
+            _id, actor_id, data, data_count, tag, correlation_id, in_reply_to
+        );
+    }
+
+    // Send a message on a channel, through its persistent sends if
+    // it has them.
+    template<class T>
+    void send_on_channel(
+        PersistentMessage *message, Id const& actor_id,
+        T *data, size_t data_count, int tag
+    ) {
+        // Held messages are sent as usual, so with a mailbox window
+        // channels don't use their persistent sends
+        if(message == NULL || _mailbox_window > 0) {
+            send_tagged_message<T>(actor_id, data, data_count, tag, 0, 0);
+            return;
+        }
+
+        Message::TimedMetaData stamped;
+        Message::MetaData& metadata = stamped.metadata;
+
+        metadata.sender_id      = _id;
+        metadata.tag            = tag;
+        metadata.collective_id  = 0;
+        metadata.correlation_id = 0;
+        metadata.in_reply_to    = 0;
+        metadata.credits        = Message::UNCOUNTED;
+        stamp_sent(stamped);
+
+        message->send(&stamped, data);
+
+        count_sent(actor_id, data_count*sizeof(T));
+
+        Trace::send(_id.gid(), actor_id.process(), actor_id.gid());
+    }
+
+    // Count a message taken by this actor, hand back its credit,
+    // and time it if messages are being timed.
+    void count_received(Message& message) {
+        _counters.messages_received++;
+        _counters.bytes_received += message.data_size();
+
+        return_credit(message);
+
+        double sent = message.sent_at();
+        if(!_is_timing_messages || sent == 0.0) return;
+
+        double now = MPI_Wtime();
+        Latency& latency =
+            _statistics->latency(typeid(*this).name(), message.tag());
+        latency.delivery.record(now - sent);
+        latency.queueing.record(now - message._arrived_at);
+    }
+
+    // Stamp a message being sent with the time, if messages are
+    // being timed.
+    void stamp_sent(Message::TimedMetaData& stamped) {
+        stamped.metadata.flags = 0;
+        stamped.sent_at = 0.0;
+
+        if(_is_timing_messages) {
+            stamped.metadata.flags |= Message::IS_TIMED;
+            stamped.sent_at = MPI_Wtime();
+        }
+    }
+
+    // Note when a message arrived on this process.
+    void stamp_arrival(Message& message) {
+        if(_is_timing_messages) message._arrived_at = MPI_Wtime();
+    }
+
+    // Count a message sent by this actor.
+    void count_sent(size_t data_bytes) {
+        _counters.messages_sent++;
+        _counters.bytes_sent += data_bytes;
+    }
+
+    // Count a message sent by this actor to a single actor.
+    void count_sent(Id const& actor_id, size_t data_bytes) {
+        count_sent(data_bytes);
+        _statistics->rank().bytes_sent_to[actor_id.process()] += data_bytes;
+
+        Placement& placement = _distributed_factory->placement();
+        if(placement.is_profiling()) {
+            placement.record_message(_id.gid(), actor_id.gid(), data_bytes);
+        }
+    }
+
+    // A message held by its sender until it has credit to send it.
+    struct HeldMessage {
+        Message::TimedMetaData metadata;
+        std::vector<char> data;
+    };
+
+    // Hold a message back until credit returns.
+    void hold_message(
+        Id const& actor_id, Message::TimedMetaData const& metadata,
+        void const *data, size_t data_bytes
+    ) {
+        HeldMessage held;
+        held.metadata = metadata;
+        held.data.resize(data_bytes);
+        if(data_bytes > 0) std::memcpy(&held.data[0], data, data_bytes);
+
+        HeldQueue& queue = _held_messages[actor_id.gid()];
+        queue.receiver = actor_id;
+        queue.messages.push_back(held);
+    }
+
+    // Send held messages to an actor for as long as there's credit.
+    void release_held_messages(int gid) {
+        std::map<int, HeldQueue>::iterator queue = _held_messages.find(gid);
+        if(queue == _held_messages.end()) return;
+
+        std::deque<HeldMessage>& messages = queue->second.messages;
+        while(!messages.empty() && _credits_used[gid] < _mailbox_window) {
+            HeldMessage& held = messages.front();
+
+            _credits_used[gid]++;
+            dispatch_message(
+                queue->second.receiver, held.metadata,
+                held.data.empty() ? NULL : &held.data[0], held.data.size()
+            );
+
+            messages.pop_front();
+        }
+
+        if(messages.empty()) _held_messages.erase(queue);
+    }
+
+    // Note a message taken by this actor, and hand credits back to
+    // its sender once half a window of them have been taken.
+    void return_credit(Message& message) {
+        if(message.metadata<Message::MetaData>().credits != Message::TAKES_CREDIT) {
+            return;
+        }
+
+        Id sender = message.sender();
+        OwedCredits& owed = _credits_owed[sender.gid()];
+        owed.sender = sender;
+        owed.count++;
+
+        if(owed.count < std::max(1, _mailbox_window/2)) return;
+
+        send_credits(
+            _transport, _exchange, _comm, _id, sender, owed.count
+        );
+        _credits_owed.erase(sender.gid());
+    }
+
+    // Hand back every credit this actor owes, including those of
+    // messages it will never take, as it dies.
+    void return_all_credits(void) {
+        while(!_mailbox.empty()) {
+            Message message = _mailbox.front();
+            _mailbox.pop();
+
+            if(message.metadata<Message::MetaData>().credits == Message::TAKES_CREDIT) {
+                Id sender = message.sender();
+                _credits_owed[sender.gid()].sender = sender;
+                _credits_owed[sender.gid()].count++;
+            }
+        }
+
+        for(
+            std::map<int, OwedCredits>::iterator it = _credits_owed.begin();
+            it != _credits_owed.end(); ++it
+        ) {
+            send_credits(
+                _transport, _exchange, _comm,
+                _id, it->second.sender, it->second.count
+            );
+        }
+        _credits_owed.clear();
+    }
+
+    // Send count credits from one actor back to the actor that spent
+    // them.
+    static void send_credits(
+        SharedTransport *transport, Exchange *exchange, MPI_Comm comm,
+        Id const& from, Id const& to, int count
+    ) {
+        Message::TimedMetaData stamped;
+        Message::MetaData& metadata = stamped.metadata;
+
+        metadata.sender_id      = from;
+        metadata.tag            = 0;
+        metadata.collective_id  = 0;
+        metadata.correlation_id = 0;
+        metadata.in_reply_to    = 0;
+        metadata.credits        = Message::RETURNS_CREDITS;
+        metadata.flags          = 0;
+        stamped.sent_at         = 0.0;
+
+        dispatch_message(
+            transport, exchange, comm, to, stamped, &count, sizeof(count)
+        );
+    }
+
+    // If the message returns credits, take them, send any messages
+    // they free up, and return true.
+    bool take_credit(Message& message) {
+        Message::MetaData metadata = message.metadata<Message::MetaData>();
+        if(metadata.credits != Message::RETURNS_CREDITS) return false;
+
+        int gid = metadata.sender_id.gid();
+
+        // Credits for messages sent before a restart may not have
+        // been counted here
+        int& used = _credits_used[gid];
+        used = std::max(0, used - message.data<int>());
+
+        release_held_messages(gid);
+        if(_credits_used[gid] == 0) _credits_used.erase(gid);
+
+        return true;
+    }
+
+    // Send a request with a new correlation id, and return that id.
+    template<class T>
+    int send_request(Id const& actor_id, T& request, int tag) {
+        // Ids start at 1, as 0 marks a message that isn't a request
+        _request_count++;
+        int correlation_id = _request_count;
+
+        send_tagged_message<T>(actor_id, &request, 1, tag, correlation_id, 0);
+
+        return correlation_id;
+    }
+
+    // Get the next message from the mailbox or the MPI pipeline.
+    bool next_message(Message *my_message) {
+        if(!_mailbox.empty()) {
+            *my_message = _mailbox.front();
+            _mailbox.pop();
+
+            return true;
+        }
+
+        while(
+            _reads_pipeline
+            && (
+                my_message->receive_message(MPI_ANY_SOURCE, _id.gid(), _comm)
+                || _transport->receive(_id.gid(), my_message)
+            )
+        ) {
+            Trace::receive(_id.gid(), my_message->source());
+            stamp_arrival(*my_message);
+
+            if(!take_credit(*my_message)) return true;
+        }
+
+        return false;
+    }
+
+    // If the message is a reply to an outstanding request, pass it to
+    // its handler, or keep it for its Future, and return true.
+    bool route_reply(Message& message) {
+        int correlation_id = message.in_reply_to();
+        if(correlation_id == 0) return false;
+
+        count_received(message);
+
+        std::map<int, ReplyHandler*>::iterator handler =
+            _reply_handlers.find(correlation_id);
+
+        if(handler != _reply_handlers.end()) {
+            ReplyHandler *reply_handler = handler->second;
+            _reply_handlers.erase(handler);
+
+            reply_handler->handle(message);
+            delete reply_handler;
+        } else {
+            _replies[correlation_id] = message;
+        }
+
+        return true;
+    }
+
+    // Route any replies waiting in the mailbox or the MPI pipeline,
+    // keeping other messages in the mailbox in the order they arrived.
+    void route_replies(void) {
+        Message message;
+        while(
+            _reads_pipeline
+            && (
+                message.receive_message(MPI_ANY_SOURCE, _id.gid(), _comm)
+                || _transport->receive(_id.gid(), &message)
+            )
+        ) {
+            Trace::receive(_id.gid(), message.source());
+            stamp_arrival(message);
+
+            if(!take_credit(message)) _mailbox.push(message);
+        }
+
+        size_t mailbox_size = _mailbox.size();
+        for(size_t i=0; i<mailbox_size; i++) {
+            message = _mailbox.front();
+            _mailbox.pop();
+
+            if(!route_reply(message)) _mailbox.push(message);
+        }
+    }
+
+    // A type-erased handler for a reply.
+    class ReplyHandler {
+    public:
+        virtual ~ReplyHandler() {}
+        virtual void handle(Message& message)=0;
+    };
+
+    // Call a member function of an actor with the reply data.
+    template<class A, class R>
+    class MemberReplyHandler: public ReplyHandler {
+    public:
+        MemberReplyHandler(A *actor, void (A::*handler)(R)):
+            _actor(actor), _handler(handler)
+        {}
+
+        void handle(Message& message) {
+            (_actor->*_handler)(message.data<R>());
+        }
+
+    private:
+        A *_actor;
+        void (A::*_handler)(R);
+    };
+
     // Death state of an actor.
     bool _is_dead;
 
+    // Whether the actor asked not to be run until a message arrives.
+    bool _is_waiting_for_message;
+
     // Ids of the actor.
     Id _id;
 
+    // The lineage of the actor, and how many children it has had,
+    // which make the lineages of its children.
+    uint64_t _lineage;
+    int _children;
+
     // Communicator to send messages over.
     MPI_Comm _comm;
 
+    // Communicator to send group messages over.
+    MPI_Comm _group_comm;
+
+    // Transport for messages to actors on the same node.
+    SharedTransport *_transport;
+
+    // Exchange for staging messages to other nodes, if enabled.
+    Exchange *_exchange;
+
+    // Messages delivered locally by the Director.
+    std::queue<Message> _mailbox;
+
+    // Persistent sends of the channels this actor has opened.
+    std::vector<PersistentMessage*> _channels;
+
+    // The number of messages this actor can send another that the
+    // receiver hasn't taken yet, or 0 for no limit.
+    int _mailbox_window;
+
+    // Whether messages are stamped with when they're sent and timed
+    // when they're taken. See Director::set_message_timing.
+    bool _is_timing_messages;
+
+    // Messages sent to each gid that haven't had their credit
+    // returned yet, and messages held back for lack of credit.
+    struct HeldQueue {
+        Id receiver;
+        std::deque<HeldMessage> messages;
+    };
+    std::map<int, int> _credits_used;
+    std::map<int, HeldQueue> _held_messages;
+
+    // Messages taken from each sender, by gid, whose credit hasn't
+    // been returned yet.
+    struct OwedCredits {
+        OwedCredits(): count(0) {}
+
+        Id sender;
+        int count;
+    };
+    std::map<int, OwedCredits> _credits_owed;
+
+    // Handlers waiting on replies to requests, by correlation id.
+    std::map<int, ReplyHandler*> _reply_handlers;
+
+    // Replies waiting to be collected through a Future.
+    std::map<int, Message> _replies;
+
+    // The number of requests sent, which gives each its correlation id.
+    // Replies only come back to this actor, so ids need only be unique
+    // to it.
+    int _request_count;
+
     // Distributed factory class to use to request births.
     DistributedFactory<Actor> *_distributed_factory;
+
+    // Collector class to use for gathers and reductions.
+    Collector *_collector;
+
+    // Timers class to set timers with.
+    Timers *_timers;
+
+    // Performance counters, also updated by the Director.
+    ActorCounters _counters;
+
+    // Statistics of the rank this actor is on.
+    Statistics *_statistics;
+
+    // Other gids whose messages are delivered to this actor, and how
+    // many of them the Director has registered so far.
+    std::vector<int> _aliases;
+    size_t _registered_aliases;
+
+    // Aliases removed since the Director last checked.
+    std::vector<int> _removed_aliases;
+
+    // Whether the actor takes messages straight from the MPI pipeline
+    // as well as from its mailbox. The Director turns this off when it
+    // hands messages out in a canonical order.
+    bool _reads_pipeline;
 };
 
 
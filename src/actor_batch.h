@@ -0,0 +1,164 @@
+#ifndef ACTOR_ACTOR_BATCH_H_
+#define ACTOR_ACTOR_BATCH_H_
+
+#include <vector>
+#include <map>
+
+#include "./id.h"
+#include "./actor.h"
+
+
+namespace ActorModel {
+
+
+/**
+ * ActorBatch
+ *
+ * An actor that stands in for many simple actors of the same kind,
+ * called members.
+ *
+ * Each member has its own Id and can be sent messages like any other
+ * actor, but the batch is scheduled as a single actor. Its main
+ * function is a kernel run over every member at once, so member
+ * fields can be kept in arrays, one entry per member, rather than in
+ * separate objects.
+ *
+ *  class Particles: public ActorBatch {
+ *      void main(void) {
+ *          for(size_t i=0; i<size(); i++) x[i] += v[i];
+ *      }
+ *      void remove_member_data(size_t index) {
+ *          x[index] = x.back(); x.pop_back();
+ *          v[index] = v.back(); v.pop_back();
+ *      }
+ *      std::vector<float> x;
+ *      std::vector<float> v;
+ *  };
+ *
+ * Members live on the same process as the batch. Members are removed
+ * by moving the last member into their place, so the arrays of an
+ * inheriting class must be updated the same way in remove_member_data.
+ * A removed member is treated as dead, so messages for it are dropped.
+ *
+ * A batch which opts in to checkpoints should save and restore its
+ * members with save_members and restore_members, along with its arrays.
+ */
+class ActorBatch: public Actor {
+public:
+
+    // Add a member to the batch and return its index.
+    // The arrays of an inheriting class should be grown to match.
+    size_t add_member(void) {
+        int gid = Id::new_global_id();
+
+        _member_indices[gid] = _member_gids.size();
+        _member_gids.push_back(gid);
+
+        add_alias(gid);
+
+        return _member_gids.size()-1;
+    }
+
+    // Remove a member from the batch, moving the last member
+    // into its place.
+    void remove_member(size_t index) {
+        remove_member_data(index);
+
+        remove_alias(_member_gids[index]);
+        _member_indices.erase(_member_gids[index]);
+
+        _member_gids[index] = _member_gids.back();
+        _member_gids.pop_back();
+
+        if(index < _member_gids.size()) {
+            _member_indices[_member_gids[index]] = index;
+        }
+    }
+
+    // The number of members in the batch.
+    size_t size(void) const {
+        return _member_gids.size();
+    }
+
+    // Get the id of the member at an index.
+    Id member_id(size_t index) {
+        return Id(id().rank(), _member_gids[index]);
+    }
+
+    // Find the index of the member with a given gid.
+    // Returns -1 if there is no such member.
+    int member_index(int gid) const {
+        std::map<int, size_t>::const_iterator it = _member_indices.find(gid);
+        if(it == _member_indices.end()) return -1;
+
+        return it->second;
+    }
+
+    // Get the next message for any member, along with the index of the
+    // member it was sent to. Messages for removed members are dropped.
+    bool get_member_message(Message *message, size_t *index) {
+        while(get_message(message)) {
+            int member = member_index(message->receiver_gid());
+
+            if(member >= 0) {
+                *index = member;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Send an array of data from a member.
+    template<class T>
+    void send_member_message(
+        size_t index, Id const& actor_id, T *data, size_t data_count, int tag
+    ) {
+        send_tagged_message<T>(
+            member_id(index), actor_id, data, data_count, tag, 0, 0
+        );
+    }
+
+    // Send an individual datum from a member.
+    template<class T>
+    void send_member_message(
+        size_t index, Id const& actor_id, T data, int tag
+    ) {
+        send_member_message<T>(index, actor_id, &data, 1, tag);
+    }
+
+
+protected:
+
+    // Remove the data of the member at index from any arrays, by moving
+    // the last member into its place. Called by remove_member.
+    virtual void remove_member_data(size_t) {}
+
+    // Save and restore the gids of the members, for an inheriting
+    // class opting in to checkpoints.
+    void save_members(CheckpointWriter& out) {
+        out.write(_member_gids);
+    }
+
+    void restore_members(CheckpointReader& in) {
+        in.read(_member_gids);
+
+        _member_indices.clear();
+        for(size_t i=0; i<_member_gids.size(); i++) {
+            _member_indices[_member_gids[i]] = i;
+        }
+    }
+
+
+private:
+
+    // Member gids, in member order, and member indices by gid.
+    std::vector<int> _member_gids;
+    std::map<int, size_t> _member_indices;
+};
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_ACTOR_BATCH_H_
@@ -0,0 +1,62 @@
+#ifndef ACTOR_BACKEND_H_
+#define ACTOR_BACKEND_H_
+
+/**
+ * Backend
+ *
+ * By default, ranks are MPI processes started by mpiexec. Building with
+ * -DACTOR_THREADS instead runs every rank as a thread of one process,
+ * through ThreadMPI, with no MPI library needed. The number of ranks
+ * is taken from the ACTOR_RANKS environment variable, and is 2 if it
+ * isn't set. ThreadMPI's MPI names live in a namespace of their own,
+ * and are brought into use here with a using directive.
+ *
+ * State kept per rank, rather than per process, is declared with
+ * ACTOR_RANK_LOCAL, which makes it thread local when ranks are threads.
+ *
+ * Programs start their ranks through run_ranks:
+ *
+ *  int rank_main(int argc, char* argv[]) {
+ *      Director::initialize(&argc, &argv);
+ *      ...
+ *      Director::finalize();
+ *      return 0;
+ *  }
+ *
+ *  int main(int argc, char* argv[]) {
+ *      return ActorModel::run_ranks(rank_main, argc, argv);
+ *  }
+ */
+
+#ifdef ACTOR_THREADS
+#include "./thread_mpi.h"
+using namespace ActorModel::ThreadMPI::Interface;
+#define ACTOR_RANK_LOCAL thread_local
+#else
+#include <mpi.h>
+#define ACTOR_RANK_LOCAL
+#endif
+
+#include <cstdlib>
+
+
+namespace ActorModel {
+
+
+// Run rank_main as every rank this process runs.
+inline int run_ranks(int (*rank_main)(int, char**), int argc, char **argv) {
+#ifdef ACTOR_THREADS
+    char const *ranks = std::getenv("ACTOR_RANKS");
+    int count = (ranks != NULL) ? std::atoi(ranks) : 2;
+
+    return ThreadMPI::run(count > 0 ? count : 1, rank_main, argc, argv);
+#else
+    return rank_main(argc, argv);
+#endif
+}
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_BACKEND_H_
@@ -0,0 +1,322 @@
+#ifndef ACTOR_CHECKPOINT_H_
+#define ACTOR_CHECKPOINT_H_
+
+#include "./backend.h"
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+
+namespace ActorModel {
+
+
+/**
+ * CheckpointWriter
+ *
+ * A checkpoint writer packs values into a buffer of bytes. Values are
+ * copied byte for byte, so only plain data should be written, and
+ * a checkpoint should be read back on the same kind of machine.
+ *
+ *  out.write(count);
+ *  out.write(positions, count);
+ *  out.write(history);  // a std::vector
+ */
+class CheckpointWriter {
+public:
+
+    // Write a single value
+    template<class T>
+    void write(T const& value) {
+        write<T>(&value, 1);
+    }
+
+    // Write an array of values
+    template<class T>
+    void write(T const *values, size_t count) {
+        size_t offset = _bytes.size();
+        _bytes.resize(offset + count*sizeof(T));
+
+        if(count > 0) {
+            std::memcpy(&_bytes[offset], values, count*sizeof(T));
+        }
+    }
+
+    // Write a vector of values, along with its size
+    template<class T>
+    void write(std::vector<T> const& values) {
+        write<long>(values.size());
+        write<T>(values.empty() ? NULL : &values[0], values.size());
+    }
+
+    std::vector<char> const& bytes(void) const {
+        return _bytes;
+    }
+
+private:
+    std::vector<char> _bytes;
+};
+
+
+/**
+ * CheckpointReader
+ *
+ * A checkpoint reader unpacks values from a buffer of bytes, in the
+ * order they were written by a CheckpointWriter.
+ */
+class CheckpointReader {
+public:
+
+    CheckpointReader(std::vector<char> const& bytes):
+        _bytes(bytes), _offset(0)
+    {}
+
+    // Read a single value
+    template<class T>
+    void read(T& value) {
+        read<T>(&value, 1);
+    }
+
+    template<class T>
+    T read(void) {
+        T value;
+        read<T>(&value, 1);
+
+        return value;
+    }
+
+    // Read an array of values
+    template<class T>
+    void read(T *values, size_t count) {
+        if(count > 0) {
+            std::memcpy(values, &_bytes[_offset], count*sizeof(T));
+        }
+
+        _offset += count*sizeof(T);
+    }
+
+    // Read a vector of values written along with its size
+    template<class T>
+    void read(std::vector<T>& values) {
+        values.resize(read<long>());
+        read<T>(values.empty() ? NULL : &values[0], values.size());
+    }
+
+    // Check if every value has been read
+    bool at_end(void) const {
+        return _offset >= _bytes.size();
+    }
+
+private:
+    std::vector<char> const& _bytes;
+    size_t _offset;
+};
+
+
+/**
+ * CheckpointFile
+ *
+ * A checkpoint file holds the checkpoint data of every process in a
+ * single file, written and read with MPI-IO.
+ *
+ * The file starts with a header, followed by a table of where each
+ * process's data sits in the file, followed by the data itself, in
+ * rank order. Every process writes its data with a single collective
+ * write at its own offset.
+ *
+ * The file can be read back on a different number of processes. The
+ * data saved by rank r is read by rank r % size, so one process may
+ * read the data of several.
+ */
+class CheckpointFile {
+public:
+
+    struct Header {
+        int magic;
+        int version;
+
+        int rank_count;  // the number of processes that wrote the file
+        int tick;        // the tick the checkpoint was taken on
+        int last_id;     // the largest global id in use
+    };
+
+    enum { MAGIC = 0x4143544b, VERSION = 5 };
+
+
+    // Write the data of every process to path. header is taken from
+    // the root, with the magic, version and rank count filled in.
+    // Returns false on all processes if the file can't be written.
+    // This is a collective routine.
+    static bool write(
+        MPI_Comm comm, std::string const& path,
+        Header header, std::vector<char> const& data
+    ) {
+        int rank;
+        int size;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.rank_count = size;
+
+        // Find where this process's data goes
+        long long data_size = data.size();
+        long long data_offset = 0;
+        MPI_Exscan(
+            &data_size, &data_offset, 1, MPI_LONG_LONG, MPI_SUM, comm
+        );
+        if(rank == 0) data_offset = 0;
+
+        data_offset += data_start(size);
+
+        std::vector<long long> table(2*size);
+        long long entry[2] = {data_offset, data_size};
+        MPI_Gather(
+            entry, 2, MPI_LONG_LONG, &table[0], 2, MPI_LONG_LONG, 0, comm
+        );
+
+        // Remove any older, possibly longer, file first
+        if(rank == 0) MPI_File_delete(path.c_str(), MPI_INFO_NULL);
+        MPI_Barrier(comm);
+
+        MPI_File file;
+        if(
+            MPI_File_open(
+                comm, const_cast<char*>(path.c_str()),
+                MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file
+            ) != MPI_SUCCESS
+        ) {
+            return false;
+        }
+
+        int failed = 0;
+        if(rank == 0) {
+            failed |= MPI_File_write_at(
+                file, 0, &header, sizeof(Header), MPI_BYTE,
+                MPI_STATUS_IGNORE
+            ) != MPI_SUCCESS;
+            failed |= MPI_File_write_at(
+                file, sizeof(Header), &table[0],
+                table.size()*sizeof(long long), MPI_BYTE, MPI_STATUS_IGNORE
+            ) != MPI_SUCCESS;
+        }
+
+        failed |= !write_pieces(comm, file, data_offset, data);
+
+        failed |= MPI_File_close(&file) != MPI_SUCCESS;
+
+        int any_failed;
+        MPI_Allreduce(&failed, &any_failed, 1, MPI_INT, MPI_MAX, comm);
+
+        return !any_failed;
+    }
+
+    // Read the data saved by every rank r with r % size == rank
+    // from path, in order of r. Returns false on all processes if
+    // the file can't be read.
+    // This is a collective routine.
+    static bool read(
+        MPI_Comm comm, std::string const& path,
+        Header *header, std::vector< std::vector<char> > *data
+    ) {
+        int rank;
+        int size;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+
+        MPI_File file;
+        if(
+            MPI_File_open(
+                comm, const_cast<char*>(path.c_str()),
+                MPI_MODE_RDONLY, MPI_INFO_NULL, &file
+            ) != MPI_SUCCESS
+        ) {
+            return false;
+        }
+
+        MPI_File_read_at_all(
+            file, 0, header, sizeof(Header), MPI_BYTE, MPI_STATUS_IGNORE
+        );
+
+        if(header->magic != MAGIC || header->version != VERSION) {
+            MPI_File_close(&file);
+            return false;
+        }
+
+        std::vector<long long> table(2*header->rank_count);
+        MPI_File_read_at_all(
+            file, sizeof(Header), &table[0],
+            table.size()*sizeof(long long), MPI_BYTE, MPI_STATUS_IGNORE
+        );
+
+        data->clear();
+        for(int saved = rank; saved < header->rank_count; saved += size) {
+            data->push_back(std::vector<char>(table[2*saved+1]));
+            std::vector<char>& saved_data = data->back();
+
+            for(
+                size_t start = 0; start < saved_data.size();
+                start += MAX_PIECE
+            ) {
+                size_t count =
+                    std::min<size_t>(MAX_PIECE, saved_data.size() - start);
+
+                MPI_File_read_at(
+                    file, table[2*saved] + start, &saved_data[start],
+                    count, MPI_BYTE, MPI_STATUS_IGNORE
+                );
+            }
+        }
+
+        MPI_File_close(&file);
+
+        return true;
+    }
+
+private:
+
+    // The most bytes read or written in one call, as counts are ints.
+    enum { MAX_PIECE = 1 << 30 };
+
+    // Write data at offset in pieces of at most MAX_PIECE bytes.
+    // The writes are collective, so every process makes as many as the
+    // process with the most data. Returns false if any piece fails.
+    static bool write_pieces(
+        MPI_Comm comm, MPI_File file, long long offset,
+        std::vector<char> const& data
+    ) {
+        long long pieces = (data.size() + MAX_PIECE - 1)/MAX_PIECE;
+        long long all_pieces;
+        MPI_Allreduce(
+            &pieces, &all_pieces, 1, MPI_LONG_LONG, MPI_MAX, comm
+        );
+
+        bool written = true;
+        for(long long i=0; i<all_pieces; i++) {
+            size_t start =
+                std::min<size_t>(i*static_cast<size_t>(MAX_PIECE), data.size());
+            size_t count = std::min<size_t>(MAX_PIECE, data.size() - start);
+
+            written &= MPI_File_write_at_all(
+                file, offset + start,
+                const_cast<char*>(count == 0 ? NULL : &data[start]),
+                count, MPI_BYTE, MPI_STATUS_IGNORE
+            ) == MPI_SUCCESS;
+        }
+
+        return written;
+    }
+
+    // The offset of the data, after the header and table.
+    static long long data_start(int rank_count) {
+        return sizeof(Header) + 2*rank_count*sizeof(long long);
+    }
+};
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_CHECKPOINT_H_
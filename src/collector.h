@@ -0,0 +1,384 @@
+#ifndef ACTOR_COLLECTOR_H_
+#define ACTOR_COLLECTOR_H_
+
+#include "./backend.h"
+#include <vector>
+#include <map>
+#include <queue>
+#include <cstring>
+#include <exception>
+
+#include "./id.h"
+#include "./message.h"
+
+
+namespace ActorModel {
+
+
+/*
+ * Some common reduction operations.
+ *
+ * A reduction operation is a class with a value_type typedef and a
+ * static combine function taking two values and returning one.
+ * Any operation used must be registered with the Director.
+ */
+template<class T>
+struct Sum {
+    typedef T value_type;
+    static T combine(T const& a, T const& b) { return a + b; }
+};
+
+template<class T>
+struct Min {
+    typedef T value_type;
+    static T combine(T const& a, T const& b) { return (b < a)? b : a; }
+};
+
+template<class T>
+struct Max {
+    typedef T value_type;
+    static T combine(T const& a, T const& b) { return (a < b)? b : a; }
+};
+
+
+/**
+ * Collector
+ *
+ * The collector class manages gathers and reductions over a Group.
+ *
+ * A collective is started by a group message carrying a collective id.
+ * Each member answers by contributing a value to the collector on its
+ * own rank. Once every local member has contributed, the combined
+ * partial result for the rank is sent to the collector on the rank of
+ * the actor that started the collective. That collector combines the
+ * partial results, and when all ranks have reported, the final result
+ * is handed back to the Director for delivery.
+ *
+ * A gather delivers an array of values in group order. A reduction
+ * delivers a single value, combined by a registered operation.
+ *
+ * As it requires a collective routine to initialize it, it must be
+ * initialized simultaneously by all processes using it.
+ * Reduction operations must be registered on all processes in the
+ * same order.
+ */
+class Collector {
+public:
+
+    Collector(MPI_Comm comm_in=MPI_COMM_WORLD): _collective_count(1) {
+        MPI_Comm_dup(comm_in, &_collector_comm);
+
+        MPI_Comm_rank(_collector_comm, &_comm_rank);
+        MPI_Comm_size(_collector_comm, &_comm_size);
+    }
+
+    ~Collector() {
+        // Clean up any outstanding partial results
+        Message message;
+        while(message.receive(MPI_ANY_SOURCE, PARTIAL, _collector_comm));
+
+        Message::in_flight(_collector_comm) = 0;
+        MPI_Comm_free(&_collector_comm);
+    }
+
+
+    // The op used to gather values rather than reduce them.
+    enum { GATHER = -1 };
+
+
+    /*
+     * Reduction operation registration
+     */
+
+    // Combine two values stored as bytes using a reduction operation.
+    template<class Op>
+    static void combine_bytes(char *accumulated, char const *value) {
+        typename Op::value_type a;
+        typename Op::value_type b;
+
+        std::memcpy(&a, accumulated, sizeof(a));
+        std::memcpy(&b, value, sizeof(b));
+
+        a = Op::combine(a, b);
+
+        std::memcpy(accumulated, &a, sizeof(a));
+    }
+
+    typedef void (combine_bytes_signature)(char*, char const*);
+
+    // Register a reduction operation so it can be referenced over MPI.
+    template<class Op>
+    int register_reduction(void) {
+        _combiners.push_back(combine_bytes<Op>);
+        return _combiners.size()-1;
+    }
+
+    // Find the id of a registered reduction operation.
+    template<class Op>
+    int get_reduction_id(void) {
+        combine_bytes_signature *func = &Collector::combine_bytes<Op>;
+
+        for(size_t i=0; i<_combiners.size(); i++) {
+            if(_combiners[i] == func) {
+                return i;
+            }
+        }
+
+        throw ReductionNotFound();
+    }
+
+    // Exception class to throw when an unregistered reduction is used.
+    class ReductionNotFound: public std::exception {
+        virtual const char* what() const throw() {
+            return "Reduction not found!";
+        }
+    };
+
+
+    /*
+     * Member side of a collective
+     */
+
+    // Expect contributions from local members to a collective.
+    // Members are given by gid, along with their index in the group.
+    void expect_contributions(
+        int collective_id, int op, int root_rank,
+        std::vector<int> const& gids, std::vector<int> const& indices
+    ) {
+        Partial& partial = _partials[collective_id];
+
+        partial.op = op;
+        partial.root_rank = root_rank;
+        partial.expected = gids.size();
+        partial.received = 0;
+
+        for(size_t i=0; i<gids.size(); i++) {
+            partial.indices[gids[i]] = indices[i];
+        }
+    }
+
+    // Contribute a value from the local actor with the given gid.
+    // When every local member has contributed, the partial result
+    // is sent on to the root.
+    void contribute(
+        int collective_id, int gid, void const *data, size_t data_bytes
+    ) {
+        std::map<int, Partial>::iterator it = _partials.find(collective_id);
+        if(it == _partials.end()) return;
+
+        Partial& partial = it->second;
+        char const *value = static_cast<char const*>(data);
+
+        partial.value_bytes = data_bytes;
+
+        if(partial.op == GATHER) {
+            int index = partial.indices[gid];
+            char const *index_bytes = reinterpret_cast<char const*>(&index);
+
+            partial.data.insert(
+                partial.data.end(), index_bytes, index_bytes + sizeof(int)
+            );
+            partial.data.insert(partial.data.end(), value, value + data_bytes);
+        } else if(partial.received == 0) {
+            partial.data.assign(value, value + data_bytes);
+        } else {
+            _combiners.at(partial.op)(&partial.data[0], value);
+        }
+
+        partial.received++;
+
+        if(partial.received == partial.expected) {
+            send_partial(collective_id, partial);
+            _partials.erase(it);
+        }
+    }
+
+
+    /*
+     * Root side of a collective
+     */
+
+    // Get an id for a new collective started on this rank.
+    // Ids are counted on each rank and interleaved by rank, so members
+    // on every rank can tell collectives apart. The count starts at 1,
+    // as an id of 0 marks a message that isn't part of a collective.
+    int new_collective_id(void) {
+        int collective_id = _collective_count*_comm_size + _comm_rank;
+        _collective_count++;
+
+        return collective_id;
+    }
+
+    // Expect partial results from rank_count ranks for a collective
+    // over member_count actors. The result is delivered to reply_id
+    // with reply_tag.
+    void expect_result(
+        int collective_id, int op, int rank_count, int member_count,
+        Id reply_id, int reply_tag
+    ) {
+        Result& result = _results[collective_id];
+
+        result.op = op;
+        result.expected = rank_count;
+        result.received = 0;
+        result.member_count = member_count;
+        result.reply_id = reply_id;
+        result.reply_tag = reply_tag;
+
+        if(rank_count == 0) {
+            _completed.push(result);
+            _results.erase(collective_id);
+        }
+    }
+
+    // Receive any partial results waiting and combine them.
+    void receive_partials(void) {
+        Message message;
+
+        while(message.receive(MPI_ANY_SOURCE, PARTIAL, _collector_comm)) {
+            std::vector<char> buffer(message.data_size());
+            message.data<char>(&buffer[0], buffer.size());
+
+            merge_partial(buffer);
+        }
+    }
+
+    // A completed collective, waiting to be delivered.
+    struct Result {
+        int op;
+        int expected;
+        int received;
+        int member_count;
+
+        Id reply_id;
+        int reply_tag;
+
+        std::vector<char> data;
+    };
+
+    // Check if no collective is in progress on this process.
+    bool is_idle(void) const {
+        return _partials.empty() && _results.empty() && _completed.empty();
+    }
+
+    // The communicator partial results are sent over.
+    MPI_Comm comm(void) {
+        return _collector_comm;
+    }
+
+    // Get the next completed collective, if any.
+    bool pop_result(Result *result) {
+        if(_completed.empty()) return false;
+
+        *result = _completed.front();
+        _completed.pop();
+
+        return true;
+    }
+
+
+private:
+
+    enum { PARTIAL };
+
+    // The contributions of the local members of a collective.
+    struct Partial {
+        Partial(): value_bytes(0) {}
+
+        int op;
+        int root_rank;
+        int expected;
+        int received;
+        size_t value_bytes;
+
+        // Local gid to group index
+        std::map<int, int> indices;
+
+        std::vector<char> data;
+    };
+
+    /*
+     * Partial result layout:
+     *  collective id, value bytes (int), then
+     *  for a gather: (index (int), value) for each contribution
+     *  for a reduction: the combined value
+     */
+    void send_partial(int collective_id, Partial& partial) {
+        int header[2] = {collective_id, static_cast<int>(partial.value_bytes)};
+
+        std::vector<char> buffer(sizeof(header) + partial.data.size());
+        std::memcpy(&buffer[0], header, sizeof(header));
+        if(!partial.data.empty()) {
+            std::memcpy(
+                &buffer[sizeof(header)], &partial.data[0], partial.data.size()
+            );
+        }
+
+        Message::send<char>(
+            partial.root_rank, PARTIAL,
+            &buffer[0], buffer.size(), _collector_comm
+        );
+    }
+
+    void merge_partial(std::vector<char> const& buffer) {
+        int header[2];
+        std::memcpy(header, &buffer[0], sizeof(header));
+
+        int collective_id = header[0];
+        size_t value_bytes = header[1];
+
+        std::map<int, Result>::iterator it = _results.find(collective_id);
+        if(it == _results.end()) return;
+
+        Result& result = it->second;
+        char const *data = &buffer[0] + sizeof(header);
+        size_t data_bytes = buffer.size() - sizeof(header);
+
+        if(result.op == GATHER) {
+            result.data.resize(result.member_count*value_bytes);
+
+            size_t record_bytes = sizeof(int) + value_bytes;
+            for(size_t i=0; i+record_bytes<=data_bytes; i+=record_bytes) {
+                int index;
+                std::memcpy(&index, data+i, sizeof(int));
+
+                if(value_bytes > 0) {
+                    std::memcpy(
+                        &result.data[index*value_bytes],
+                        data+i+sizeof(int), value_bytes
+                    );
+                }
+            }
+        } else if(result.received == 0) {
+            result.data.assign(data, data + data_bytes);
+        } else {
+            _combiners.at(result.op)(&result.data[0], data);
+        }
+
+        result.received++;
+
+        if(result.received == result.expected) {
+            _completed.push(result);
+            _results.erase(it);
+        }
+    }
+
+
+    MPI_Comm _collector_comm;
+
+    int _comm_rank;
+    int _comm_size;
+    int _collective_count;
+
+    std::vector<combine_bytes_signature*> _combiners;
+
+    std::map<int, Partial> _partials;
+    std::map<int, Result> _results;
+    std::queue<Result> _completed;
+};
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_COLLECTOR_H_
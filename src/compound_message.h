@@ -92,6 +92,30 @@ public:
     }
 
 
+    // Store a compound message that was delivered locally rather than
+    // received through MPI.
+    template<class MDT>
+    void store_message(
+        int source, int tag,
+        char const *data, size_t data_bytes,
+        MDT *metadata
+    ) {
+        _metadata.store(source, tag, metadata, sizeof(MDT));
+        _data.store(source, tag, data, data_bytes);
+    }
+
+
+    // Store a compound message whose metadata is given as raw bytes.
+    void store_message(
+        int source, int tag,
+        char const *data, size_t data_bytes,
+        void const *metadata, size_t metadata_bytes
+    ) {
+        _metadata.store(source, tag, metadata, metadata_bytes);
+        _data.store(source, tag, data, data_bytes);
+    }
+
+
     // Receive a compound message.
     bool receive_message(int source, int tag, MPI_Comm comm) {
 
@@ -100,7 +124,13 @@ public:
             if(!_metadata.receive(source, tag, comm)) {
                 return false;
             }
-            if(!_data.receive(_metadata.source(), _metadata.tag(), comm)) {
+
+            // The data is always sent straight after the metadata,
+            // but may not have arrived yet, so wait for it.
+            bool wait = true;
+            if(!_data.receive(
+                _metadata.source(), _metadata.tag(), comm, wait
+            )) {
                 return false;
             }
 
@@ -0,0 +1,262 @@
+#ifndef ACTOR_COROUTINE_ACTOR_H_
+#define ACTOR_COROUTINE_ACTOR_H_
+
+#if !defined(__cpp_impl_coroutine)
+#error "CoroutineActor requires C++20 coroutines. Compile with -std=c++20."
+#endif
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+
+#include "./actor.h"
+
+
+namespace ActorModel {
+
+
+/**
+ * CoroutineActor
+ *
+ * An actor whose logic is written as a single C++20 coroutine, body(),
+ * rather than as a main() function that is run over and over.
+ *
+ * The body can wait for messages with co_await receive(), or for the
+ * reply to a request with co_await ask<R>(...). While it is waiting,
+ * the Director sets the actor aside and doesn't run it again until a
+ * message is delivered to it. When the body returns, the actor dies.
+ *
+ *  Task body(void) {
+ *      Message request = co_await receive(REQUEST);
+ *      int value = co_await ask<int>(other, request.data<int>(), DOUBLE);
+ *      send_message<int>(request.sender(), value, RESULT);
+ *  }
+ */
+class CoroutineActor: public Actor {
+public:
+
+    // The return type of a coroutine body.
+    class Task {
+    public:
+        struct promise_type {
+            promise_type(): actor(NULL) {}
+
+            Task get_return_object(void) {
+                return Task(handle_type::from_promise(*this));
+            }
+
+            // Don't start running until the Director first runs the actor
+            std::suspend_always initial_suspend(void) noexcept { return {}; }
+            std::suspend_always final_suspend(void) noexcept { return {}; }
+
+            void return_void(void) {}
+
+            void unhandled_exception(void) {
+                exception = std::current_exception();
+            }
+
+            CoroutineActor *actor;
+            std::exception_ptr exception;
+        };
+
+        typedef std::coroutine_handle<promise_type> handle_type;
+
+        Task(): _handle() {}
+
+        Task(Task&& other): _handle(other._handle) {
+            other._handle = handle_type();
+        }
+
+        Task& operator=(Task&& other) {
+            if(this != &other) {
+                if(_handle) _handle.destroy();
+
+                _handle = other._handle;
+                other._handle = handle_type();
+            }
+
+            return *this;
+        }
+
+        Task(Task const&) = delete;
+        Task& operator=(Task const&) = delete;
+
+        ~Task() {
+            if(_handle) _handle.destroy();
+        }
+
+    private:
+        friend class CoroutineActor;
+
+        explicit Task(handle_type handle): _handle(handle) {}
+
+        handle_type _handle;
+    };
+
+
+    CoroutineActor(): _awaiting(NULL) {}
+
+    // The coroutine that must be overloaded when defining a new actor.
+    virtual Task body(void)=0;
+
+
+    // Run the body until it next waits on something that isn't ready.
+    void main(void) final {
+        if(!_task._handle) {
+            _task = body();
+            _task._handle.promise().actor = this;
+        }
+
+        if(_awaiting != NULL) {
+            if(!_awaiting->ready()) {
+                wait_for_message();
+                return;
+            }
+
+            _awaiting = NULL;
+        }
+
+        _task._handle.resume();
+
+        if(_task._handle.done()) {
+            die();
+
+            std::exception_ptr exception = _task._handle.promise().exception;
+            if(exception) std::rethrow_exception(exception);
+
+            return;
+        }
+
+        // Don't bother being run again until something arrives
+        if(_awaiting != NULL && !_awaiting->ready()) {
+            wait_for_message();
+        }
+    }
+
+
+    /*
+     * Awaitable operations
+     */
+
+    // Something the body can be suspended on.
+    class Awaiting {
+    public:
+        virtual ~Awaiting() {}
+
+        // Check if the body can carry on.
+        virtual bool ready(void)=0;
+    };
+
+    // Wait for a message, with a given tag or any tag.
+    class ReceiveAwaiter: public Awaiting {
+    public:
+        ReceiveAwaiter(CoroutineActor *actor, bool any_tag, int tag):
+            _actor(actor), _any_tag(any_tag), _tag(tag), _has_message(false)
+        {}
+
+        bool ready(void) {
+            if(!_has_message) {
+                _has_message = _actor->take_message(_any_tag, _tag, &_message);
+            }
+
+            return _has_message;
+        }
+
+        bool await_ready(void) { return ready(); }
+
+        void await_suspend(std::coroutine_handle<>) {
+            _actor->_awaiting = this;
+        }
+
+        Message await_resume(void) { return _message; }
+
+    private:
+        CoroutineActor *_actor;
+        bool _any_tag;
+        int _tag;
+
+        bool _has_message;
+        Message _message;
+    };
+
+    // Wait for the reply to a request made with ask.
+    template<class R>
+    class FutureAwaiter: public Awaiting {
+    public:
+        FutureAwaiter(Future<R> future): _future(future) {}
+
+        bool ready(void) { return _future.ready(); }
+
+        bool await_ready(void) { return ready(); }
+
+        void await_suspend(std::coroutine_handle<Task::promise_type> handle) {
+            handle.promise().actor->_awaiting = this;
+        }
+
+        R await_resume(void) { return _future.get(); }
+
+    private:
+        Future<R> _future;
+    };
+
+
+    // Wait for the next message with any tag.
+    ReceiveAwaiter receive(void) {
+        return ReceiveAwaiter(this, true, 0);
+    }
+
+    // Wait for the next message with the given tag. Messages with other
+    // tags are kept, in order, for later receives.
+    ReceiveAwaiter receive(int tag) {
+        return ReceiveAwaiter(this, false, tag);
+    }
+
+
+private:
+
+    // Take the first message matching a tag, keeping any others
+    // for later.
+    bool take_message(bool any_tag, int tag, Message *message) {
+        for(
+            std::deque<Message>::iterator it = _deferred.begin();
+            it != _deferred.end(); ++it
+        ) {
+            if(any_tag || it->tag() == tag) {
+                *message = *it;
+                _deferred.erase(it);
+
+                return true;
+            }
+        }
+
+        while(get_message(message)) {
+            if(any_tag || message->tag() == tag) return true;
+
+            _deferred.push_back(*message);
+        }
+
+        return false;
+    }
+
+    Task _task;
+
+    // What the body is currently suspended on, if anything.
+    Awaiting *_awaiting;
+
+    // Messages received while waiting for a different tag.
+    std::deque<Message> _deferred;
+};
+
+
+// Allow the body of a CoroutineActor to wait on a Future.
+//  int value = co_await ask<int>(actor_id, request, tag);
+template<class R>
+CoroutineActor::FutureAwaiter<R> operator co_await(Actor::Future<R> future) {
+    return CoroutineActor::FutureAwaiter<R>(future);
+}
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_COROUTINE_ACTOR_H_
@@ -1,11 +1,26 @@
 #ifndef ACTOR_DIRECTOR_H_
 #define ACTOR_DIRECTOR_H_
 
-#include <mpi.h>
+#include "./backend.h"
 #include <queue>
+#include <map>
+#include <vector>
+#include <typeinfo>
+#include <iostream>
+#include <string>
+#include <climits>
+#include <algorithm>
 
 #include "./id.h"
 #include "./actor.h"
+#include "./group.h"
+#include "./collector.h"
+#include "./timers.h"
+#include "./statistics.h"
+#include "./trace.h"
+#include "./replay.h"
+#include "./checkpoint.h"
+#include "./tombstones.h"
 #include "./distributed_factory.h"
 
 
@@ -27,18 +42,34 @@ public:
 
     Director(MPI_Comm comm_in=MPI_COMM_WORLD, int sync_interval=1):
         _actor_distributer(comm_in),
+        _collector(comm_in),
+        _transport(comm_in),
+        _exchange(comm_in),
+        _timers(comm_in),
+        _mailbox_window(mailbox_window()),
+        _is_timing_messages(is_timing_messages()),
         _is_ended(false),
         _sync_interval(sync_interval),
-        _tick_count(0)
+        _tick_count(0),
+        _added_count(0),
+        _checkpoint_interval(0.0),
+        _next_checkpoint(0.0)
     {
         // Constructor synchronized by MPI_Com_dup
 
         // Set up MPI communicators and data
         MPI_Comm_dup(comm_in, &_actor_comm);
+        MPI_Comm_dup(comm_in, &_group_comm);
         MPI_Comm_dup(comm_in, &_director_comm);
 
         MPI_Comm_rank(_director_comm, &_comm_rank);
         MPI_Comm_size(_director_comm, &_comm_size);
+
+        Id::process_count() = _comm_size;
+        _statistics.rank().bytes_sent_to.assign(_comm_size, 0);
+
+        // Start tracing, if compiled in
+        Trace::start(_director_comm);
     }
 
     ~Director() {
@@ -46,6 +77,9 @@ public:
         // Synchronize destructors
         MPI_Barrier(_director_comm);
 
+        // Write out this process's trace, if compiled in
+        Trace::write();
+
         // Empty out the actor queue
         empty_queue();
 
@@ -55,6 +89,12 @@ public:
             while(message.receive(MPI_ANY_SOURCE, MPI_ANY_TAG, _actor_comm));
         }
 
+        // Clean up group messages
+        {
+            Message message;
+            while(message.receive(MPI_ANY_SOURCE, MPI_ANY_TAG, _group_comm));
+        }
+
         // Clean up director messages
         {
             Message message;
@@ -62,8 +102,13 @@ public:
         }
 
 
-        // Free all communicators
+        // Free all communicators, forgetting any messages left in them
+        Message::in_flight(_actor_comm) = 0;
+        Message::in_flight(_group_comm) = 0;
+        Message::in_flight(_director_comm) = 0;
+
         MPI_Comm_free(&_actor_comm);
+        MPI_Comm_free(&_group_comm);
         MPI_Comm_free(&_director_comm);
     }
 
@@ -81,7 +126,7 @@ public:
     }
 
     static void set_buffer_size(size_t buffer_size) {
-        static void *buffer = NULL;
+        static ACTOR_RANK_LOCAL void *buffer = NULL;
         
         if(buffer != NULL) {
             ::operator delete(buffer);
@@ -92,6 +137,36 @@ public:
     }
 
 
+    // Set the size of the rings used to pass messages between
+    // processes on the same node, for directors made from now on.
+    // A size of 0 sends every message through MPI. Every process must
+    // set the same size. See SharedTransport.
+    static void set_shared_ring_size(size_t ring_bytes) {
+        SharedTransport::ring_bytes() = ring_bytes;
+    }
+
+    // Bound how many messages any actor can have waiting from any one
+    // other actor, or 0 for no bound, for directors made from now on.
+    // Senders without credit are held up until their receivers catch
+    // up. See Actor::try_send_message. Every process must set the same
+    // window.
+    static void set_mailbox_window(int window) {
+        mailbox_window() = window;
+    }
+
+    // Stamp direct messages with when they're sent, and keep histograms
+    // of how long they take to be taken, and how long they sat waiting
+    // for their receiver to run, by receiver type and tag. See Latency.
+    // Latencies are shown by print_statistics, and can be looked up in
+    // get_statistics while running. Senders and receivers on different
+    // nodes are only as comparable as their clocks.
+    // This is for directors made from now on, and every process must
+    // set the same value.
+    static void set_message_timing(bool is_timing) {
+        is_timing_messages() = is_timing;
+    }
+
+
     // Define a root director to easily run stuff on just one process
     bool is_root(void) {
         return _comm_rank == 0;
@@ -107,13 +182,15 @@ public:
 
         new_actor->initialize_comms(
             _actor_distributer.new_global_id(_comm_rank),
-            _actor_comm,
-            &_actor_distributer
+            _actor_comm, _group_comm, &_transport, &_exchange,
+            &_actor_distributer, &_collector, &_timers, &_statistics,
+            _mailbox_window, _is_timing_messages
         );
+        new_actor->_lineage =
+            Placement::root_lineage(_comm_rank, _added_count++);
+        record_placement(new_actor, true);
 
-        ActorWrap actor_wrap(new_actor, false);
-
-        _actor_queue.push(actor_wrap);
+        add_to_cast(ActorWrap(new_actor, false));
 
         return new_actor;
     }
@@ -126,11 +203,19 @@ public:
         _actor_distributer.register_child<T>();
     }
 
+    // Register a reduction operation for use in Actor::reduce_group.
+    // As with actors, every process must register the same operations
+    // in the same order.
+    template<class Op>
+    void register_reduction(void) {
+        _collector.register_reduction<Op>();
+    }
+
 
     // Get the current load the director is under. That is,
     // the current number of actors it's managing.
     int get_load(void) {
-        return _actor_queue.size();
+        return _actor_queue.size() + _waiting_actors.size();
     }
 
 
@@ -149,6 +234,236 @@ public:
     }
 
 
+    // Get the counters for the actors and the director on this process.
+    // Counters for each actor type include living actors as well as
+    // those that have died.
+    Statistics get_statistics(void) {
+        Statistics statistics = _statistics;
+
+        for(
+            std::map<int, Actor*>::iterator it = _local_actors.begin();
+            it != _local_actors.end(); ++it
+        ) {
+            // Aliases, such as batch members, share their actor's counters
+            if(it->first != it->second->id().gid()) continue;
+
+            statistics.type(type_name(it->second)).add(it->second->counters());
+        }
+
+        return statistics;
+    }
+
+    // Get the counters for the director on this process.
+    RankCounters const& get_rank_counters(void) {
+        return _statistics.rank();
+    }
+
+    // Get the bytes of direct messages actors on this process have
+    // sent to each process so far, for reorder_by_traffic.
+    std::vector<long> const& get_traffic(void) {
+        return _statistics.rank().bytes_sent_to;
+    }
+
+    // Get a communicator of the same processes as comm, numbered so
+    // processes sending each other the most data are placed close
+    // together, such as on the same node, by MPI_Dist_graph_create.
+    // traffic holds the bytes this process expects to send to each
+    // process of comm, as profiled by get_traffic in an earlier run.
+    // Build a director on the new communicator to use it, and free
+    // it once the director is gone. Actors placed on a rank then run
+    // close to the ranks they talk to most.
+    // This is a collective routine. All processes must call
+    // this at the same time.
+    static MPI_Comm reorder_by_traffic(
+        MPI_Comm comm, std::vector<long> const& traffic
+    ) {
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+
+        // MPI weights are ints, so scale the heaviest edge down to fit
+        long heaviest = 1;
+        for(size_t i=0; i<traffic.size(); i++) {
+            heaviest = std::max(heaviest, traffic[i]);
+        }
+        double scale = std::min(1.0, static_cast<double>(INT_MAX)/heaviest);
+
+        std::vector<int> destinations;
+        std::vector<int> weights;
+        for(size_t i=0; i<traffic.size(); i++) {
+            if(static_cast<int>(i) == rank || traffic[i] <= 0) continue;
+
+            destinations.push_back(i);
+            weights.push_back(std::max(1, static_cast<int>(traffic[i]*scale)));
+        }
+
+        // MPI wants a valid array of destinations even when there are none
+        int degree = destinations.size();
+        MPI_Comm reordered;
+        MPI_Dist_graph_create(
+            comm, 1, &rank, &degree,
+            destinations.empty() ? &rank : &destinations[0],
+            weights.empty() ? MPI_WEIGHTS_EMPTY : &weights[0],
+            MPI_INFO_NULL, 1, &reordered
+        );
+
+        return reordered;
+    }
+
+    // Choose how births and messages are handed out to actors.
+    // Outside of LIVE mode they are handed out in a canonical order
+    // each tick, and can be recorded to, or replayed from, the log
+    // <log_prefix>.<rank>.log. See Replay.
+    // Every process must set the same mode before running.
+    void set_replay_mode(
+        Replay::Mode mode, std::string const& log_prefix="actor_replay"
+    ) {
+        _replay.set_mode(mode, log_prefix, _comm_rank);
+
+        for(
+            std::map<int, Actor*>::iterator it = _local_actors.begin();
+            it != _local_actors.end(); ++it
+        ) {
+            it->second->_reads_pipeline = !_replay.is_holding();
+        }
+    }
+
+
+    // Choose whether direct messages between actors on different
+    // nodes are sent as they're made, or staged and exchanged by every
+    // process at once every _sync_interval ticks, with one sparse
+    // collective, either directly or through a leader on each node.
+    // Exchanging suits actors that work in steps, sending most of their
+    // messages each step. It slows down actors trading requests and
+    // replies, which wait for an exchange each way. Messages between
+    // processes on the same node still go through shared memory.
+    // See Exchange.
+    // Every process must set the same mode before running.
+    void set_exchange_mode(Exchange::Mode mode) {
+        _exchange.set_mode(mode);
+    }
+
+    // Get the exchange, to see how it's been used.
+    Exchange const& get_exchange(void) const {
+        return _exchange;
+    }
+
+
+    // Record which actors are born on each process and the direct
+    // messages they send each other, for write_placement.
+    // Every process should set the same value before running.
+    void set_placement_profiling(bool is_profiling) {
+        _actor_distributer.placement().set_profiling(is_profiling);
+    }
+
+    // Partition the actors recorded while profiling between the
+    // processes, keeping actors that send each other the most data
+    // together, and write where each should be born to path, with a
+    // summary of the messages sent between actor types. Reading it
+    // back with read_placement in a later run making the same births
+    // places their children the same way. See Placement.
+    // Returns false on every process if the file can't be written.
+    // This is a collective routine. All processes must call
+    // this at the same time.
+    bool write_placement(std::string const& path) {
+        return _actor_distributer.placement().write(
+            _director_comm, path, _comm_size
+        );
+    }
+
+    // Read a placement written by write_placement, which births with
+    // no requested rank then follow. Returns false if it can't be read.
+    // Every process should read the same file before running.
+    bool read_placement(std::string const& path) {
+        return _actor_distributer.placement().read(path);
+    }
+
+
+    // Save every actor, with the messages and timers waiting for them,
+    // to a single checkpoint file at path. Messages in flight between
+    // processes are taken in first, so none are lost.
+    // Nothing is written, and false is returned on every process, if
+    // any actor can't be saved (see Actor::save) or a gather or
+    // reduction is in progress. Checkpoints aren't taken when replaying.
+    // This is a collective routine. All processes must call
+    // this at the same time.
+    bool checkpoint(std::string const& path) {
+        if(_replay.mode() == Replay::REPLAY) return false;
+
+        take_in_flight();
+
+        CheckpointWriter out;
+        int saved = save_process(out);
+        int all_saved;
+        MPI_Allreduce(
+            &saved, &all_saved, 1, MPI_INT, MPI_LAND, _director_comm
+        );
+        if(!all_saved) return false;
+
+        CheckpointFile::Header header;
+        header.tick = _tick_count;
+
+        int last_id = Id::new_global_id();
+        MPI_Allreduce(
+            &last_id, &header.last_id, 1, MPI_INT, MPI_MAX, _director_comm
+        );
+
+        return CheckpointFile::write(_director_comm, path, header, out.bytes());
+    }
+
+    // Take a checkpoint at path roughly every interval seconds while
+    // running. The time is checked every _sync_interval ticks, and a
+    // checkpoint which can't be taken is tried again at the next check.
+    // An interval of 0 stops checkpoints being taken.
+    // Every process must set the same interval.
+    void set_checkpoint_interval(std::string const& path, double interval) {
+        _checkpoint_path = path;
+        _checkpoint_interval = interval;
+        _next_checkpoint = MPI_Wtime() + interval;
+    }
+
+    // Restart from a checkpoint at path, in place of adding actors.
+    // Actors are made through the factory, so every type of actor must
+    // be registered in the same order as when the checkpoint was taken.
+    // The checkpoint may have been taken on a different number of
+    // processes. Actors keep their ids, and the actors of ranks which
+    // no longer exist are folded onto those which do (see Id::process).
+    // Returns false on every process if the checkpoint can't be read.
+    // This is a collective routine. All processes must call
+    // this at the same time.
+    bool restart(std::string const& path) {
+        CheckpointFile::Header header;
+        std::vector< std::vector<char> > data;
+        if(!CheckpointFile::read(_director_comm, path, &header, &data)) {
+            return false;
+        }
+
+        _tick_count = header.tick;
+        Id::skip_global_ids(header.last_id);
+
+        // Put back every message waiting for an actor before the
+        // actors themselves, so they can claim them.
+        std::vector<CheckpointReader> readers;
+        for(size_t i=0; i<data.size(); i++) {
+            readers.push_back(CheckpointReader(data[i]));
+            restore_waiting_inputs(readers[i]);
+        }
+
+        for(size_t i=0; i<readers.size(); i++) {
+            restore_actors(readers[i]);
+        }
+
+        return true;
+    }
+
+
+    // Print a summary of the counters over all directors.
+    // This is a collective routine. All processes must call
+    // this at the same time. The summary is printed by the root.
+    void print_statistics(std::ostream& out=std::cout) {
+        get_statistics().print_summary(_director_comm, out);
+    }
+
+
     // Request that all directors stop and the run ends
     enum { END };
     void end(void) {
@@ -167,24 +482,64 @@ public:
         while(!_is_ended && (_tick_count < end_tick_count || ticks <= 0)) {
             _tick_count++;
 
+            RankCounters& rank_counters = _statistics.rank();
+            rank_counters.ticks++;
+
+            double sync_start = MPI_Wtime();
             sync_states();
+            double sync_end = MPI_Wtime();
+            rank_counters.sync_time += sync_end - sync_start;
 
-            if(_actor_queue.empty()) continue;
+            if(_actor_queue.empty()) {
+                rank_counters.idle_ticks++;
+                continue;
+            }
 
             // Get the next actor in the queue
             ActorWrap actor_wrap = _actor_queue.front();
             _actor_queue.pop();
 
-            // Run the actor's main function
-            actor_wrap.actor->main();
+            // Run the actor's main function, unless it died while
+            // held up sending its last messages
+            int gid = actor_wrap.actor->id().gid();
+            char const *actor_type = typeid(*actor_wrap.actor).name();
 
-            // Add the actor back to the end of the queue if they're not dead
             if(!actor_wrap.actor->is_dead()) {
-                _actor_queue.push(actor_wrap);
-            } else {
+                Trace::begin_run(gid, actor_type);
+                actor_wrap.actor->main();
+                Trace::end_run(gid, actor_type);
+
+                double run_end = MPI_Wtime();
+                register_aliases(actor_wrap.actor);
+
+                actor_wrap.actor->_counters.runs++;
+                actor_wrap.actor->_counters.run_time += run_end - sync_end;
+                rank_counters.run_time += run_end - sync_end;
+            }
+
+            // Add the actor back to the end of the queue if they're not dead,
+            // or set them aside if they're waiting for a message or held
+            // up for credit. Actors aren't let go until they're not held up.
+            bool is_waiting = actor_wrap.actor->is_waiting_for_message();
+            if(actor_wrap.actor->is_held_up()) {
+                _waiting_actors.insert(std::make_pair(gid, actor_wrap));
+            } else if(actor_wrap.actor->is_dead()) {
+                bury_actor(actor_wrap.actor);
+
+                ActorCounters& type_counters =
+                    _statistics.type(actor_type);
+                type_counters.add(actor_wrap.actor->counters());
+                type_counters.deaths++;
+
                 if(actor_wrap.deletable == true) {
                     delete actor_wrap.actor;
                 }
+            } else if(is_waiting) {
+                _waiting_actors.insert(
+                    std::make_pair(actor_wrap.actor->id().gid(), actor_wrap)
+                );
+            } else {
+                _actor_queue.push(actor_wrap);
             }
         }
 
@@ -214,23 +569,64 @@ private:
     // Share information between directors, like global ended status
     // and the global load.
     void sync_states(void) {
+        Trace::begin("sync");
+        long probe_start = Status::probe_count();
 
         // Add waiting actors
         add_waiting_actors();
 
+        // Move incoming messages into the mailboxes of local actors
+        deliver_incoming_messages();
+
+        // Hand out group messages to newly added and existing actors
+        deliver_group_messages();
+
+        // Hand out the results of any finished gathers and reductions
+        deliver_collective_results();
+
+        // Fire any timers that are due
+        deliver_expired_timers();
+
         // Check if end request has been made
         _is_ended |= get_global_ended();
 
         // Do a check for finished loads every _sync_interval ticks
-        if((_tick_count % _sync_interval) == 0) {
+        bool check_load = (_tick_count % _sync_interval) == 0;
 
+        if(check_load) {
             // Generate requested actors before comparing loads
+            double barrier_start = MPI_Wtime();
+            Trace::begin("barrier");
             MPI_Barrier(_director_comm);
+            Trace::end("barrier");
+            _statistics.rank().barrier_time += MPI_Wtime() - barrier_start;
+            _statistics.rank().barriers++;
+
             add_waiting_actors();
 
+            // Swap staged messages between processes
+            if(_exchange.is_enabled()) exchange_messages();
+        }
+
+        // Hand out anything held back for a canonical order
+        release_held_inputs();
+
+        if(check_load) {
+            double barrier_start = MPI_Wtime();
+            Trace::begin("global load");
             int global_load = get_global_load();
+            Trace::end("global load");
+            _statistics.rank().barrier_time += MPI_Wtime() - barrier_start;
+
             _is_ended |= (global_load == 0);
+
+            if(_checkpoint_interval > 0.0) checkpoint_if_due();
         }
+
+        _is_ended = _replay.ended(_tick_count, _is_ended);
+
+        _statistics.rank().sync_probes += Status::probe_count() - probe_start;
+        Trace::end("sync");
     }
 
 
@@ -259,10 +655,121 @@ private:
                 delete actor_wrap.actor;
             }
         }
+
+        for(
+            std::map<int, ActorWrap>::iterator it = _waiting_actors.begin();
+            it != _waiting_actors.end(); ++it
+        ) {
+            if(it->second.deletable) {
+                delete it->second.actor;
+            }
+        }
+        _waiting_actors.clear();
+
+        std::vector<Actor*> held_births = _replay.take_held_births();
+        for(size_t i=0; i<held_births.size(); i++) {
+            delete held_births[i];
+        }
+
+        _local_actors.clear();
+        _unclaimed_messages.clear();
+    }
+
+    // Add a new actor to the queue, or set it aside if it is waiting
+    // for a message, and hand it any messages that arrived before it did.
+    void add_to_cast(ActorWrap actor_wrap, bool waiting=false) {
+        int gid = actor_wrap.actor->id().gid();
+
+        if(waiting) {
+            _waiting_actors.insert(std::make_pair(gid, actor_wrap));
+        } else {
+            _actor_queue.push(actor_wrap);
+        }
+        _local_actors[gid] = actor_wrap.actor;
+        actor_wrap.actor->_reads_pipeline = !_replay.is_holding();
+
+        _statistics.type(type_name(actor_wrap.actor)).births++;
+
+        claim_messages(gid, actor_wrap.actor);
+        register_aliases(actor_wrap.actor);
+    }
+
+    // Hand an actor any messages that arrived for a gid before
+    // the actor was there to take them.
+    void claim_messages(int gid, Actor *actor) {
+        std::map<int, std::vector<Actor::Message> >::iterator unclaimed =
+            _unclaimed_messages.find(gid);
+
+        if(unclaimed != _unclaimed_messages.end()) {
+            for(size_t i=0; i<unclaimed->second.size(); i++) {
+                actor->deliver(unclaimed->second[i]);
+            }
+
+            _unclaimed_messages.erase(unclaimed);
+            wake_actor(actor->id().gid());
+        }
+    }
+
+    // Deliver messages for any gids an actor has taken on since it
+    // was last checked, such as the members of an ActorBatch, and
+    // bury any it has given up.
+    void register_aliases(Actor *actor) {
+        while(actor->_registered_aliases < actor->_aliases.size()) {
+            int gid = actor->_aliases[actor->_registered_aliases++];
+
+            _local_actors[gid] = actor;
+            claim_messages(gid, actor);
+        }
+
+        for(size_t i=0; i<actor->_removed_aliases.size(); i++) {
+            int gid = actor->_removed_aliases[i];
+
+            _local_actors.erase(gid);
+            _tombstones.bury(gid);
+            Trace::forget(gid);
+        }
+        actor->_removed_aliases.clear();
+    }
+
+    // Put an actor waiting for a message back in the queue, unless
+    // it's held up waiting for credit.
+    void wake_actor(int gid) {
+        std::map<int, ActorWrap>::iterator waiting = _waiting_actors.find(gid);
+
+        if(
+            waiting != _waiting_actors.end()
+            && !waiting->second.actor->is_held_up()
+        ) {
+            _actor_queue.push(waiting->second);
+            _waiting_actors.erase(waiting);
+        }
+    }
+
+    // The name used to count an actor by its type.
+    static std::string type_name(Actor *actor) {
+        return typeid(*actor).name();
+    }
+
+    // Record an actor born on this process for the placement, if
+    // profiling.
+    void record_placement(Actor *actor, bool is_fixed) {
+        Placement& placement = _actor_distributer.placement();
+        if(!placement.is_profiling()) return;
+
+        placement.record_actor(
+            actor->_id.gid(), actor->_lineage, type_name(actor),
+            _comm_rank, is_fixed
+        );
     }
 
     std::queue<ActorWrap> _actor_queue;
 
+    // Actors that won't be run until a message arrives, by gid.
+    std::map<int, ActorWrap> _waiting_actors;
+
+    // Living actors on this process, looked up by gid.
+    std::map<int, Actor*> _local_actors;
+
 
     /*
      * Distributer actor management
@@ -278,17 +785,531 @@ private:
             Id actor_id  = new_actor_data.child_id;
 
             new_actor->initialize_comms(
-                actor_id, _actor_comm, &_actor_distributer
+                actor_id, _actor_comm, _group_comm, &_transport, &_exchange,
+                &_actor_distributer, &_collector, &_timers, &_statistics,
+                _mailbox_window, _is_timing_messages
             );
+            new_actor->_lineage = new_actor_data.lineage;
+            record_placement(new_actor, new_actor_data.is_fixed);
 
-            _actor_queue.push(ActorWrap(new_actor, true));
+            if(_replay.is_holding()) {
+                _replay.hold_birth(new_actor);
+            } else {
+                add_to_cast(ActorWrap(new_actor, true));
+            }
+        }
+    }
+
+
+    /*
+     * Message delivery management
+     */
+
+    // Receive every message waiting for actors on this process, through
+    // MPI or shared memory, and move it into the mailbox of the actor it
+    // was sent to.
+    void deliver_incoming_messages(void) {
+        Actor::Message message;
+
+        while(
+            message.receive_message(MPI_ANY_SOURCE, MPI_ANY_TAG, _actor_comm)
+            || _transport.receive(MPI_ANY_TAG, &message)
+            || _exchange.receive(&message)
+        ) {
+            // Flows to dead actors were forgotten with them
+            if(!_tombstones.is_dead(message.receiver_gid())) {
+                Trace::receive(message.receiver_gid(), message.source());
+            }
+            take_message(Replay::DIRECT, message.receiver_gid(), message);
+        }
+    }
+
+    // Exchange staged messages with every process, and deliver those
+    // sent to this one.
+    // This is a collective routine.
+    void exchange_messages(void) {
+        double exchange_start = MPI_Wtime();
+        Trace::begin("exchange");
+        _exchange.exchange();
+        Trace::end("exchange");
+        _statistics.rank().barrier_time += MPI_Wtime() - exchange_start;
+
+        deliver_incoming_messages();
+    }
+
+    // Take in a message for a local actor, holding it back if
+    // messages are being handed out in a canonical order.
+    void take_message(int kind, int gid, Actor::Message const& message) {
+        if(_replay.is_holding()) {
+            _replay.hold_message(kind, gid, message);
+        } else {
+            post_message(gid, message);
+        }
+    }
+
+    // Put a message in the mailbox of a local actor, waking it if
+    // it was waiting for one. If the actor hasn't been born yet,
+    // the message is kept until it is, and if it has died, the
+    // message is dropped.
+    void post_message(int gid, Actor::Message const& message) {
+        std::map<int, Actor*>::iterator actor = _local_actors.find(gid);
+
+        if(actor != _local_actors.end()) {
+            actor->second->deliver(message);
+            wake_actor(actor->second->id().gid());
+        } else if(_tombstones.is_dead(gid)) {
+            drop_dead_letter(gid, message);
+        } else {
+            _unclaimed_messages[gid].push_back(message);
+        }
+    }
+
+    // Drop a message sent to an actor that has died, handing back
+    // the credit it took so its sender isn't held up for good.
+    // Returned credits are dropped without being counted.
+    void drop_dead_letter(int gid, Actor::Message message) {
+        Actor::Message::MetaData metadata =
+            message.metadata<Actor::Message::MetaData>();
+        if(metadata.credits == Actor::Message::RETURNS_CREDITS) return;
+
+        _statistics.rank().dead_letters++;
+
+        if(metadata.credits == Actor::Message::TAKES_CREDIT) {
+            Actor::send_credits(
+                &_transport, &_exchange, _actor_comm,
+                Id(_comm_rank, gid), metadata.sender_id, 1
+            );
+        }
+    }
+
+    // Remove a dead actor from the process, dropping the messages it
+    // never took, and mark its gids dead.
+    void bury_actor(Actor *actor) {
+        _statistics.rank().dead_letters += actor->mailbox_size();
+        actor->return_all_credits();
+
+        _local_actors.erase(actor->id().gid());
+        _tombstones.bury(actor->id().gid());
+        Trace::forget(actor->id().gid());
+
+        for(size_t i=0; i<actor->_aliases.size(); i++) {
+            _local_actors.erase(actor->_aliases[i]);
+            _tombstones.bury(actor->_aliases[i]);
+            Trace::forget(actor->_aliases[i]);
         }
     }
 
+    // Gids of actors that have died on this process.
+    Tombstones _tombstones;
+
+    // Messages for actors that haven't been born yet, by gid.
+    std::map<int, std::vector<Actor::Message> > _unclaimed_messages;
+
+
+    /*
+     * Group message management
+     */
+
+    // Receive any group messages, pass them on to the other ranks
+    // they're bound for, and deliver them to the local actors.
+    void deliver_group_messages(void) {
+        GroupMessage group_message;
+
+        while(group_message.receive(_group_comm)) {
+            group_message.forward(_group_comm);
+
+            if(group_message.is_collective()) {
+                _collector.expect_contributions(
+                    group_message.collective_id(), group_message.op(),
+                    group_message.sender_id().process(),
+                    group_message.local_gids(), group_message.local_indices()
+                );
+            }
+
+            Actor::Message::MetaData metadata;
+            metadata.sender_id      = group_message.sender_id();
+            metadata.tag            = group_message.tag();
+            metadata.collective_id  = group_message.collective_id();
+            metadata.correlation_id = 0;
+            metadata.in_reply_to    = 0;
+            metadata.credits        = Actor::Message::UNCOUNTED;
+            metadata.flags          = 0;
+
+            std::vector<int> const& gids = group_message.local_gids();
+            for(size_t i=0; i<gids.size(); i++) {
+                deliver_message(
+                    Replay::GROUP, gids[i], metadata,
+                    group_message.data(), group_message.data_size()
+                );
+            }
+        }
+    }
+
+    // Combine incoming partial results, and deliver finished
+    // collectives to the actors that started them.
+    void deliver_collective_results(void) {
+        _collector.receive_partials();
+
+        Collector::Result result;
+        while(_collector.pop_result(&result)) {
+            Actor::Message::MetaData metadata;
+            metadata.sender_id      = result.reply_id;
+            metadata.tag            = result.reply_tag;
+            metadata.collective_id  = 0;
+            metadata.correlation_id = 0;
+            metadata.in_reply_to    = 0;
+            metadata.credits        = Actor::Message::UNCOUNTED;
+            metadata.flags          = 0;
+
+            deliver_message(
+                Replay::COLLECTIVE, result.reply_id.gid(), metadata,
+                result.data.empty() ? NULL : &result.data[0],
+                result.data.size()
+            );
+        }
+    }
+
+    // Deliver a message to every actor with a timer that is due.
+    // Timers belonging to actors that have died are dropped.
+    void deliver_expired_timers(void) {
+        Timers::Timer timer;
+
+        while(_timers.pop_expired(&timer)) {
+            std::map<int, Actor*>::iterator actor =
+                _local_actors.find(timer.gid);
+
+            // A periodic timer has already been put back on the heap
+            if(actor == _local_actors.end()) {
+                if(timer.period > 0.0) _timers.cancel(timer.timer_id);
+                continue;
+            }
+
+            Actor::Message::MetaData metadata;
+            metadata.sender_id      = actor->second->id();
+            metadata.tag            = timer.tag;
+            metadata.collective_id  = 0;
+            metadata.correlation_id = 0;
+            metadata.in_reply_to    = 0;
+            metadata.credits        = Actor::Message::UNCOUNTED;
+            metadata.flags          = 0;
+
+            deliver_message(
+                Replay::TIMER, timer.gid, metadata,
+                reinterpret_cast<char const*>(&timer.timer_id), sizeof(int)
+            );
+        }
+    }
+
+    // Deliver a message of the given Replay::Kind made on this process
+    // to a local actor.
+    void deliver_message(
+        int kind, int gid, Actor::Message::MetaData& metadata,
+        char const *data, size_t data_bytes
+    ) {
+        Actor::Message message;
+        message.store_message<Actor::Message::MetaData>(
+            metadata.sender_id.rank(), gid, data, data_bytes, &metadata
+        );
+
+        take_message(kind, gid, message);
+    }
+
+
+    /*
+     * Canonical ordering and replay
+     */
+
+    // Hand out the births and messages held back this tick. When
+    // replaying, keep taking in new ones until everything the recorded
+    // run handed out at this tick has arrived.
+    void release_held_inputs(void) {
+        if(!_replay.is_holding()) return;
+
+        std::vector<Replay::Input> inputs;
+        while(!_replay.release(_tick_count, &inputs)) {
+            add_waiting_actors();
+            deliver_incoming_messages();
+            deliver_group_messages();
+            deliver_collective_results();
+            deliver_expired_timers();
+        }
+
+        for(size_t i=0; i<inputs.size(); i++) {
+            if(inputs[i].actor != NULL) {
+                add_to_cast(ActorWrap(inputs[i].actor, true));
+            } else {
+                post_message(inputs[i].gid, inputs[i].message);
+            }
+        }
+    }
+
+    /*
+     * Checkpoints
+     */
+
+    // Take in every message in flight between processes, until none
+    // are left on any communicator the director uses.
+    // This is a collective routine.
+    void take_in_flight(void) {
+        long global_in_flight;
+
+        do {
+            add_waiting_actors();
+            deliver_incoming_messages();
+            deliver_group_messages();
+            deliver_collective_results();
+            if(_exchange.is_enabled()) exchange_messages();
+            _is_ended |= get_global_ended();
+
+            long in_flight =
+                Message::in_flight(_actor_comm)
+                + Message::in_flight(_group_comm)
+                + Message::in_flight(_director_comm)
+                + Message::in_flight(_actor_distributer.comm())
+                + Message::in_flight(_collector.comm())
+                + _transport.in_flight();
+
+            MPI_Allreduce(
+                &in_flight, &global_in_flight, 1, MPI_LONG, MPI_SUM,
+                _director_comm
+            );
+        } while(global_in_flight != 0);
+
+        release_held_inputs();
+    }
+
+    // Take a checkpoint if the root finds one is due.
+    // This is a collective routine.
+    void checkpoint_if_due(void) {
+        int is_due = (MPI_Wtime() >= _next_checkpoint);
+        MPI_Bcast(&is_due, 1, MPI_INT, 0, _director_comm);
+
+        if(is_due && checkpoint(_checkpoint_path)) {
+            _next_checkpoint = MPI_Wtime() + _checkpoint_interval;
+        }
+    }
+
+    // Write this process's part of a checkpoint: its timers, messages
+    // waiting for actors yet to be born, and its actors, in the order
+    // they are queued in followed by those waiting for a message.
+    // Returns false if anything can't be saved.
+    bool save_process(CheckpointWriter& out) {
+        if(!_collector.is_idle()) return false;
+
+        out.write(_timers.pending());
+
+        out.write<long>(_unclaimed_messages.size());
+        for(
+            std::map<int, std::vector<Actor::Message> >::iterator it =
+                _unclaimed_messages.begin();
+            it != _unclaimed_messages.end(); ++it
+        ) {
+            out.write(it->first);
+            out.write<long>(it->second.size());
+            for(size_t i=0; i<it->second.size(); i++) {
+                save_message(out, it->second[i]);
+            }
+        }
+
+        out.write<long>(_actor_queue.size() + _waiting_actors.size());
+
+        std::queue<ActorWrap> queue = _actor_queue;
+        while(!queue.empty()) {
+            if(!save_actor(out, queue.front().actor, false)) return false;
+            queue.pop();
+        }
+
+        for(
+            std::map<int, ActorWrap>::iterator it = _waiting_actors.begin();
+            it != _waiting_actors.end(); ++it
+        ) {
+            if(!save_actor(out, it->second.actor, true)) return false;
+        }
+
+        return true;
+    }
+
+    // Write an actor and everything waiting for it.
+    bool save_actor(CheckpointWriter& out, Actor *actor, bool waiting) {
+        int factory_id = _actor_distributer.get_instance_id(actor);
+        if(
+            factory_id < 0 || !actor->_reply_handlers.empty()
+            || actor->is_held_up()
+        ) {
+            return false;
+        }
+
+        CheckpointWriter actor_out;
+        if(!actor->save(actor_out)) return false;
+
+        out.write(factory_id);
+        out.write(actor->_id);
+        out.write<int>(waiting);
+        out.write(actor->_lineage);
+        out.write(actor->_children);
+        out.write(actor->_counters);
+        out.write(actor->_aliases);
+
+        std::queue<Actor::Message> mailbox = actor->_mailbox;
+        out.write<long>(mailbox.size());
+        while(!mailbox.empty()) {
+            save_message(out, mailbox.front());
+            mailbox.pop();
+        }
+
+        out.write<long>(actor->_replies.size());
+        for(
+            std::map<int, Actor::Message>::iterator it =
+                actor->_replies.begin();
+            it != actor->_replies.end(); ++it
+        ) {
+            out.write(it->first);
+            save_message(out, it->second);
+        }
+
+        out.write(actor_out.bytes());
+
+        return true;
+    }
+
+    // Read back the timers and unclaimed messages written by
+    // save_process.
+    void restore_waiting_inputs(CheckpointReader& in) {
+        std::vector<Timers::Timer> timers;
+        in.read(timers);
+        for(size_t i=0; i<timers.size(); i++) {
+            _timers.restore(timers[i]);
+        }
+
+        long unclaimed_count = in.read<long>();
+        for(long i=0; i<unclaimed_count; i++) {
+            int gid = in.read<int>();
+
+            long message_count = in.read<long>();
+            for(long j=0; j<message_count; j++) {
+                _unclaimed_messages[gid].push_back(load_message(in));
+            }
+        }
+    }
+
+    // Read back the actors written by save_process, and add
+    // them to the cast.
+    void restore_actors(CheckpointReader& in) {
+        long actor_count = in.read<long>();
+
+        for(long i=0; i<actor_count; i++) {
+            Actor *actor =
+                _actor_distributer.create_from_id(in.read<int>());
+
+            Id id = in.read<Id>();
+            bool waiting = in.read<int>();
+
+            actor->initialize_comms(
+                id, _actor_comm, _group_comm, &_transport, &_exchange,
+                &_actor_distributer, &_collector, &_timers, &_statistics,
+                _mailbox_window, _is_timing_messages
+            );
+
+            in.read(actor->_lineage);
+            in.read(actor->_children);
+            record_placement(actor, false);
+
+            in.read(actor->_counters);
+            in.read(actor->_aliases);
+
+            long mailbox_size = in.read<long>();
+            for(long j=0; j<mailbox_size; j++) {
+                actor->deliver(load_message(in));
+            }
+
+            long reply_count = in.read<long>();
+            for(long j=0; j<reply_count; j++) {
+                int correlation_id = in.read<int>();
+                actor->_replies[correlation_id] = load_message(in);
+
+                // Keep new requests clear of the replies read back
+                actor->_request_count =
+                    std::max(actor->_request_count, correlation_id);
+            }
+
+            std::vector<char> actor_data;
+            in.read(actor_data);
+
+            CheckpointReader actor_in(actor_data);
+            actor->restore(actor_in);
+
+            add_to_cast(ActorWrap(actor, true), waiting);
+        }
+    }
+
+    // Write a message, including the gid it was sent to.
+    static void save_message(
+        CheckpointWriter& out, Actor::Message message
+    ) {
+        std::vector<char> data(message.data_size());
+        if(!data.empty()) message.data<char>(&data[0], data.size());
+
+        // Send stamps aren't kept, so timed messages come back untimed
+        Actor::Message::MetaData metadata =
+            message.metadata<Actor::Message::MetaData>();
+        metadata.flags &= ~Actor::Message::IS_TIMED;
+
+        out.write(message.source());
+        out.write(message.receiver_gid());
+        out.write(metadata);
+        out.write(data);
+    }
+
+    static Actor::Message load_message(CheckpointReader& in) {
+        int source = in.read<int>();
+        int gid = in.read<int>();
+        Actor::Message::MetaData metadata =
+            in.read<Actor::Message::MetaData>();
+
+        std::vector<char> data;
+        in.read(data);
+
+        Actor::Message message;
+        message.store_message<Actor::Message::MetaData>(
+            source, gid, data.empty() ? NULL : &data[0], data.size(),
+            &metadata
+        );
+
+        return message;
+    }
+
+
     DistributedFactory<Actor> _actor_distributer;
 
+    Collector _collector;
+
+    SharedTransport _transport;
+
+    Exchange _exchange;
+
+    Timers _timers;
+
+    // The mailbox window given to every actor. See set_mailbox_window.
+    int _mailbox_window;
+    static int& mailbox_window(void) {
+        static ACTOR_RANK_LOCAL int window = 0;
+        return window;
+    }
+
+    // Whether actors time their messages. See set_message_timing.
+    bool _is_timing_messages;
+    static bool& is_timing_messages(void) {
+        static ACTOR_RANK_LOCAL bool is_timing = false;
+        return is_timing;
+    }
+
+    Statistics _statistics;
+
+    Replay _replay;
+
 
     MPI_Comm _actor_comm;
+    MPI_Comm _group_comm;
     MPI_Comm _director_comm;
 
     int _comm_rank;
@@ -297,6 +1318,14 @@ private:
     bool _is_ended;
     int _sync_interval;
     int _tick_count;
+
+    // The number of actors added on this process, for their lineages.
+    int _added_count;
+
+    // Where and how often to take checkpoints while running.
+    std::string _checkpoint_path;
+    double _checkpoint_interval;
+    double _next_checkpoint;
 };
 
 
@@ -1,11 +1,13 @@
 #ifndef ACTOR_ACTOR_DISTRIBUTER_H_
 #define ACTOR_ACTOR_DISTRIBUTER_H_
 
-#include <mpi.h>
+#include "./backend.h"
 
 #include "./factory.h"
 #include "./id.h"
 #include "./message.h"
+#include "./placement.h"
+#include "./trace.h"
 
 namespace ActorModel {
 
@@ -20,6 +22,9 @@ namespace ActorModel {
  * As it requires a collective routine to initialize it, it must be
  * initialized simultaneously by all processes using it and have the
  * appropriate communicator passed to it.
+ *
+ * Each child carries a lineage, which a placement read from an earlier
+ * run can use to choose its rank instead of balancing.
  */
 template<class F>
 class DistributedFactory: public Factory<F> {
@@ -36,32 +41,44 @@ public:
     ~DistributedFactory() {
         // Clean up all outstanding requests
         while(is_child_waiting()){
-            int request[5];
+            int request[REQUEST_SIZE];
             get_requested_child_data(request);
         }
 
+        Message::in_flight(_distributer_comm) = 0;
         MPI_Comm_free(&_distributer_comm);
     }
 
 
     // Request that an instance of T be created on some process.
-    // If no rank is specified, an appropriate rank will be chosen
-    // in a balanced manner.
+    // If no rank is specified, the placement's rank for the lineage
+    // is used if it has one, and otherwise an appropriate rank will be
+    // chosen in a balanced manner.
     enum{ BIRTH_REQUEST };
     template<class T>
-    Id request_distributed_child(int rank=-1) {
+    Id request_distributed_child(int rank=-1, uint64_t lineage=0) {
         int factory_id = Factory<F>::template get_id<T>();
+
+        bool is_fixed = (rank >= 0);
+        if(!is_fixed) rank = _placement.rank_for(lineage, _comm_size);
+
         Id child_id = new_global_id(rank);
 
-        int request[3] = {
+        int request[REQUEST_SIZE] = {
             factory_id,
             child_id.rank(), child_id.gid(),
+            static_cast<int>(lineage & 0xffffffffu),
+            static_cast<int>(lineage >> 32),
+            is_fixed
         };
 
         Message::send<int>(
-            child_id.rank(), BIRTH_REQUEST, request, 3, _distributer_comm
+            child_id.process(), BIRTH_REQUEST, request, REQUEST_SIZE,
+            _distributer_comm
         );
 
+        Trace::birth_request(child_id.process(), child_id.gid());
+
         return child_id;
     }
 
@@ -76,10 +93,13 @@ public:
 
 
     // A simple structure to return an instance of a child, a subclass
-    // of F, along with an id for that child and the id of the parent.
+    // of F, along with an id for that child, its lineage, and whether
+    // its rank was asked for rather than chosen.
     struct Child {
         F *child;
         Id child_id;
+        uint64_t lineage;
+        bool is_fixed;
     };
 
 
@@ -89,13 +109,19 @@ public:
         if(is_child_waiting()) {
             Child new_child;
 
-            int request[3];
+            int request[REQUEST_SIZE];
             get_requested_child_data(request);
         
             int factory_id = request[0];
             new_child.child = Factory<F>::create_from_id(factory_id);
 
             new_child.child_id = Id(request[1], request[2]);
+            new_child.lineage =
+                static_cast<uint32_t>(request[3])
+                | (static_cast<uint64_t>(static_cast<uint32_t>(request[4])) << 32);
+            new_child.is_fixed = request[5];
+
+            Trace::birth(new_child.child_id.gid());
 
             return new_child;
         } else {
@@ -103,12 +129,27 @@ public:
 
             null_child.child = NULL;
             null_child.child_id = Id(-1, -1);
+            null_child.lineage = 0;
+            null_child.is_fixed = false;
 
             return null_child;
         }
     }
 
 
+    // The communicator birth requests are sent over.
+    MPI_Comm comm(void) {
+        return _distributer_comm;
+    }
+
+
+    // The placement consulted for children with no requested rank,
+    // which also records the actor graph while profiling.
+    Placement& placement(void) {
+        return _placement;
+    }
+
+
     // Get an id that is unique across processes, along with a
     // rank to place a child on.
     Id new_global_id(int rank=-1) {
@@ -129,11 +170,15 @@ public:
 
 private:
 
+    // The factory id, rank, gid, lineage in two halves, and whether
+    // the rank was asked for.
+    enum { REQUEST_SIZE = 6 };
+
     // Receive data from an incoming message
-    void get_requested_child_data(int request[3]) {
+    void get_requested_child_data(int request[REQUEST_SIZE]) {
         Message message;
         message.receive(MPI_ANY_SOURCE, BIRTH_REQUEST, _distributer_comm);
-        message.data<int>(request, 3);
+        message.data<int>(request, REQUEST_SIZE);
     }
 
     MPI_Comm _distributer_comm;
@@ -142,6 +187,8 @@ private:
     int _comm_size;
 
     int _current_rank;
+
+    Placement _placement;
 };
 
 
@@ -0,0 +1,574 @@
+#ifndef ACTOR_EXCHANGE_H_
+#define ACTOR_EXCHANGE_H_
+
+#include "./backend.h"
+#include <deque>
+#include <vector>
+#include <cstring>
+
+#include "./compound_message.h"
+
+
+namespace ActorModel {
+
+
+/**
+ * Exchange
+ *
+ * An exchange holds messages bound for other processes until every
+ * process exchanges them at once, with a single sparse collective,
+ * rather than sending each with its own point to point message.
+ *
+ * Messages are staged in a buffer per destination. At each exchange,
+ * the processes which send to each other are connected in an MPI-3
+ * distributed graph, the byte count for each edge is passed along it
+ * with MPI_Neighbor_alltoall, and the staged bytes follow with
+ * MPI_Neighbor_alltoallv. Nothing is left to do while the bytes are
+ * on their way, so the blocking collective is used.
+ *
+ * The graph is only rebuilt when a process stages messages for a
+ * process it isn't yet connected to. Edges are never removed, so an
+ * edge that falls out of use costs an empty block in each exchange.
+ * Finding out whether any process has new edges takes an allreduce
+ * at every exchange.
+ *
+ * Every exchange is a collective over all processes, so messages
+ * wait for the slowest process as well as for the next exchange.
+ * For actors that answer each other's messages rather than working
+ * in steps, this is currently a pessimisation: the frog benchmark on
+ * 4 processes takes 1.75 s exchanging every 100 ticks, against
+ * 0.88 s sending point to point.
+ *
+ * In THROUGH_LEADERS mode, the lowest rank on each node is its leader.
+ * Processes gather everything they've staged onto their leader, the
+ * leaders exchange it in one bundle per node over a graph of leaders,
+ * and each leader scatters what arrived among its own processes. Only
+ * leaders send between nodes, so the number of pairs talking across
+ * the network grows with the square of the nodes rather than of the
+ * processes.
+ */
+class Exchange {
+public:
+
+    enum Mode {
+        OFF,             // messages are sent as they're made
+        DIRECT,          // each process exchanges with the others
+        THROUGH_LEADERS  // node leaders exchange for their processes
+    };
+
+    Exchange(MPI_Comm comm):
+        _mode(OFF), _graph(comm), _has_nodes(false)
+    {
+        MPI_Comm_rank(_graph.comm, &_rank);
+        MPI_Comm_size(_graph.comm, &_size);
+
+        _staged.resize(_size);
+    }
+
+    ~Exchange() {
+        if(_has_nodes) {
+            if(_leaders != NULL) delete _leaders;
+            MPI_Comm_free(&_node_comm);
+        }
+    }
+
+
+    // Choose how messages to other processes are sent.
+    // Every process must make the same choice.
+    void set_mode(Mode mode) {
+        _mode = mode;
+    }
+
+    bool is_enabled(void) const {
+        return _mode != OFF;
+    }
+
+    // The number of times the graph has been built. In THROUGH_LEADERS
+    // mode, this only counts on leaders.
+    int graph_builds(void) const {
+        return (_mode == THROUGH_LEADERS)
+            ? ((_has_nodes && _leaders != NULL) ? _leaders->builds : 0)
+            : _graph.builds;
+    }
+
+    // Group processes onto nodes of this many ranks, in rank order,
+    // rather than by shared memory, for exchanges made from now on.
+    // 0 groups them by shared memory. This is mostly useful for trying
+    // out THROUGH_LEADERS on a single node.
+    static int& ranks_per_node(void) {
+        static ACTOR_RANK_LOCAL int ranks = 0;
+        return ranks;
+    }
+
+
+    // Stage a compound message for a process. It is sent at the
+    // next exchange.
+    void send(
+        int rank, int tag,
+        void const *metadata, size_t metadata_bytes,
+        void const *data, size_t data_bytes
+    ) {
+        std::vector<char>& staged = _staged[rank];
+
+        int header[3] = {
+            tag,
+            static_cast<int>(metadata_bytes),
+            static_cast<int>(data_bytes)
+        };
+        append(staged, header, sizeof(header));
+        append(staged, metadata, metadata_bytes);
+        append(staged, data, data_bytes);
+    }
+
+    // Send every staged message to its process, and take in those
+    // staged for this process elsewhere.
+    // This is a collective routine.
+    void exchange(void) {
+        if(_mode == THROUGH_LEADERS) {
+            exchange_through_leaders();
+            return;
+        }
+
+        std::vector< std::vector<char> > received;
+        _graph.exchange(_staged, &received);
+
+        for(size_t i=0; i<received.size(); i++) {
+            unpack(
+                _graph.sources[i],
+                data(received[i]), received[i].size()
+            );
+        }
+    }
+
+    // Receive a compound message taken in by an exchange,
+    // if there are any left.
+    bool receive(CompoundMessage *message) {
+        if(_received_messages.empty()) return false;
+
+        *message = _received_messages.front();
+        _received_messages.pop_front();
+
+        return true;
+    }
+
+
+private:
+
+    /**
+     * Graph
+     *
+     * A distributed graph of the processes of a communicator which
+     * send to each other, used to send a block of bytes to each
+     * destination.
+     */
+    struct Graph {
+        Graph(MPI_Comm comm_in): has_graph(false), builds(0) {
+            MPI_Comm_dup(comm_in, &comm);
+
+            int size;
+            MPI_Comm_size(comm, &size);
+            is_destination.assign(size, 0);
+        }
+
+        ~Graph() {
+            if(has_graph) MPI_Comm_free(&graph_comm);
+            MPI_Comm_free(&comm);
+        }
+
+        // Send blocks[rank] to each rank it isn't empty for, clearing
+        // it, and receive the blocks sent here, one per source.
+        // This is a collective routine.
+        void exchange(
+            std::vector< std::vector<char> >& blocks,
+            std::vector< std::vector<char> > *received
+        ) {
+            update(blocks);
+
+            received->clear();
+            if(!has_graph) return;
+
+            // Pass along how many bytes go down each edge
+            std::vector<int> send_counts(destinations.size());
+            std::vector<int> receive_counts(sources.size());
+            for(size_t i=0; i<destinations.size(); i++) {
+                send_counts[i] = blocks[destinations[i]].size();
+            }
+
+            MPI_Neighbor_alltoall(
+                data(send_counts), 1, MPI_INT,
+                data(receive_counts), 1, MPI_INT, graph_comm
+            );
+
+            // Lay the blocks out by edge and exchange them
+            std::vector<int> send_offsets(destinations.size());
+            std::vector<char> send_bytes;
+            for(size_t i=0; i<destinations.size(); i++) {
+                std::vector<char>& block = blocks[destinations[i]];
+
+                send_offsets[i] = send_bytes.size();
+                send_bytes.insert(send_bytes.end(), block.begin(), block.end());
+                block.clear();
+            }
+
+            std::vector<int> receive_offsets(sources.size());
+            int receive_total = 0;
+            for(size_t i=0; i<sources.size(); i++) {
+                receive_offsets[i] = receive_total;
+                receive_total += receive_counts[i];
+            }
+            std::vector<char> receive_bytes(receive_total);
+
+            MPI_Neighbor_alltoallv(
+                data(send_bytes), data(send_counts), data(send_offsets),
+                MPI_BYTE,
+                data(receive_bytes), data(receive_counts),
+                data(receive_offsets), MPI_BYTE, graph_comm
+            );
+
+            received->resize(sources.size());
+            for(size_t i=0; i<sources.size(); i++) {
+                char const *begin = data(receive_bytes) + receive_offsets[i];
+                (*received)[i].assign(begin, begin + receive_counts[i]);
+            }
+        }
+
+        // Connect any ranks newly sent to, rebuilding the graph
+        // everywhere if any rank has new ones.
+        // This is a collective routine.
+        void update(std::vector< std::vector<char> > const& blocks) {
+            int has_new = 0;
+            for(size_t rank=0; rank<blocks.size(); rank++) {
+                if(!blocks[rank].empty() && !is_destination[rank]) {
+                    is_destination[rank] = 1;
+                    has_new = 1;
+                }
+            }
+
+            int any_new;
+            MPI_Allreduce(&has_new, &any_new, 1, MPI_INT, MPI_MAX, comm);
+            if(!any_new) return;
+
+            // Find which ranks send to this one
+            std::vector<int> is_source(is_destination.size());
+            MPI_Alltoall(
+                &is_destination[0], 1, MPI_INT, &is_source[0], 1, MPI_INT, comm
+            );
+
+            sources.clear();
+            destinations.clear();
+            for(size_t rank=0; rank<is_destination.size(); rank++) {
+                if(is_source[rank]) sources.push_back(rank);
+                if(is_destination[rank]) destinations.push_back(rank);
+            }
+
+            if(has_graph) MPI_Comm_free(&graph_comm);
+
+            MPI_Dist_graph_create_adjacent(
+                comm,
+                sources.size(), data(sources), MPI_UNWEIGHTED,
+                destinations.size(), data(destinations), MPI_UNWEIGHTED,
+                MPI_INFO_NULL, 0, &graph_comm
+            );
+
+            has_graph = true;
+            builds++;
+        }
+
+        MPI_Comm comm;
+
+        MPI_Comm graph_comm;
+        bool has_graph;
+        int builds;
+
+        // This rank's neighbours in the graph
+        std::vector<int> sources;
+        std::vector<int> destinations;
+        std::vector<int> is_destination;
+    };
+
+
+    /*
+     * Exchanging through node leaders
+     *
+     * Staged messages travel as records: a header of the source rank,
+     * destination rank and byte count, followed by the bytes staged
+     * by the source for the destination.
+     */
+
+    // Gather staged messages onto node leaders, exchange them between
+    // leaders, and scatter them to the processes they're for.
+    // This is a collective routine.
+    void exchange_through_leaders(void) {
+        if(!_has_nodes) find_nodes();
+
+        std::vector<char> records;
+        for(int rank=0; rank<_size; rank++) {
+            if(_staged[rank].empty()) continue;
+
+            add_record(
+                &records, _rank, rank, data(_staged[rank]), _staged[rank].size()
+            );
+            _staged[rank].clear();
+        }
+
+        std::vector<char> node_records;
+        gather_to_leader(records, &node_records);
+
+        std::vector< std::vector<char> > for_processes(_node_size);
+        if(_leaders != NULL) {
+            exchange_between_leaders(node_records, &for_processes);
+        }
+
+        std::vector<char> mine;
+        scatter_from_leader(for_processes, &mine);
+
+        // Unpack the messages from each source
+        size_t offset = 0;
+        while(offset < mine.size()) {
+            int header[3];
+            std::memcpy(header, &mine[offset], sizeof(header));
+            offset += sizeof(header);
+
+            unpack(header[0], &mine[offset], header[2]);
+            offset += header[2];
+        }
+    }
+
+    // On a leader, sort the records from its node by the node they're
+    // for, exchange them with the other leaders, and sort what's for
+    // this node by the process it's for.
+    void exchange_between_leaders(
+        std::vector<char> const& node_records,
+        std::vector< std::vector<char> > *for_processes
+    ) {
+        int node_count = _leaders->is_destination.size();
+
+        std::vector< std::vector<char> > for_nodes(node_count);
+        std::vector<char> for_this_node;
+        sort_by_node(node_records, &for_nodes, &for_this_node);
+
+        std::vector< std::vector<char> > received;
+        _leaders->exchange(for_nodes, &received);
+
+        for(size_t i=0; i<received.size(); i++) {
+            for_this_node.insert(
+                for_this_node.end(), received[i].begin(), received[i].end()
+            );
+        }
+
+        // Sort by the process on this node each record is for
+        size_t offset = 0;
+        while(offset < for_this_node.size()) {
+            int header[3];
+            std::memcpy(header, &for_this_node[offset], sizeof(header));
+
+            size_t record_bytes = sizeof(header) + header[2];
+            std::vector<char>& to = (*for_processes)[_node_rank_of[header[1]]];
+            to.insert(
+                to.end(),
+                for_this_node.begin() + offset,
+                for_this_node.begin() + offset + record_bytes
+            );
+
+            offset += record_bytes;
+        }
+    }
+
+    // Sort records by the node they're for, keeping those for this
+    // node apart.
+    void sort_by_node(
+        std::vector<char> const& records,
+        std::vector< std::vector<char> > *for_nodes,
+        std::vector<char> *for_this_node
+    ) {
+        size_t offset = 0;
+        while(offset < records.size()) {
+            int header[3];
+            std::memcpy(header, &records[offset], sizeof(header));
+
+            size_t record_bytes = sizeof(header) + header[2];
+            int node = _node_of[header[1]];
+
+            std::vector<char>& to =
+                (node == _node_of[_rank]) ? *for_this_node : (*for_nodes)[node];
+            to.insert(
+                to.end(),
+                records.begin() + offset,
+                records.begin() + offset + record_bytes
+            );
+
+            offset += record_bytes;
+        }
+    }
+
+    // Gather the records of every process on a node onto its leader.
+    void gather_to_leader(
+        std::vector<char> const& records, std::vector<char> *node_records
+    ) {
+        int count = records.size();
+        std::vector<int> counts(_node_size);
+        MPI_Gather(&count, 1, MPI_INT, &counts[0], 1, MPI_INT, 0, _node_comm);
+
+        std::vector<int> offsets(_node_size);
+        int total = 0;
+        for(int i=0; i<_node_size; i++) {
+            offsets[i] = total;
+            total += counts[i];
+        }
+
+        node_records->resize(_leaders != NULL ? total : 0);
+        MPI_Gatherv(
+            const_cast<char*>(records.empty() ? NULL : &records[0]),
+            count, MPI_BYTE,
+            data(*node_records), &counts[0], &offsets[0], MPI_BYTE,
+            0, _node_comm
+        );
+    }
+
+    // Scatter the records for each process on a node from its leader.
+    void scatter_from_leader(
+        std::vector< std::vector<char> >& for_processes,
+        std::vector<char> *mine
+    ) {
+        std::vector<int> counts(_node_size);
+        std::vector<int> offsets(_node_size);
+        std::vector<char> bytes;
+        for(int i=0; i<_node_size; i++) {
+            counts[i] = for_processes[i].size();
+            offsets[i] = bytes.size();
+            bytes.insert(
+                bytes.end(), for_processes[i].begin(), for_processes[i].end()
+            );
+        }
+
+        int count;
+        MPI_Scatter(&counts[0], 1, MPI_INT, &count, 1, MPI_INT, 0, _node_comm);
+
+        mine->resize(count);
+        MPI_Scatterv(
+            data(bytes), &counts[0], &offsets[0], MPI_BYTE,
+            data(*mine), count, MPI_BYTE, 0, _node_comm
+        );
+    }
+
+    // Split the processes into nodes, and connect the leaders.
+    // This is a collective routine.
+    void find_nodes(void) {
+        if(ranks_per_node() > 0) {
+            MPI_Comm_split(
+                _graph.comm, _rank/ranks_per_node(), _rank, &_node_comm
+            );
+        } else {
+            MPI_Comm_split_type(
+                _graph.comm, MPI_COMM_TYPE_SHARED, _rank, MPI_INFO_NULL,
+                &_node_comm
+            );
+        }
+
+        int node_rank;
+        MPI_Comm_rank(_node_comm, &node_rank);
+        MPI_Comm_size(_node_comm, &_node_size);
+
+        // Leaders get a communicator of their own, where their rank
+        // is the index of their node
+        MPI_Comm leader_comm;
+        MPI_Comm_split(
+            _graph.comm, (node_rank == 0) ? 0 : MPI_UNDEFINED, _rank,
+            &leader_comm
+        );
+
+        int node = 0;
+        if(node_rank == 0) MPI_Comm_rank(leader_comm, &node);
+        MPI_Bcast(&node, 1, MPI_INT, 0, _node_comm);
+
+        _node_of.resize(_size);
+        _node_rank_of.resize(_size);
+        MPI_Allgather(&node, 1, MPI_INT, &_node_of[0], 1, MPI_INT, _graph.comm);
+        MPI_Allgather(
+            &node_rank, 1, MPI_INT, &_node_rank_of[0], 1, MPI_INT, _graph.comm
+        );
+
+        _leaders = NULL;
+        if(node_rank == 0) {
+            _leaders = new Graph(leader_comm);
+            MPI_Comm_free(&leader_comm);
+        }
+
+        _has_nodes = true;
+    }
+
+    static void add_record(
+        std::vector<char> *records, int source, int destination,
+        char const *bytes, size_t count
+    ) {
+        int header[3] = {source, destination, static_cast<int>(count)};
+        append(*records, header, sizeof(header));
+        append(*records, bytes, count);
+    }
+
+
+    // Turn the bytes received from a process into compound messages.
+    void unpack(int source, char const *bytes, size_t count) {
+        size_t offset = 0;
+        while(offset < count) {
+            int header[3];
+            std::memcpy(header, bytes + offset, sizeof(header));
+            offset += sizeof(header);
+
+            char const *metadata = bytes + offset;
+            offset += header[1];
+
+            char const *message_data = bytes + offset;
+            offset += header[2];
+
+            _received_messages.push_back(CompoundMessage());
+            _received_messages.back().store_message(
+                source, header[0], message_data, header[2],
+                metadata, header[1]
+            );
+        }
+    }
+
+    static void append(
+        std::vector<char>& bytes, void const *data, size_t count
+    ) {
+        char const *begin = static_cast<char const*>(data);
+        bytes.insert(bytes.end(), begin, begin + count);
+    }
+
+    template<class T>
+    static T* data(std::vector<T>& values) {
+        return values.empty() ? NULL : &values[0];
+    }
+
+
+    Mode _mode;
+
+    int _rank;
+    int _size;
+
+    // The graph of processes exchanging messages directly
+    Graph _graph;
+
+    // The processes on this node, and the graph of node leaders,
+    // which is only set on leaders.
+    bool _has_nodes;
+    MPI_Comm _node_comm;
+    int _node_size;
+    Graph *_leaders;
+
+    // The node of every process, and its rank on that node.
+    std::vector<int> _node_of;
+    std::vector<int> _node_rank_of;
+
+    // Bytes staged for each process
+    std::vector< std::vector<char> > _staged;
+
+    std::deque<CompoundMessage> _received_messages;
+};
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_EXCHANGE_H_
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <exception>
+#include <typeinfo>
 #include <cstddef>
 
 namespace ActorModel {
@@ -36,6 +37,7 @@ public:
     template<class T>
     int register_child(void) {
         _F_creators.push_back(create_new<T>);
+        _F_types.push_back(&typeid(T));
         return _F_creators.size()-1;
     }
 
@@ -65,6 +67,21 @@ public:
     };
 
 
+    /*
+     * Find the id in the factory of the role an existing instance
+     * was created as. Returns -1 if its role isn't registered.
+     */
+    int get_instance_id(F *instance) {
+        for(size_t i=0; i<_F_types.size(); ++i) {
+            if(*_F_types[i] == typeid(*instance)) {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+
     /*
      * If a role_id in the factory is known, a new instance of the role
      * can be generated by using
@@ -76,6 +93,7 @@ public:
 
 private:
     std::vector<create_new_T_signature*> _F_creators;
+    std::vector<std::type_info const*> _F_types;
 };
 
 
@@ -0,0 +1,324 @@
+#ifndef ACTOR_GROUP_H_
+#define ACTOR_GROUP_H_
+
+#include "./backend.h"
+#include <vector>
+#include <map>
+#include <set>
+#include <cstring>
+
+#include "./id.h"
+#include "./message.h"
+
+
+namespace ActorModel {
+
+
+/**
+ * Group
+ *
+ * A Group is a list of actor Ids that can be messaged all at once.
+ *
+ * Members are kept in the order they were added. When a message is
+ * sent to a group, the members are bucketed by the rank they live on,
+ * so only one message needs to travel to each rank.
+ */
+class Group {
+public:
+
+    // Add an actor to the group.
+    void add(Id const& actor_id) {
+        _members.push_back(actor_id);
+    }
+
+    // Remove all actors from the group.
+    void clear(void) {
+        _members.clear();
+    }
+
+    // The number of actors in the group.
+    size_t size(void) const {
+        return _members.size();
+    }
+
+    // Get the id of the i'th actor added to the group.
+    Id const& operator[](size_t i) const {
+        return _members[i];
+    }
+
+    // The number of distinct ranks the group lives on.
+    size_t rank_count(void) const {
+        std::set<int> ranks;
+        for(size_t i=0; i<_members.size(); i++) {
+            ranks.insert(_members[i].process());
+        }
+
+        return ranks.size();
+    }
+
+private:
+    std::vector<Id> _members;
+};
+
+
+/**
+ * GroupMessage
+ *
+ * This class packs a message for a Group into a single buffer and
+ * fans it out across ranks.
+ *
+ * A group message holds one block per destination rank, listing the gids
+ * on that rank that should receive the message. It is first sent to the
+ * rank of the first block. That rank forwards the remaining blocks along
+ * a binomial tree and then delivers the message to its own actors, so
+ * no rank sends more than log2(ranks) messages for a single group send.
+ *
+ * A group message can also start a collective (a gather or reduction),
+ * in which case it carries the id of the collective, the operation to
+ * combine with, and the index of each member in the group.
+ *
+ * As with Message, data is passed as MPI_BYTE, so this won't work on
+ * a hetrogenous system.
+ */
+class GroupMessage {
+public:
+
+    // Message tag used on the group communicator
+    enum { GROUP_MESSAGE };
+
+    // The gids of group members living on a given rank,
+    // and their index in the group.
+    struct Block {
+        int rank;
+        std::vector<int> gids;
+        std::vector<int> indices;
+    };
+
+
+    // Send an array of data to every actor in a group.
+    // If collective_id is non-zero, the message starts a collective
+    // combined using the operation op.
+    template<class T>
+    static void send(
+        Group const& group, Id const& sender_id, int tag,
+        T *data, size_t data_count, MPI_Comm comm,
+        int collective_id=0, int op=0
+    ) {
+        if(group.size() == 0) return;
+
+        GroupMessage message;
+
+        message._sender_id = sender_id;
+        message._tag = tag;
+        message._collective_id = collective_id;
+        message._op = op;
+
+        message._payload.resize(data_count*sizeof(T));
+        if(data_count > 0) {
+            std::memcpy(&message._payload[0], data, data_count*sizeof(T));
+        }
+
+        message.bucket_members(group, sender_id.process());
+
+        message.send_blocks(0, message._blocks.size(), comm);
+    }
+
+
+    // Receive a group message if one is waiting.
+    bool receive(MPI_Comm comm) {
+        Message message;
+
+        if(!message.receive(MPI_ANY_SOURCE, GROUP_MESSAGE, comm)) {
+            return false;
+        }
+
+        std::vector<char> buffer(message.data_size());
+        message.data<char>(&buffer[0], buffer.size());
+
+        unpack(buffer);
+
+        return true;
+    }
+
+
+    // Forward the blocks for other ranks on to them.
+    // The first block always belongs to the receiving rank.
+    void forward(MPI_Comm comm) {
+        size_t count = _blocks.size();
+
+        while(count > 1) {
+            size_t mid = (count+1)/2;
+
+            send_blocks(mid, count, comm);
+
+            count = mid;
+        }
+    }
+
+
+    // The gids on the receiving rank that the message is for.
+    std::vector<int> const& local_gids(void) const {
+        return _blocks[0].gids;
+    }
+
+    // The group indices of the gids on the receiving rank.
+    std::vector<int> const& local_indices(void) const {
+        return _blocks[0].indices;
+    }
+
+    // Information about the message itself.
+    Id sender_id(void) const { return _sender_id; }
+    int tag(void) const { return _tag; }
+
+    // Information about the collective the message starts, if any.
+    bool is_collective(void) const { return _collective_id != 0; }
+    int collective_id(void) const { return _collective_id; }
+    int op(void) const { return _op; }
+
+    char const* data(void) const {
+        return _payload.empty() ? NULL : &_payload[0];
+    }
+    size_t data_size(void) const { return _payload.size(); }
+
+
+private:
+
+    // Split group members into blocks by rank.
+    // Blocks are ordered by rank, starting from first_rank and wrapping
+    // around, so a sender on a rank holding members delivers to itself
+    // first.
+    void bucket_members(Group const& group, int first_rank) {
+        std::map<int, Block> rank_blocks;
+
+        for(size_t i=0; i<group.size(); i++) {
+            Block& block = rank_blocks[group[i].process()];
+
+            block.rank = group[i].process();
+            block.gids.push_back(group[i].gid());
+            block.indices.push_back(i);
+        }
+
+        std::map<int, Block>::iterator split =
+            rank_blocks.lower_bound(first_rank);
+
+        for(
+            std::map<int, Block>::iterator it = split;
+            it != rank_blocks.end(); ++it
+        ) {
+            _blocks.push_back(it->second);
+        }
+        for(
+            std::map<int, Block>::iterator it = rank_blocks.begin();
+            it != split; ++it
+        ) {
+            _blocks.push_back(it->second);
+        }
+    }
+
+
+    // Send blocks [first, last) to the rank of the first of them.
+    void send_blocks(size_t first, size_t last, MPI_Comm comm) {
+        std::vector<char> buffer;
+        pack(first, last, buffer);
+
+        Message::send<char>(
+            _blocks[first].rank, GROUP_MESSAGE,
+            &buffer[0], buffer.size(), comm
+        );
+    }
+
+
+    /*
+     * Buffer layout, all in int except the payload:
+     *  sender rank, sender gid, tag, collective id, op, block count,
+     *  for each block: rank, gid count, gids..., indices...
+     *  payload bytes
+     */
+    void pack(size_t first, size_t last, std::vector<char>& buffer) {
+        std::vector<int> header;
+
+        header.push_back(_sender_id.rank());
+        header.push_back(_sender_id.gid());
+        header.push_back(_tag);
+        header.push_back(_collective_id);
+        header.push_back(_op);
+        header.push_back(last - first);
+
+        for(size_t i=first; i<last; i++) {
+            Block const& block = _blocks[i];
+
+            header.push_back(block.rank);
+            header.push_back(block.gids.size());
+            header.insert(header.end(), block.gids.begin(), block.gids.end());
+            header.insert(
+                header.end(), block.indices.begin(), block.indices.end()
+            );
+        }
+
+        size_t header_bytes = header.size()*sizeof(int);
+
+        buffer.resize(header_bytes + _payload.size());
+        std::memcpy(&buffer[0], &header[0], header_bytes);
+        if(!_payload.empty()) {
+            std::memcpy(
+                &buffer[header_bytes], &_payload[0], _payload.size()
+            );
+        }
+    }
+
+    void unpack(std::vector<char> const& buffer) {
+        size_t offset = 0;
+
+        int sender_rank = read_int(buffer, offset);
+        int sender_gid  = read_int(buffer, offset);
+        _sender_id = Id(sender_rank, sender_gid);
+        _tag = read_int(buffer, offset);
+        _collective_id = read_int(buffer, offset);
+        _op = read_int(buffer, offset);
+
+        int block_count = read_int(buffer, offset);
+        _blocks.resize(block_count);
+
+        for(int i=0; i<block_count; i++) {
+            Block& block = _blocks[i];
+
+            block.rank = read_int(buffer, offset);
+
+            int gid_count = read_int(buffer, offset);
+            block.gids.resize(gid_count);
+            block.indices.resize(gid_count);
+            for(int j=0; j<gid_count; j++) {
+                block.gids[j] = read_int(buffer, offset);
+            }
+            for(int j=0; j<gid_count; j++) {
+                block.indices[j] = read_int(buffer, offset);
+            }
+        }
+
+        _payload.assign(buffer.begin() + offset, buffer.end());
+    }
+
+    static int read_int(std::vector<char> const& buffer, size_t& offset) {
+        int value;
+        std::memcpy(&value, &buffer[offset], sizeof(int));
+        offset += sizeof(int);
+
+        return value;
+    }
+
+
+    Id _sender_id;
+    int _tag;
+
+    int _collective_id;
+    int _op;
+
+    std::vector<Block> _blocks;
+    std::vector<char> _payload;
+};
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_GROUP_H_
@@ -0,0 +1,192 @@
+#ifndef ACTOR_HISTOGRAM_H_
+#define ACTOR_HISTOGRAM_H_
+
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+
+
+namespace ActorModel {
+
+
+/**
+ * Histogram
+ *
+ * A histogram of durations, with buckets spaced like those of an HDR
+ * histogram: each power of two of nanoseconds is split into SUB_BUCKETS
+ * buckets of equal width, so every value is kept to within about 6%,
+ * from a nanosecond up to a couple of days, in a fixed amount of
+ * memory. Histograms of the same durations on different processes can
+ * be added together bucket by bucket.
+ */
+class Histogram {
+public:
+
+    Histogram():
+        _buckets(BUCKET_COUNT, 0), _count(0), _total(0.0),
+        _min(0.0), _max(0.0)
+    {}
+
+
+    // Record a duration, in seconds. Negative durations, as from clocks
+    // on different nodes that don't quite agree, are counted as 0.
+    void record(double seconds) {
+        if(seconds < 0.0) seconds = 0.0;
+
+        _buckets[bucket_of(seconds*1e9)]++;
+
+        if(_count == 0 || seconds < _min) _min = seconds;
+        if(_count == 0 || seconds > _max) _max = seconds;
+        _count++;
+        _total += seconds;
+    }
+
+    // Add the durations of another histogram to this one.
+    void add(Histogram const& other) {
+        if(other._count == 0) return;
+
+        for(size_t i=0; i<_buckets.size(); i++) {
+            _buckets[i] += other._buckets[i];
+        }
+
+        if(_count == 0 || other._min < _min) _min = other._min;
+        if(_count == 0 || other._max > _max) _max = other._max;
+        _count += other._count;
+        _total += other._total;
+    }
+
+
+    long count(void) const {
+        return _count;
+    }
+
+    double mean(void) const {
+        return _count > 0 ? _total/_count : 0.0;
+    }
+
+    double min(void) const {
+        return _min;
+    }
+
+    double max(void) const {
+        return _max;
+    }
+
+    // The duration, in seconds, that percent of the recorded durations
+    // are no longer than. This is the top of the bucket the duration
+    // falls in, so it may overestimate by a bucket's width.
+    double percentile(double percent) const {
+        if(_count == 0) return 0.0;
+
+        long rank = static_cast<long>(percent/100.0*_count + 0.5);
+        if(rank < 1) rank = 1;
+        if(rank > _count) rank = _count;
+
+        long seen = 0;
+        for(size_t i=0; i<_buckets.size(); i++) {
+            seen += _buckets[i];
+            if(seen >= rank) {
+                double top = (lowest_in(i+1) - 1)*1e-9;
+                return top < _max ? top : _max;
+            }
+        }
+
+        return _max;
+    }
+
+
+    // Append the histogram to a buffer, keeping only its non-empty
+    // buckets.
+    void pack(std::vector<char>& buffer) const {
+        append(buffer, _count);
+        append(buffer, _total);
+        append(buffer, _min);
+        append(buffer, _max);
+
+        int used = 0;
+        for(size_t i=0; i<_buckets.size(); i++) {
+            if(_buckets[i] != 0) used++;
+        }
+
+        append(buffer, used);
+        for(int i=0; i<static_cast<int>(_buckets.size()); i++) {
+            if(_buckets[i] == 0) continue;
+
+            append(buffer, i);
+            append(buffer, _buckets[i]);
+        }
+    }
+
+    // Read back a histogram written by pack, moving offset past it.
+    static Histogram unpack(std::vector<char> const& buffer, size_t *offset) {
+        Histogram histogram;
+
+        take(buffer, offset, &histogram._count);
+        take(buffer, offset, &histogram._total);
+        take(buffer, offset, &histogram._min);
+        take(buffer, offset, &histogram._max);
+
+        int used;
+        take(buffer, offset, &used);
+        for(int i=0; i<used; i++) {
+            int bucket;
+            take(buffer, offset, &bucket);
+            take(buffer, offset, &histogram._buckets[bucket]);
+        }
+
+        return histogram;
+    }
+
+
+private:
+
+    // Buckets for each power of two, and the powers of two covered.
+    enum { SUB_BUCKET_BITS = 4, SUB_BUCKETS = 1 << SUB_BUCKET_BITS };
+    enum { MAX_BITS = 48, BUCKET_COUNT = (MAX_BITS - SUB_BUCKET_BITS + 1)*SUB_BUCKETS };
+
+    static size_t bucket_of(double nanoseconds) {
+        uint64_t value = static_cast<uint64_t>(nanoseconds);
+        if(value < SUB_BUCKETS) return value;
+
+        int top_bit = 0;
+        while((value >> (top_bit+1)) != 0) top_bit++;
+
+        int shift = top_bit - SUB_BUCKET_BITS;
+        size_t bucket = (shift+1)*SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS);
+
+        return bucket < BUCKET_COUNT ? bucket : BUCKET_COUNT - 1;
+    }
+
+    // The smallest number of nanoseconds in a bucket.
+    static uint64_t lowest_in(size_t bucket) {
+        if(bucket < SUB_BUCKETS) return bucket;
+
+        int shift = bucket/SUB_BUCKETS - 1;
+        return static_cast<uint64_t>(bucket%SUB_BUCKETS + SUB_BUCKETS) << shift;
+    }
+
+    template<class T>
+    static void append(std::vector<char>& buffer, T const& value) {
+        char const *bytes = reinterpret_cast<char const*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    template<class T>
+    static void take(std::vector<char> const& buffer, size_t *offset, T *value) {
+        std::memcpy(value, &buffer[*offset], sizeof(T));
+        *offset += sizeof(T);
+    }
+
+
+    std::vector<long> _buckets;
+    long _count;
+    double _total;
+    double _min;
+    double _max;
+};
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_HISTOGRAM_H_
@@ -1,6 +1,8 @@
 #ifndef ACTOR_ID_H_
 #define ACTOR_ID_H_
 
+#include "./backend.h"
+
 
 namespace ActorModel {
 
@@ -27,6 +29,22 @@ public:
         return _rank;
     }
 
+    // The process the actor lives on. This is its rank, unless the
+    // actors were restarted from a checkpoint on fewer processes than
+    // they were saved from, in which case ranks are folded onto the
+    // processes there are.
+    int process(void) const {
+        int count = process_count();
+        return (count > 0) ? _rank % count : _rank;
+    }
+
+    // The number of processes actors are spread over. Set by the
+    // Director.
+    static int& process_count(void) {
+        static ACTOR_RANK_LOCAL int count = 0;
+        return count;
+    }
+
     // Accessor for _gid
     int gid(void) const {
         return _gid;
@@ -42,26 +60,46 @@ public:
      * processes.
      */
     static int new_global_id(void) {
-        static int last_gid = -1;
-        static int mpi_rank;
-        static int mpi_size;
+        GlobalIds& ids = global_ids();
+        ids.last += ids.size;
 
-        // If uninitialized, initialize
-        if(last_gid == -1) {
-            MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
-            MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
-
-            last_gid = mpi_rank;
-        }
+        return ids.last;
+    }
 
-        last_gid += mpi_size;
+    // Make sure every id given out from now on is larger than past,
+    // such as the ids in use when a checkpoint was taken.
+    static void skip_global_ids(int past) {
+        GlobalIds& ids = global_ids();
 
-        return last_gid;
+        if(ids.last < past) {
+            ids.last += ((past - ids.last)/ids.size + 1)*ids.size;
+        }
     }
 
 
 private:
 
+    // The last global id given out, and the step between ids.
+    struct GlobalIds {
+        int last;
+        int size;
+    };
+
+    static GlobalIds& global_ids(void) {
+        static ACTOR_RANK_LOCAL GlobalIds ids = {-1, 0};
+
+        // If uninitialized, initialize
+        if(ids.size == 0) {
+            int mpi_rank;
+            MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+            MPI_Comm_size(MPI_COMM_WORLD, &ids.size);
+
+            ids.last = mpi_rank;
+        }
+
+        return ids;
+    }
+
     int _rank;
     int _gid;
 };
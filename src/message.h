@@ -1,6 +1,10 @@
 #ifndef MESSAGE_H_
 #define MESSAGE_H_
 
+#include <map>
+#include <vector>
+#include <cstring>
+
 #include "./status.h"
 
 
@@ -77,6 +81,8 @@ public:
             send_rank, send_tag,
             comm
         );
+
+        in_flight(comm)++;
     }
 
     // Send a single data message
@@ -88,10 +94,24 @@ public:
     }
 
 
+    // Store a message that was delivered locally rather than received
+    // through MPI. It will then behave as if it had been received
+    // from the given source with the given tag.
+    void store(int source, int tag, void const *data, size_t data_bytes) {
+        _status = Status(source, tag);
+
+        _data.resize(data_bytes);
+        if(data_bytes > 0) {
+            std::memcpy(&_data[0], data, data_bytes);
+        }
+    }
+
+
     // Receive a message.
-    bool receive(int source, int tag, MPI_Comm comm) {
+    // If wait is set, block until a matching message arrives.
+    bool receive(int source, int tag, MPI_Comm comm, bool wait=false) {
 
-        _status = Status(source, tag, comm);
+        _status = Status(source, tag, comm, wait);
 
         if(_status.is_waiting()) {
 
@@ -129,6 +149,8 @@ public:
                 &ignore
             );
 
+            in_flight(comm)--;
+
 
             // Everything completed successfully
             return true;
@@ -141,6 +163,26 @@ public:
     }
 
 
+    // The number of messages sent on a communicator by this process,
+    // less the number received. Summed over every process, this is
+    // the number of messages still in flight on the communicator.
+    // Owners of a communicator should reset its count before freeing it.
+    // Sends mostly go over one communicator in a row, so the count last
+    // asked for is kept to hand rather than looked up each time.
+    static long& in_flight(MPI_Comm comm) {
+        static ACTOR_RANK_LOCAL std::map<MPI_Comm, long> counts;
+        static ACTOR_RANK_LOCAL MPI_Comm last_comm = MPI_COMM_NULL;
+        static ACTOR_RANK_LOCAL long *last_count = NULL;
+
+        if(last_count != NULL && comm == last_comm) return *last_count;
+
+        last_comm = comm;
+        last_count = &counts[comm];
+
+        return *last_count;
+    }
+
+
 private:
 
     // Vector storing message data
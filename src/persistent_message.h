@@ -0,0 +1,104 @@
+#ifndef ACTOR_PERSISTENT_MESSAGE_H_
+#define ACTOR_PERSISTENT_MESSAGE_H_
+
+#include <vector>
+#include <cstring>
+
+#include "./message.h"
+
+
+namespace ActorModel {
+
+
+/**
+ * PersistentMessage
+ *
+ * This class sends compound messages of a fixed size to a fixed rank
+ * and tag over and over, using persistent buffered sends.
+ *
+ * The metadata and data sends are set up once, with MPI_Bsend_init,
+ * and every send copies the new values into the message's own
+ * buffers and restarts both requests. This skips the argument checks
+ * and request setup MPI does for every new send.
+ *
+ * Messages are received exactly as if they had been sent with
+ * CompoundMessage::send_message, so the receiver needn't know they
+ * were sent this way.
+ *
+ * As with MPI_Bsend, a started send is copied out to the attached
+ * buffer, so waiting for it to finish before the next send never
+ * waits on the receiver.
+ */
+class PersistentMessage {
+public:
+
+    PersistentMessage(
+        int send_rank, int send_tag,
+        size_t metadata_bytes, size_t data_bytes,
+        MPI_Comm comm
+    ):
+        _metadata(metadata_bytes), _data(data_bytes),
+        _is_started(false), _comm(comm)
+    {
+        MPI_Bsend_init(
+            buffer(_metadata), _metadata.size(), MPI_BYTE,
+            send_rank, send_tag, comm, &_requests[0]
+        );
+        MPI_Bsend_init(
+            buffer(_data), _data.size(), MPI_BYTE,
+            send_rank, send_tag, comm, &_requests[1]
+        );
+    }
+
+    ~PersistentMessage() {
+        if(_is_started) MPI_Waitall(2, _requests, MPI_STATUSES_IGNORE);
+
+        MPI_Request_free(&_requests[0]);
+        MPI_Request_free(&_requests[1]);
+    }
+
+
+    // Send the metadata and data. These should be as many bytes as
+    // the message was set up with.
+    void send(void const *metadata, void const *data) {
+        if(_is_started) MPI_Waitall(2, _requests, MPI_STATUSES_IGNORE);
+
+        if(!_metadata.empty()) {
+            std::memcpy(&_metadata[0], metadata, _metadata.size());
+        }
+        if(!_data.empty()) {
+            std::memcpy(&_data[0], data, _data.size());
+        }
+
+        MPI_Startall(2, _requests);
+        _is_started = true;
+
+        Message::in_flight(_comm) += 2;
+    }
+
+
+private:
+
+    // Persistent requests hold on to their buffers, so they
+    // can't be copied.
+    PersistentMessage(PersistentMessage const&);
+    PersistentMessage& operator=(PersistentMessage const&);
+
+    static char* buffer(std::vector<char>& bytes) {
+        return bytes.empty() ? NULL : &bytes[0];
+    }
+
+    std::vector<char> _metadata;
+    std::vector<char> _data;
+
+    MPI_Request _requests[2];
+    bool _is_started;
+
+    MPI_Comm _comm;
+};
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_PERSISTENT_MESSAGE_H_
@@ -0,0 +1,617 @@
+#ifndef ACTOR_PLACEMENT_H_
+#define ACTOR_PLACEMENT_H_
+
+#include "./backend.h"
+#include <map>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+
+namespace ActorModel {
+
+
+/**
+ * Placement
+ *
+ * A placement learns where actors should be born from the messages
+ * they sent in an earlier run, so actors which talk a lot end up on
+ * the same process.
+ *
+ * Actors are matched between runs by their lineage, a key made from
+ * the lineage of their parent and how many children the parent had
+ * before them. Actors added to a director have a lineage made from
+ * the rank they were added on and how many were added there before
+ * them. As long as a run makes the same births in the same order as
+ * the one profiled, its actors get the same lineages.
+ *
+ * While profiling, every actor born on a process is recorded, along
+ * with the number of messages and bytes each actor sends directly to
+ * each other actor. write gathers this on the root, which partitions
+ * the actors between processes and writes a file of the process for
+ * each lineage. The file starts with a commented summary of the
+ * messages sent between each pair of actor types.
+ *
+ * Once a placement file has been read, births with no requested rank
+ * go to the rank the placement gives, if it has one for the child.
+ */
+class Placement {
+public:
+
+    Placement(): _is_profiling(false) {}
+
+
+    // The lineage of the index-th child of an actor.
+    static uint64_t child_lineage(uint64_t parent, int index) {
+        return mix(parent ^ mix(static_cast<uint64_t>(index) + 1));
+    }
+
+    // The lineage of the index-th actor added to a director on a rank.
+    static uint64_t root_lineage(int rank, int index) {
+        return mix((static_cast<uint64_t>(rank) << 32) ^ index);
+    }
+
+
+    /*
+     * Profiling
+     */
+
+    void set_profiling(bool is_profiling) {
+        _is_profiling = is_profiling;
+    }
+
+    bool is_profiling(void) const {
+        return _is_profiling;
+    }
+
+    // Record an actor born on rank. An actor is fixed if it was put
+    // on its rank on purpose, rather than left to be balanced.
+    void record_actor(
+        int gid, uint64_t lineage, std::string const& type,
+        int rank, bool is_fixed
+    ) {
+        ActorRecord& actor = _actors[gid];
+        actor.lineage = lineage;
+        actor.rank = rank;
+        actor.is_fixed = is_fixed;
+        actor.type = type;
+    }
+
+    // Record a message sent directly from one actor to another.
+    void record_message(int sender_gid, int receiver_gid, size_t bytes) {
+        Traffic& traffic = _traffic[std::make_pair(sender_gid, receiver_gid)];
+        traffic.messages++;
+        traffic.bytes += bytes;
+    }
+
+
+    // Partition the actors recorded on every process between
+    // rank_count ranks, and write the placement to path from the root.
+    // Returns false on every process if the file can't be written.
+    // This is a collective routine.
+    bool write(MPI_Comm comm, std::string const& path, int rank_count) {
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+
+        std::vector<char> all_records;
+        gather(comm, pack(), &all_records);
+
+        int is_written = 1;
+        if(rank == 0) {
+            std::map<int, ActorRecord> actors;
+            std::map<std::pair<int, int>, Traffic> traffic;
+            unpack(all_records, &actors, &traffic);
+
+            std::ofstream out(path.c_str());
+            write_type_summary(out, actors, traffic);
+            write_ranks(out, actors, traffic, rank_count);
+
+            is_written = out.good();
+        }
+
+        MPI_Bcast(&is_written, 1, MPI_INT, 0, comm);
+
+        return is_written;
+    }
+
+
+    /*
+     * Placing
+     */
+
+    // Read a placement written by write. Returns false if the file
+    // can't be read.
+    bool read(std::string const& path) {
+        std::ifstream in(path.c_str());
+        if(!in) return false;
+
+        _ranks.clear();
+
+        std::string line;
+        while(std::getline(in, line)) {
+            if(line.empty() || line[0] == '#') continue;
+
+            std::istringstream fields(line);
+            uint64_t lineage;
+            int rank;
+            if(fields >> std::hex >> lineage >> std::dec >> rank) {
+                _ranks[lineage] = rank;
+            }
+        }
+
+        return true;
+    }
+
+    // The rank for an actor of a given lineage, out of rank_count,
+    // or -1 if the placement doesn't place it.
+    int rank_for(uint64_t lineage, int rank_count) const {
+        std::map<uint64_t, int>::const_iterator it = _ranks.find(lineage);
+        if(it == _ranks.end()) return -1;
+
+        return it->second % rank_count;
+    }
+
+    // The number of lineages placed.
+    size_t size(void) const {
+        return _ranks.size();
+    }
+
+
+    /**
+     * Partition the vertices of a weighted graph into part_count parts
+     * of about the same size, keeping heavily weighted edges within
+     * parts. fixed gives the part of each vertex which must stay put,
+     * or -1.
+     *
+     * Edges are taken heaviest first, and the clusters at either end
+     * merged while they fit in a part and don't hold vertices fixed to
+     * different parts. Each cluster, largest first, then goes to the
+     * part it has the heaviest edges to, among those with room, or the
+     * emptiest part if it has no edges to any. Finally, single vertices
+     * are moved to any part with room they have heavier edges to.
+     */
+    struct Edge {
+        int from;
+        int to;
+        double weight;
+
+        bool operator<(Edge const& other) const {
+            return weight > other.weight;
+        }
+    };
+
+    static std::vector<int> partition(
+        int vertex_count, std::vector<Edge> edges,
+        std::vector<int> const& fixed, int part_count
+    ) {
+        // Let parts grow a little past an even share
+        int capacity = (vertex_count + part_count - 1)/part_count;
+        capacity += capacity/20 + 1;
+
+        // Merge clusters along the heaviest edges first
+        std::vector<int> cluster(vertex_count);
+        std::vector<int> cluster_size(vertex_count, 1);
+        std::vector<int> cluster_part(fixed);
+        for(int v=0; v<vertex_count; v++) cluster[v] = v;
+
+        std::sort(edges.begin(), edges.end());
+        for(size_t i=0; i<edges.size(); i++) {
+            int a = find(cluster, edges[i].from);
+            int b = find(cluster, edges[i].to);
+            if(a == b) continue;
+            if(cluster_size[a] + cluster_size[b] > capacity) continue;
+            if(
+                cluster_part[a] >= 0 && cluster_part[b] >= 0
+                && cluster_part[a] != cluster_part[b]
+            ) {
+                continue;
+            }
+
+            cluster[b] = a;
+            cluster_size[a] += cluster_size[b];
+            if(cluster_part[a] < 0) cluster_part[a] = cluster_part[b];
+        }
+
+        // Put fixed clusters in their parts
+        std::vector<int> part(vertex_count, -1);
+        std::vector<int> part_size(part_count, 0);
+        std::vector< std::vector<int> > members(vertex_count);
+        for(int v=0; v<vertex_count; v++) {
+            members[find(cluster, v)].push_back(v);
+        }
+
+        std::vector<int> free_clusters;
+        for(int c=0; c<vertex_count; c++) {
+            if(members[c].empty()) continue;
+
+            if(cluster_part[c] >= 0) {
+                assign(members[c], cluster_part[c] % part_count, &part, &part_size);
+            } else {
+                free_clusters.push_back(c);
+            }
+        }
+
+        // Then the rest, largest first
+        std::vector< std::vector<std::pair<int, double> > > adjacent =
+            adjacency(vertex_count, edges);
+
+        for(size_t i=0; i<free_clusters.size(); i++) {
+            for(size_t j=i+1; j<free_clusters.size(); j++) {
+                if(
+                    members[free_clusters[j]].size()
+                    > members[free_clusters[i]].size()
+                ) {
+                    std::swap(free_clusters[i], free_clusters[j]);
+                }
+            }
+        }
+
+        for(size_t i=0; i<free_clusters.size(); i++) {
+            std::vector<int> const& cluster_members = members[free_clusters[i]];
+
+            std::vector<double> pull(part_count, 0.0);
+            for(size_t m=0; m<cluster_members.size(); m++) {
+                add_pull(adjacent[cluster_members[m]], part, &pull);
+            }
+
+            int best = -1;
+            for(int p=0; p<part_count; p++) {
+                if(part_size[p] + static_cast<int>(cluster_members.size()) > capacity) {
+                    continue;
+                }
+                if(
+                    best < 0 || pull[p] > pull[best]
+                    || (pull[p] == pull[best] && part_size[p] < part_size[best])
+                ) {
+                    best = p;
+                }
+            }
+
+            if(best >= 0) {
+                assign(cluster_members, best, &part, &part_size);
+            } else {
+                // No part has room for the whole cluster, so spread it
+                for(size_t m=0; m<cluster_members.size(); m++) {
+                    int emptiest = 0;
+                    for(int p=1; p<part_count; p++) {
+                        if(part_size[p] < part_size[emptiest]) emptiest = p;
+                    }
+                    assign(
+                        std::vector<int>(1, cluster_members[m]), emptiest,
+                        &part, &part_size
+                    );
+                }
+            }
+        }
+
+        // Move single vertices to parts they're more strongly tied to
+        for(int v=0; v<vertex_count; v++) {
+            if(fixed[v] >= 0) continue;
+
+            std::vector<double> pull(part_count, 0.0);
+            add_pull(adjacent[v], part, &pull);
+
+            int best = part[v];
+            for(int p=0; p<part_count; p++) {
+                if(p != part[v] && part_size[p] < capacity && pull[p] > pull[best]) {
+                    best = p;
+                }
+            }
+
+            if(best != part[v]) {
+                part_size[part[v]]--;
+                part_size[best]++;
+                part[v] = best;
+            }
+        }
+
+        return part;
+    }
+
+
+private:
+
+    struct ActorRecord {
+        uint64_t lineage;
+        int rank;
+        bool is_fixed;
+        std::string type;
+    };
+
+    struct Traffic {
+        Traffic(): messages(0), bytes(0) {}
+
+        long messages;
+        long bytes;
+    };
+
+    // A message costs about this many bytes on top of its data.
+    enum { MESSAGE_OVERHEAD = 64 };
+
+    // The SplitMix64 finalizer
+    static uint64_t mix(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+
+    /*
+     * Gathering records on the root
+     */
+
+    std::vector<char> pack(void) const {
+        std::vector<char> bytes;
+
+        append<int>(&bytes, _actors.size());
+        for(
+            std::map<int, ActorRecord>::const_iterator it = _actors.begin();
+            it != _actors.end(); ++it
+        ) {
+            append<int>(&bytes, it->first);
+            append<uint64_t>(&bytes, it->second.lineage);
+            append<int>(&bytes, it->second.rank);
+            append<int>(&bytes, it->second.is_fixed);
+            append<int>(&bytes, it->second.type.size());
+            bytes.insert(
+                bytes.end(), it->second.type.begin(), it->second.type.end()
+            );
+        }
+
+        append<int>(&bytes, _traffic.size());
+        for(
+            std::map<std::pair<int, int>, Traffic>::const_iterator it =
+                _traffic.begin();
+            it != _traffic.end(); ++it
+        ) {
+            append<int>(&bytes, it->first.first);
+            append<int>(&bytes, it->first.second);
+            append<long>(&bytes, it->second.messages);
+            append<long>(&bytes, it->second.bytes);
+        }
+
+        return bytes;
+    }
+
+    // Unpack the records of every process, one after another.
+    static void unpack(
+        std::vector<char> const& bytes,
+        std::map<int, ActorRecord> *actors,
+        std::map<std::pair<int, int>, Traffic> *traffic
+    ) {
+        size_t offset = 0;
+        while(offset < bytes.size()) {
+            int actor_count = take<int>(bytes, &offset);
+            for(int i=0; i<actor_count; i++) {
+                int gid = take<int>(bytes, &offset);
+
+                ActorRecord& actor = (*actors)[gid];
+                actor.lineage = take<uint64_t>(bytes, &offset);
+                actor.rank = take<int>(bytes, &offset);
+                actor.is_fixed = take<int>(bytes, &offset);
+
+                int type_size = take<int>(bytes, &offset);
+                actor.type.assign(&bytes[offset], type_size);
+                offset += type_size;
+            }
+
+            int edge_count = take<int>(bytes, &offset);
+            for(int i=0; i<edge_count; i++) {
+                int sender = take<int>(bytes, &offset);
+                int receiver = take<int>(bytes, &offset);
+
+                Traffic& edge = (*traffic)[std::make_pair(sender, receiver)];
+                edge.messages += take<long>(bytes, &offset);
+                edge.bytes += take<long>(bytes, &offset);
+            }
+        }
+    }
+
+    static void gather(
+        MPI_Comm comm, std::vector<char> const& bytes, std::vector<char> *all
+    ) {
+        int rank;
+        int size;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+
+        int count = bytes.size();
+        std::vector<int> counts(size);
+        MPI_Gather(&count, 1, MPI_INT, &counts[0], 1, MPI_INT, 0, comm);
+
+        std::vector<int> offsets(size);
+        int total = 0;
+        for(int i=0; i<size; i++) {
+            offsets[i] = total;
+            total += counts[i];
+        }
+
+        all->resize(rank == 0 ? total : 0);
+        MPI_Gatherv(
+            const_cast<char*>(bytes.empty() ? NULL : &bytes[0]),
+            count, MPI_BYTE,
+            all->empty() ? NULL : &(*all)[0], &counts[0], &offsets[0],
+            MPI_BYTE, 0, comm
+        );
+    }
+
+
+    /*
+     * Writing the placement file
+     */
+
+    static void write_type_summary(
+        std::ostream& out,
+        std::map<int, ActorRecord> const& actors,
+        std::map<std::pair<int, int>, Traffic> const& traffic
+    ) {
+        std::map<std::pair<std::string, std::string>, Traffic> by_type;
+        for(
+            std::map<std::pair<int, int>, Traffic>::const_iterator it =
+                traffic.begin();
+            it != traffic.end(); ++it
+        ) {
+            std::map<int, ActorRecord>::const_iterator sender =
+                actors.find(it->first.first);
+            std::map<int, ActorRecord>::const_iterator receiver =
+                actors.find(it->first.second);
+            if(sender == actors.end() || receiver == actors.end()) continue;
+
+            Traffic& types =
+                by_type[std::make_pair(sender->second.type, receiver->second.type)];
+            types.messages += it->second.messages;
+            types.bytes += it->second.bytes;
+        }
+
+        out << "# Messages sent between actor types" << std::endl;
+        out << "# sender receiver messages bytes" << std::endl;
+        for(
+            std::map<std::pair<std::string, std::string>, Traffic>::iterator
+                it = by_type.begin();
+            it != by_type.end(); ++it
+        ) {
+            out << "# " << it->first.first << " " << it->first.second
+                << " " << it->second.messages
+                << " " << it->second.bytes << std::endl;
+        }
+    }
+
+    static void write_ranks(
+        std::ostream& out,
+        std::map<int, ActorRecord> const& actors,
+        std::map<std::pair<int, int>, Traffic> const& traffic,
+        int rank_count
+    ) {
+        // Number the actors as vertices
+        std::map<int, int> vertex_of;
+        std::vector<uint64_t> lineages;
+        std::vector<int> fixed;
+        for(
+            std::map<int, ActorRecord>::const_iterator it = actors.begin();
+            it != actors.end(); ++it
+        ) {
+            vertex_of[it->first] = lineages.size();
+            lineages.push_back(it->second.lineage);
+            fixed.push_back(it->second.is_fixed ? it->second.rank : -1);
+        }
+
+        std::vector<Edge> edges;
+        for(
+            std::map<std::pair<int, int>, Traffic>::const_iterator it =
+                traffic.begin();
+            it != traffic.end(); ++it
+        ) {
+            std::map<int, int>::iterator from = vertex_of.find(it->first.first);
+            std::map<int, int>::iterator to = vertex_of.find(it->first.second);
+            if(from == vertex_of.end() || to == vertex_of.end()) continue;
+
+            Edge edge;
+            edge.from = from->second;
+            edge.to = to->second;
+            edge.weight =
+                it->second.bytes + MESSAGE_OVERHEAD*it->second.messages;
+            edges.push_back(edge);
+        }
+
+        std::vector<int> part =
+            partition(lineages.size(), edges, fixed, rank_count);
+
+        out << "# lineage rank" << std::endl;
+        for(size_t v=0; v<lineages.size(); v++) {
+            out << std::hex << lineages[v] << std::dec
+                << " " << part[v] << std::endl;
+        }
+    }
+
+
+    /*
+     * Partitioning helpers
+     */
+
+    // Find the cluster a vertex is in, shortening the path to it.
+    static int find(std::vector<int>& cluster, int v) {
+        while(cluster[v] != v) {
+            cluster[v] = cluster[cluster[v]];
+            v = cluster[v];
+        }
+
+        return v;
+    }
+
+    static void assign(
+        std::vector<int> const& vertices, int p,
+        std::vector<int> *part, std::vector<int> *part_size
+    ) {
+        for(size_t i=0; i<vertices.size(); i++) (*part)[vertices[i]] = p;
+        (*part_size)[p] += vertices.size();
+    }
+
+    // The weighted edges of each vertex, in both directions.
+    static std::vector< std::vector<std::pair<int, double> > > adjacency(
+        int vertex_count, std::vector<Edge> const& edges
+    ) {
+        std::vector< std::vector<std::pair<int, double> > > adjacent(
+            vertex_count
+        );
+        for(size_t i=0; i<edges.size(); i++) {
+            adjacent[edges[i].from].push_back(
+                std::make_pair(edges[i].to, edges[i].weight)
+            );
+            adjacent[edges[i].to].push_back(
+                std::make_pair(edges[i].from, edges[i].weight)
+            );
+        }
+
+        return adjacent;
+    }
+
+    // Add the weight of a vertex's edges to each part they lead to.
+    static void add_pull(
+        std::vector<std::pair<int, double> > const& edges,
+        std::vector<int> const& part, std::vector<double> *pull
+    ) {
+        for(size_t i=0; i<edges.size(); i++) {
+            int p = part[edges[i].first];
+            if(p >= 0) (*pull)[p] += edges[i].second;
+        }
+    }
+
+
+    template<class T>
+    static void append(std::vector<char> *bytes, T value) {
+        char const *begin = reinterpret_cast<char const*>(&value);
+        bytes->insert(bytes->end(), begin, begin + sizeof(T));
+    }
+
+    template<class T>
+    static T take(std::vector<char> const& bytes, size_t *offset) {
+        T value;
+        std::memcpy(&value, &bytes[*offset], sizeof(T));
+        *offset += sizeof(T);
+
+        return value;
+    }
+
+
+    bool _is_profiling;
+
+    // Actors born on this process, and the messages they sent,
+    // by gid.
+    std::map<int, ActorRecord> _actors;
+    std::map<std::pair<int, int>, Traffic> _traffic;
+
+    // The rank for each lineage, once a placement has been read.
+    std::map<uint64_t, int> _ranks;
+};
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_PLACEMENT_H_
@@ -0,0 +1,290 @@
+#ifndef ACTOR_REPLAY_H_
+#define ACTOR_REPLAY_H_
+
+#include <map>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <exception>
+
+#include "./id.h"
+#include "./actor.h"
+
+
+namespace ActorModel {
+
+
+/**
+ * Replay
+ *
+ * The replay class makes the order in which a director hands out births
+ * and messages repeatable between runs.
+ *
+ * Normally, a message is put in an actor's mailbox as soon as it is
+ * received, so the order actors see messages in, and so the order they
+ * run in, depends on the timing of the run. Outside of LIVE mode, every
+ * birth and message taken in during a sync is held instead, and they
+ * are all released together at the end of the sync in a canonical
+ * order: by kind, then by sender, then by the order the sender sent
+ * them in.
+ *
+ * That fixes the order within a sync, but not which sync an input
+ * arrives in. In RECORD mode, the inputs released at each tick are also
+ * written to a log, one file per process. In REPLAY mode, the log is
+ * read back and each tick waits for, and releases, exactly the inputs
+ * it released when recorded, and the director ends on the same tick.
+ * Provided the actors themselves only depend on their inputs, a
+ * replayed run takes the same steps as the recorded one.
+ *
+ * Inputs are named without looking at their contents: the n-th message
+ * of a kind from a sender to a receiver is the same message in both
+ * runs. Gathers and reductions are named by the order they finish in,
+ * which can differ between runs if an actor has several in flight.
+ */
+class Replay {
+public:
+
+    enum Mode {
+        LIVE,           // hand inputs out as they arrive
+        DETERMINISTIC,  // hand inputs out in a canonical order per tick
+        RECORD,         // as DETERMINISTIC, and log the inputs per tick
+        REPLAY          // hand inputs out as logged by a RECORD run
+    };
+
+    // The kinds of input a director takes in, in the order they
+    // are handed out within a tick.
+    enum Kind {
+        BIRTH,
+        DIRECT,
+        GROUP,
+        COLLECTIVE,
+        TIMER,
+        END
+    };
+
+    // Names an input the same way in every run.
+    struct Key {
+        int kind;
+        int sender_rank;
+        int sender_gid;
+        int receiver_gid;
+        long sequence;
+
+        bool operator<(Key const& other) const {
+            if(kind != other.kind) return kind < other.kind;
+            if(sender_rank != other.sender_rank) {
+                return sender_rank < other.sender_rank;
+            }
+            if(sender_gid != other.sender_gid) {
+                return sender_gid < other.sender_gid;
+            }
+            if(receiver_gid != other.receiver_gid) {
+                return receiver_gid < other.receiver_gid;
+            }
+            return sequence < other.sequence;
+        }
+    };
+
+    // A held birth or message. Births carry the newborn actor, and
+    // messages carry the gid they are for and the message itself.
+    struct Input {
+        Key key;
+
+        Actor *actor;
+
+        int gid;
+        Actor::Message message;
+    };
+
+
+    Replay(): _mode(LIVE) {}
+
+    // Set the mode. RECORD and REPLAY use the log file
+    // <prefix>.<rank>.log
+    void set_mode(Mode mode, std::string const& prefix, int rank) {
+        _mode = mode;
+        _held.clear();
+        _sequences.clear();
+        _logged.clear();
+        _ends.clear();
+
+        std::ostringstream path;
+        path << prefix << "." << rank << ".log";
+
+        if(_mode == RECORD) {
+            _log.close();
+            _log.open(path.str().c_str());
+        }
+
+        if(_mode == REPLAY) read_log(path.str());
+    }
+
+    // Exception class to throw when a log to replay can't be read.
+    class LogNotFound: public std::exception {
+        virtual const char* what() const throw() {
+            return "Replay log not found!";
+        }
+    };
+
+    Mode mode(void) const {
+        return _mode;
+    }
+
+    // Check if inputs are being held rather than handed out
+    // as they arrive.
+    bool is_holding(void) const {
+        return _mode != LIVE;
+    }
+
+
+    // Hold a newborn actor until its birth is released.
+    void hold_birth(Actor *actor) {
+        Input input;
+        input.key = next_key(
+            BIRTH, actor->id().rank(), actor->id().gid(), actor->id().gid()
+        );
+        input.actor = actor;
+        input.gid = actor->id().gid();
+
+        _held[input.key] = input;
+    }
+
+    // Hold a message for the actor with the given gid until
+    // it is released.
+    void hold_message(int kind, int gid, Actor::Message const& message) {
+        Input input;
+        input.actor = NULL;
+        input.gid = gid;
+        input.message = message;
+
+        Id sender = input.message.sender();
+        input.key = next_key(kind, sender.rank(), sender.gid(), gid);
+
+        _held[input.key] = input;
+    }
+
+    // Move the inputs to hand out at a tick into released, in the order
+    // to hand them out in. In REPLAY mode, this returns false, and
+    // releases nothing, until every input logged for the tick has
+    // arrived.
+    bool release(long tick, std::vector<Input> *released) {
+        if(_mode == REPLAY) {
+            std::map<long, std::vector<Key> >::iterator logged =
+                _logged.find(tick);
+            if(logged == _logged.end()) return true;
+
+            std::vector<Key> const& keys = logged->second;
+            for(size_t i=0; i<keys.size(); i++) {
+                if(_held.count(keys[i]) == 0) return false;
+            }
+
+            for(size_t i=0; i<keys.size(); i++) {
+                std::map<Key, Input>::iterator input = _held.find(keys[i]);
+
+                released->push_back(input->second);
+                _held.erase(input);
+            }
+
+            _logged.erase(logged);
+
+            return true;
+        }
+
+        for(
+            std::map<Key, Input>::iterator it = _held.begin();
+            it != _held.end(); ++it
+        ) {
+            released->push_back(it->second);
+            if(_mode == RECORD) write_key(tick, it->first);
+        }
+        _held.clear();
+
+        return true;
+    }
+
+    // Decide whether the director ends at a tick. When replaying, the
+    // director ends when the recorded one did, whatever it sees now.
+    bool ended(long tick, bool is_ended) {
+        if(_mode == REPLAY) return _ends.count(tick) != 0;
+
+        if(_mode == RECORD && is_ended) {
+            Key end = {END, 0, 0, 0, 0};
+            write_key(tick, end);
+        }
+
+        return is_ended;
+    }
+
+    // Give back any held newborns, so they can be cleaned up.
+    std::vector<Actor*> take_held_births(void) {
+        std::vector<Actor*> births;
+
+        for(
+            std::map<Key, Input>::iterator it = _held.begin();
+            it != _held.end(); ++it
+        ) {
+            if(it->second.actor != NULL) births.push_back(it->second.actor);
+        }
+        _held.clear();
+
+        return births;
+    }
+
+
+private:
+
+    // Name an input by numbering inputs of the same kind between
+    // the same pair of actors.
+    Key next_key(int kind, int sender_rank, int sender_gid, int receiver_gid) {
+        Key key = {kind, sender_rank, sender_gid, receiver_gid, 0};
+        key.sequence = _sequences[key]++;
+
+        return key;
+    }
+
+    void write_key(long tick, Key const& key) {
+        _log << tick << " " << key.kind << " "
+             << key.sender_rank << " " << key.sender_gid << " "
+             << key.receiver_gid << " " << key.sequence << "\n";
+    }
+
+    void read_log(std::string const& path) {
+        std::ifstream log(path.c_str());
+        if(!log) throw LogNotFound();
+
+        long tick;
+        Key key;
+        while(
+            log >> tick >> key.kind
+                >> key.sender_rank >> key.sender_gid
+                >> key.receiver_gid >> key.sequence
+        ) {
+            if(key.kind == END) _ends.insert(std::make_pair(tick, true));
+            else _logged[tick].push_back(key);
+        }
+    }
+
+    Mode _mode;
+
+    // Inputs taken in but not yet handed out, in canonical order.
+    std::map<Key, Input> _held;
+
+    // The number of inputs named so far for each kind, sender
+    // and receiver.
+    std::map<Key, long> _sequences;
+
+    // RECORD: the log being written.
+    std::ofstream _log;
+
+    // REPLAY: the inputs to release at each tick, and the ticks
+    // the director ended on.
+    std::map<long, std::vector<Key> > _logged;
+    std::map<long, bool> _ends;
+};
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_REPLAY_H_
@@ -0,0 +1,426 @@
+#ifndef ACTOR_SHARED_TRANSPORT_H_
+#define ACTOR_SHARED_TRANSPORT_H_
+
+#include "./backend.h"
+#include <deque>
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <stdint.h>
+
+#include "./compound_message.h"
+
+
+namespace ActorModel {
+
+
+/**
+ * SharedTransport
+ *
+ * The shared transport passes compound messages between processes on
+ * the same node through shared memory, rather than through MPI.
+ *
+ * Every process allocates a segment of an MPI-3 shared window holding
+ * one ring per process on its node. The ring for a sender is only
+ * written by that sender and only read by the owner of the segment, so
+ * no locks are needed, only ordered loads and stores of the ring's
+ * head and tail. Senders also bump a doorbell at the start of the
+ * segment after writing, so checking for messages when none have been
+ * sent costs a single load.
+ *
+ * Messages are written as a series of fragments, so a message of any
+ * size fits through a ring. If a ring is full, the rest of the message,
+ * and any sent after it, wait on the sender until the ring is next
+ * flushed, which happens on every send and receive. Messages between
+ * a pair of processes are received in the order they were sent.
+ *
+ * Messages are received by tag, like MPI, from any source.
+ *
+ * As it requires a collective routine to initialize it, it must be
+ * initialized simultaneously by all processes using it, with the same
+ * ring size set on every process.
+ */
+class SharedTransport {
+public:
+
+    SharedTransport(MPI_Comm comm_in=MPI_COMM_WORLD):
+        _ring_bytes(round_up_power_of_two(ring_bytes())),
+        _doorbell_seen(0), _waiting_messages(0), _sent(0), _received(0)
+    {
+        int size;
+        MPI_Comm_size(comm_in, &size);
+        _node_ranks.assign(size, -1);
+
+        if(ring_bytes() == 0) return;
+
+        int rank;
+        MPI_Comm_rank(comm_in, &rank);
+        MPI_Comm_split_type(
+            comm_in, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &_node_comm
+        );
+
+        MPI_Comm_rank(_node_comm, &_node_rank);
+        MPI_Comm_size(_node_comm, &_node_size);
+
+        // Find which processes of comm_in share the node
+        std::vector<int> node_ranks(_node_size);
+        for(int i=0; i<_node_size; i++) node_ranks[i] = i;
+        _comm_ranks.resize(_node_size);
+
+        MPI_Group group;
+        MPI_Group node_group;
+        MPI_Comm_group(comm_in, &group);
+        MPI_Comm_group(_node_comm, &node_group);
+        MPI_Group_translate_ranks(
+            node_group, _node_size, &node_ranks[0], group, &_comm_ranks[0]
+        );
+        MPI_Group_free(&group);
+        MPI_Group_free(&node_group);
+
+        for(int i=0; i<_node_size; i++) _node_ranks[_comm_ranks[i]] = i;
+
+        // Allocate and clear this process's rings
+        MPI_Aint segment_bytes = LINE + _node_size*ring_stride();
+
+        char *segment;
+        MPI_Win_allocate_shared(
+            segment_bytes, 1, MPI_INFO_NULL, _node_comm, &segment, &_window
+        );
+        MPI_Win_lock_all(MPI_MODE_NOCHECK, _window);
+
+        std::memset(segment, 0, segment_bytes);
+
+        _segments.resize(_node_size);
+        for(int i=0; i<_node_size; i++) {
+            MPI_Aint bytes;
+            int displacement_unit;
+            MPI_Win_shared_query(
+                _window, i, &bytes, &displacement_unit, &_segments[i]
+            );
+        }
+
+        MPI_Win_sync(_window);
+        MPI_Barrier(_node_comm);
+        MPI_Win_sync(_window);
+
+        _partials.resize(_node_size);
+        _waiting.resize(_node_size);
+        _waiting_offsets.assign(_node_size, 0);
+    }
+
+    ~SharedTransport() {
+        if(!is_enabled()) return;
+
+        MPI_Win_unlock_all(_window);
+        MPI_Win_free(&_window);
+        MPI_Comm_free(&_node_comm);
+    }
+
+
+    // The size in bytes of each ring, for transports made from now on.
+    // It is rounded up to a power of two. A size of 0 turns the
+    // transport off, so all messages go through MPI.
+    static size_t& ring_bytes(void) {
+        static ACTOR_RANK_LOCAL size_t bytes = 16384;
+        return bytes;
+    }
+
+    bool is_enabled(void) const {
+        return _ring_bytes != 0;
+    }
+
+    // Check if messages to a rank go through shared memory.
+    bool is_local(int rank) const {
+        return is_enabled() && _node_ranks[rank] >= 0;
+    }
+
+
+    // Send a compound message to a rank on this node.
+    void send(
+        int rank, int tag,
+        void const *metadata, size_t metadata_bytes,
+        void const *data, size_t data_bytes
+    ) {
+        int node_rank = _node_ranks[rank];
+
+        _waiting[node_rank].push_back(std::vector<char>());
+        std::vector<char>& bytes = _waiting[node_rank].back();
+
+        int header[2] = {tag, static_cast<int>(metadata_bytes)};
+        bytes.resize(sizeof(header) + metadata_bytes + data_bytes);
+
+        std::memcpy(&bytes[0], header, sizeof(header));
+        if(metadata_bytes > 0) {
+            std::memcpy(&bytes[sizeof(header)], metadata, metadata_bytes);
+        }
+        if(data_bytes > 0) {
+            std::memcpy(
+                &bytes[sizeof(header) + metadata_bytes], data, data_bytes
+            );
+        }
+
+        _waiting_messages++;
+        _sent++;
+
+        flush(node_rank);
+    }
+
+    // Receive a compound message with the given tag, or any tag if
+    // tag is MPI_ANY_TAG, if one is waiting.
+    bool receive(int tag, CompoundMessage *message) {
+        if(!is_enabled()) return false;
+
+        poll();
+
+        for(
+            std::deque<CompoundMessage>::iterator it = _received_messages.begin();
+            it != _received_messages.end(); ++it
+        ) {
+            if(tag == MPI_ANY_TAG || it->tag() == tag) {
+                *message = *it;
+                _received_messages.erase(it);
+                _received++;
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Check if every message sent has been written into its ring.
+    bool is_flushed(void) const {
+        return _waiting_messages == 0;
+    }
+
+    // The number of messages sent by this process, less the number
+    // received. Summed over every process, this is the number of
+    // messages still in flight.
+    long in_flight(void) const {
+        return _sent - _received;
+    }
+
+
+private:
+
+    // Fragments are laid out as a header followed by the fragment's
+    // bytes, padded to a multiple of 8 bytes.
+    struct Fragment {
+        uint32_t bytes;
+        uint32_t is_last;
+    };
+
+    // Ring heads, tails and doorbells sit on their own cache lines
+    enum { LINE = 64 };
+
+    size_t ring_stride(void) const {
+        return 2*LINE + _ring_bytes;
+    }
+
+    static size_t round_up_power_of_two(size_t bytes) {
+        if(bytes == 0) return 0;
+
+        size_t rounded = LINE;
+        while(rounded < bytes) rounded *= 2;
+
+        return rounded;
+    }
+
+    static size_t padded(size_t bytes) {
+        return (bytes + 7) & ~static_cast<size_t>(7);
+    }
+
+
+    // The doorbell at the start of a process's segment, and the ring
+    // in it written by a sender.
+    uint64_t* doorbell(int node_rank) {
+        return reinterpret_cast<uint64_t*>(_segments[node_rank]);
+    }
+
+    char* ring(int receiver, int sender) {
+        return _segments[receiver] + LINE + sender*ring_stride();
+    }
+
+    static uint64_t* head(char *ring) {
+        return reinterpret_cast<uint64_t*>(ring);
+    }
+
+    static uint64_t* tail(char *ring) {
+        return reinterpret_cast<uint64_t*>(ring + LINE);
+    }
+
+    // Copy bytes into or out of a ring at a position, wrapping around
+    // the end of the ring.
+    void copy_in(char *ring, uint64_t position, void const *bytes, size_t count) {
+        char *data = ring + 2*LINE;
+        size_t offset = position & (_ring_bytes-1);
+        size_t first = std::min(count, _ring_bytes - offset);
+
+        std::memcpy(data + offset, bytes, first);
+        std::memcpy(data, static_cast<char const*>(bytes) + first, count - first);
+    }
+
+    void copy_out(char *ring, uint64_t position, void *bytes, size_t count) {
+        char *data = ring + 2*LINE;
+        size_t offset = position & (_ring_bytes-1);
+        size_t first = std::min(count, _ring_bytes - offset);
+
+        std::memcpy(bytes, data + offset, first);
+        std::memcpy(static_cast<char*>(bytes) + first, data, count - first);
+    }
+
+
+    // Write as much of the messages waiting for a process into its
+    // ring as there is room for.
+    void flush(int node_rank) {
+        std::deque< std::vector<char> >& waiting = _waiting[node_rank];
+        size_t& offset = _waiting_offsets[node_rank];
+
+        char *to = ring(node_rank, _node_rank);
+        uint64_t position = *tail(to);
+        bool has_written = false;
+
+        while(!waiting.empty()) {
+            std::vector<char>& bytes = waiting.front();
+
+            uint64_t consumed = __atomic_load_n(head(to), __ATOMIC_ACQUIRE);
+            size_t space = _ring_bytes - (position - consumed);
+            if(space < sizeof(Fragment) + 8) break;
+
+            size_t remaining = bytes.size() - offset;
+            size_t fragment_bytes = std::min(
+                remaining, (space - sizeof(Fragment)) & ~static_cast<size_t>(7)
+            );
+
+            Fragment fragment;
+            fragment.bytes = fragment_bytes;
+            fragment.is_last = (fragment_bytes == remaining);
+
+            copy_in(to, position, &fragment, sizeof(Fragment));
+            copy_in(
+                to, position + sizeof(Fragment), &bytes[offset], fragment_bytes
+            );
+
+            position += sizeof(Fragment) + padded(fragment_bytes);
+            __atomic_store_n(tail(to), position, __ATOMIC_RELEASE);
+            has_written = true;
+
+            offset += fragment_bytes;
+            if(fragment.is_last) {
+                waiting.pop_front();
+                offset = 0;
+                _waiting_messages--;
+            }
+        }
+
+        if(has_written) {
+            __atomic_fetch_add(doorbell(node_rank), 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    // Flush any messages waiting to be sent, and read any fragments
+    // written to this process's rings.
+    void poll(void) {
+        if(_waiting_messages > 0) {
+            for(int i=0; i<_node_size; i++) {
+                if(!_waiting[i].empty()) flush(i);
+            }
+        }
+
+        uint64_t rung = __atomic_load_n(doorbell(_node_rank), __ATOMIC_ACQUIRE);
+        if(rung == _doorbell_seen) return;
+        _doorbell_seen = rung;
+
+        for(int i=0; i<_node_size; i++) read_ring(i);
+    }
+
+    // Read every fragment in the ring written by a sender.
+    void read_ring(int sender) {
+        char *from = ring(_node_rank, sender);
+
+        uint64_t position = *head(from);
+        uint64_t written = __atomic_load_n(tail(from), __ATOMIC_ACQUIRE);
+
+        while(position != written) {
+            Fragment fragment;
+            copy_out(from, position, &fragment, sizeof(Fragment));
+
+            std::vector<char>& partial = _partials[sender];
+            size_t offset = partial.size();
+            partial.resize(offset + fragment.bytes);
+            copy_out(
+                from, position + sizeof(Fragment),
+                &partial[offset], fragment.bytes
+            );
+
+            position += sizeof(Fragment) + padded(fragment.bytes);
+            __atomic_store_n(head(from), position, __ATOMIC_RELEASE);
+
+            if(fragment.is_last) {
+                finish_message(sender);
+            }
+        }
+    }
+
+    // Turn the bytes of a fully received message into a
+    // compound message.
+    void finish_message(int sender) {
+        std::vector<char>& bytes = _partials[sender];
+
+        int header[2];
+        std::memcpy(header, &bytes[0], sizeof(header));
+
+        size_t metadata_bytes = header[1];
+        size_t data_bytes = bytes.size() - sizeof(header) - metadata_bytes;
+
+        _received_messages.push_back(CompoundMessage());
+        _received_messages.back().store_message(
+            _comm_ranks[sender], header[0],
+            &bytes[sizeof(header) + metadata_bytes], data_bytes,
+            &bytes[sizeof(header)], metadata_bytes
+        );
+
+        bytes.clear();
+    }
+
+
+    size_t _ring_bytes;
+
+    MPI_Comm _node_comm;
+    MPI_Win _window;
+
+    int _node_rank;
+    int _node_size;
+
+    // The node rank of every rank in the communicator, or -1 for
+    // those on other nodes, and the rank of every node rank.
+    std::vector<int> _node_ranks;
+    std::vector<int> _comm_ranks;
+
+    // The start of every process's segment, as mapped on this process.
+    std::vector<char*> _segments;
+
+    uint64_t _doorbell_seen;
+
+    // Messages waiting for room in the ring of each process, and how
+    // much of the first of them has been written.
+    std::vector< std::deque< std::vector<char> > > _waiting;
+    std::vector<size_t> _waiting_offsets;
+    long _waiting_messages;
+
+    // Fragments of a message read so far from each sender.
+    std::vector< std::vector<char> > _partials;
+
+    // Messages read from the rings but not yet received.
+    std::deque<CompoundMessage> _received_messages;
+
+    long _sent;
+    long _received;
+};
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_SHARED_TRANSPORT_H_
@@ -0,0 +1,445 @@
+#ifndef ACTOR_STATISTICS_H_
+#define ACTOR_STATISTICS_H_
+
+#include "./backend.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include "./histogram.h"
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+
+namespace ActorModel {
+
+
+/**
+ * ActorCounters
+ *
+ * Counters kept by every actor, and summed over all actors of a type.
+ */
+struct ActorCounters {
+    ActorCounters():
+        messages_sent(0), bytes_sent(0),
+        messages_received(0), bytes_received(0),
+        empty_polls(0),
+        runs(0), run_time(0.0),
+        births(0), deaths(0)
+    {}
+
+    // Add another set of counters to this one.
+    void add(ActorCounters const& other) {
+        messages_sent     += other.messages_sent;
+        bytes_sent        += other.bytes_sent;
+        messages_received += other.messages_received;
+        bytes_received    += other.bytes_received;
+        empty_polls       += other.empty_polls;
+        runs              += other.runs;
+        run_time          += other.run_time;
+        births            += other.births;
+        deaths            += other.deaths;
+    }
+
+    long messages_sent;
+    long bytes_sent;
+    long messages_received;
+    long bytes_received;
+
+    // The number of times get_message was called with nothing waiting.
+    long empty_polls;
+
+    // The number of times main was run, and the seconds spent in it.
+    long runs;
+    double run_time;
+
+    long births;
+    long deaths;
+};
+
+
+/**
+ * RankCounters
+ *
+ * Counters kept by the Director on each rank.
+ */
+struct RankCounters {
+    RankCounters():
+        ticks(0), idle_ticks(0),
+        sync_probes(0), barriers(0), dead_letters(0),
+        run_time(0.0), sync_time(0.0), barrier_time(0.0)
+    {}
+
+    // The number of ticks run, and those with no actor to run.
+    long ticks;
+    long idle_ticks;
+
+    // The number of MPI probes made while syncing directors.
+    long sync_probes;
+
+    // The number of barriers entered while syncing directors.
+    long barriers;
+
+    // The number of messages dropped because the actor they were
+    // sent to had died.
+    long dead_letters;
+
+    // Seconds spent running actors, syncing directors in total,
+    // and in barriers and reductions while syncing.
+    double run_time;
+    double sync_time;
+    double barrier_time;
+
+    // Bytes of direct messages sent by actors on this rank to
+    // each rank.
+    std::vector<long> bytes_sent_to;
+};
+
+
+/**
+ * Latency
+ *
+ * Histograms of how long messages took to be taken by actors, once
+ * message timing is on (see Director::set_message_timing).
+ *
+ * Delivery is the time from a message being sent to get_message
+ * returning it, and queueing the time from it arriving on the
+ * receiver's process to being taken. The difference is spent in
+ * transit: in MPI, the Bsend buffer, shared memory or an exchange.
+ * Queueing is spent waiting for the Director to run the receiver.
+ */
+struct Latency {
+    void add(Latency const& other) {
+        delivery.add(other.delivery);
+        queueing.add(other.queueing);
+    }
+
+    Histogram delivery;
+    Histogram queueing;
+};
+
+
+/**
+ * Statistics
+ *
+ * The statistics class holds the counters for each actor type
+ * and for the rank as a whole, and the latencies of the messages
+ * each actor type takes with each tag.
+ *
+ * Actor types are keyed by their (mangled) type name, so the same
+ * type is matched up across ranks when a summary is made.
+ */
+class Statistics {
+public:
+
+    typedef std::map<std::string, ActorCounters> TypeCounters;
+    typedef std::map<std::pair<std::string, int>, Latency> TypeLatencies;
+
+
+    // Get the counters for an actor type by its mangled name.
+    ActorCounters& type(std::string const& type_name) {
+        return _types[type_name];
+    }
+
+    // Get the counters for all actor types.
+    TypeCounters const& types(void) const {
+        return _types;
+    }
+
+    // Get the latencies of messages with a tag taken by an actor type,
+    // by its mangled name.
+    Latency& latency(std::string const& type_name, int tag) {
+        return _latencies[std::make_pair(type_name, tag)];
+    }
+
+    // Get the latencies for every actor type and tag.
+    TypeLatencies const& latencies(void) const {
+        return _latencies;
+    }
+
+    // Get the counters for the rank.
+    RankCounters& rank(void) {
+        return _rank;
+    }
+
+    RankCounters const& rank(void) const {
+        return _rank;
+    }
+
+    // Get the readable name of a type from its mangled name.
+    static std::string demangle(std::string const& type_name) {
+#ifdef __GNUG__
+        int status = 0;
+        char *name = abi::__cxa_demangle(type_name.c_str(), NULL, NULL, &status);
+
+        if(status == 0 && name != NULL) {
+            std::string demangled(name);
+            std::free(name);
+
+            return demangled;
+        }
+#endif
+        return type_name;
+    }
+
+
+    // Print a summary of the statistics of every rank.
+    // This is a collective routine. All processes must call it at the
+    // same time, and the summary is printed by rank 0.
+    void print_summary(MPI_Comm comm, std::ostream& out) const {
+        int comm_rank;
+        int comm_size;
+        MPI_Comm_rank(comm, &comm_rank);
+        MPI_Comm_size(comm, &comm_size);
+
+        // Sum and max of the rank counters
+        double rank_values[RANK_VALUE_COUNT];
+        pack_rank(rank_values);
+
+        double rank_sums[RANK_VALUE_COUNT];
+        double rank_maxes[RANK_VALUE_COUNT];
+        MPI_Reduce(
+            rank_values, rank_sums, RANK_VALUE_COUNT, MPI_DOUBLE,
+            MPI_SUM, 0, comm
+        );
+        MPI_Reduce(
+            rank_values, rank_maxes, RANK_VALUE_COUNT, MPI_DOUBLE,
+            MPI_MAX, 0, comm
+        );
+
+        // Gather the type counters to rank 0 and sum them by type
+        TypeCounters types = gather_types(comm);
+        TypeLatencies latencies = gather_latencies(comm);
+
+        if(comm_rank != 0) return;
+
+        char const *rank_names[RANK_VALUE_COUNT] = {
+            "ticks", "idle ticks", "sync probes", "barriers", "dead letters",
+            "run time (s)", "sync time (s)", "barrier time (s)"
+        };
+
+        out << "STATISTICS: " << comm_size << " ranks" << std::endl;
+        out << std::left << std::setw(20) << "rank counter"
+            << std::right << std::setw(16) << "total"
+            << std::setw(16) << "max rank" << std::endl;
+        for(int i=0; i<RANK_VALUE_COUNT; i++) {
+            out << std::left << std::setw(20) << rank_names[i]
+                << std::right << std::setw(16) << rank_sums[i]
+                << std::setw(16) << rank_maxes[i] << std::endl;
+        }
+
+        out << std::left << std::setw(24) << "actor type"
+            << std::right
+            << std::setw(8) << "births" << std::setw(8) << "deaths"
+            << std::setw(12) << "runs" << std::setw(12) << "run time"
+            << std::setw(12) << "empty polls"
+            << std::setw(12) << "msgs sent" << std::setw(14) << "bytes sent"
+            << std::setw(12) << "msgs recv" << std::setw(14) << "bytes recv"
+            << std::endl;
+
+        for(
+            TypeCounters::const_iterator it = types.begin();
+            it != types.end(); ++it
+        ) {
+            ActorCounters const& c = it->second;
+
+            out << std::left << std::setw(24) << demangle(it->first)
+                << std::right
+                << std::setw(8) << c.births << std::setw(8) << c.deaths
+                << std::setw(12) << c.runs << std::setw(12) << c.run_time
+                << std::setw(12) << c.empty_polls
+                << std::setw(12) << c.messages_sent
+                << std::setw(14) << c.bytes_sent
+                << std::setw(12) << c.messages_received
+                << std::setw(14) << c.bytes_received
+                << std::endl;
+        }
+
+        if(latencies.empty()) return;
+
+        out << std::left << std::setw(24) << "latency (us)"
+            << std::right << std::setw(6) << "tag" << std::setw(10) << "messages"
+            << std::setw(10) << "p50" << std::setw(10) << "p99"
+            << std::setw(10) << "p99.9" << std::setw(10) << "max"
+            << std::setw(12) << "queued p50" << std::setw(12) << "queued p99"
+            << std::endl;
+
+        for(
+            TypeLatencies::const_iterator it = latencies.begin();
+            it != latencies.end(); ++it
+        ) {
+            Histogram const& delivery = it->second.delivery;
+            Histogram const& queueing = it->second.queueing;
+
+            out << std::left << std::setw(24) << demangle(it->first.first)
+                << std::right << std::setw(6) << it->first.second
+                << std::setw(10) << delivery.count()
+                << std::setw(10) << delivery.percentile(50)*1e6
+                << std::setw(10) << delivery.percentile(99)*1e6
+                << std::setw(10) << delivery.percentile(99.9)*1e6
+                << std::setw(10) << delivery.max()*1e6
+                << std::setw(12) << queueing.percentile(50)*1e6
+                << std::setw(12) << queueing.percentile(99)*1e6
+                << std::endl;
+        }
+    }
+
+    // Sum the latencies of every rank on rank 0. Other ranks get
+    // nothing back.
+    // This is a collective routine.
+    TypeLatencies gather_latencies(MPI_Comm comm) const {
+        std::vector<char> buffer;
+        for(
+            TypeLatencies::const_iterator it = _latencies.begin();
+            it != _latencies.end(); ++it
+        ) {
+            int name_size = it->first.first.size();
+
+            append(buffer, &name_size, sizeof(int));
+            append(buffer, it->first.first.data(), name_size);
+            append(buffer, &it->first.second, sizeof(int));
+            it->second.delivery.pack(buffer);
+            it->second.queueing.pack(buffer);
+        }
+
+        std::vector<char> all_buffers;
+        if(!gather_buffers(comm, buffer, &all_buffers)) return TypeLatencies();
+
+        TypeLatencies latencies;
+        size_t offset = 0;
+        while(offset < all_buffers.size()) {
+            int name_size;
+            std::memcpy(&name_size, &all_buffers[offset], sizeof(int));
+            offset += sizeof(int);
+
+            std::string name(&all_buffers[offset], name_size);
+            offset += name_size;
+
+            int tag;
+            std::memcpy(&tag, &all_buffers[offset], sizeof(int));
+            offset += sizeof(int);
+
+            Latency latency;
+            latency.delivery = Histogram::unpack(all_buffers, &offset);
+            latency.queueing = Histogram::unpack(all_buffers, &offset);
+
+            latencies[std::make_pair(name, tag)].add(latency);
+        }
+
+        return latencies;
+    }
+
+
+private:
+
+    enum { RANK_VALUE_COUNT = 8 };
+
+    void pack_rank(double values[RANK_VALUE_COUNT]) const {
+        values[0] = _rank.ticks;
+        values[1] = _rank.idle_ticks;
+        values[2] = _rank.sync_probes;
+        values[3] = _rank.barriers;
+        values[4] = _rank.dead_letters;
+        values[5] = _rank.run_time;
+        values[6] = _rank.sync_time;
+        values[7] = _rank.barrier_time;
+    }
+
+
+    /*
+     * Type counters are sent as a list of records:
+     *  name length (int), name chars, counters (ActorCounters)
+     */
+    TypeCounters gather_types(MPI_Comm comm) const {
+        std::vector<char> buffer;
+        for(
+            TypeCounters::const_iterator it = _types.begin();
+            it != _types.end(); ++it
+        ) {
+            int name_size = it->first.size();
+
+            append(buffer, &name_size, sizeof(int));
+            append(buffer, it->first.data(), name_size);
+            append(buffer, &it->second, sizeof(ActorCounters));
+        }
+
+        std::vector<char> all_buffers;
+        if(!gather_buffers(comm, buffer, &all_buffers)) return TypeCounters();
+
+        TypeCounters types;
+        size_t offset = 0;
+        while(offset < all_buffers.size()) {
+            int name_size;
+            std::memcpy(&name_size, &all_buffers[offset], sizeof(int));
+            offset += sizeof(int);
+
+            std::string name(&all_buffers[offset], name_size);
+            offset += name_size;
+
+            ActorCounters counters;
+            std::memcpy(&counters, &all_buffers[offset], sizeof(ActorCounters));
+            offset += sizeof(ActorCounters);
+
+            types[name].add(counters);
+        }
+
+        return types;
+    }
+
+    // Gather every rank's buffer, one after another, on rank 0.
+    // Returns true on rank 0.
+    static bool gather_buffers(
+        MPI_Comm comm, std::vector<char> buffer, std::vector<char> *all
+    ) {
+        int comm_rank;
+        int comm_size;
+        MPI_Comm_rank(comm, &comm_rank);
+        MPI_Comm_size(comm, &comm_size);
+
+        int buffer_size = buffer.size();
+        std::vector<int> sizes(comm_size);
+        MPI_Gather(&buffer_size, 1, MPI_INT, &sizes[0], 1, MPI_INT, 0, comm);
+
+        std::vector<int> offsets(comm_size, 0);
+        int total_size = 0;
+        for(int i=0; i<comm_size; i++) {
+            offsets[i] = total_size;
+            total_size += sizes[i];
+        }
+
+        // Keep buffers non-empty so &buffer[0] is valid
+        all->resize(total_size + 1);
+        buffer.push_back(0);
+
+        MPI_Gatherv(
+            &buffer[0], buffer_size, MPI_BYTE,
+            &(*all)[0], &sizes[0], &offsets[0], MPI_BYTE,
+            0, comm
+        );
+        all->resize(total_size);
+
+        return comm_rank == 0;
+    }
+
+    static void append(std::vector<char>& buffer, void const *data, size_t size) {
+        char const *bytes = static_cast<char const*>(data);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    }
+
+
+    TypeCounters _types;
+    TypeLatencies _latencies;
+    RankCounters _rank;
+};
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_STATISTICS_H_
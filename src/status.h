@@ -1,6 +1,8 @@
 #ifndef STATUS_H_
 #define STATUS_H_
 
+#include "./backend.h"
+
 namespace ActorModel {
 
 
@@ -16,8 +18,25 @@ public:
         _msg_state(0), _mpi_status()
     {}
 
-    Status(int source, int tag, MPI_Comm comm) {
-        MPI_Iprobe(source, tag, comm, &_msg_state, &_mpi_status);
+    // Check for a message. If wait is set, block until one arrives.
+    Status(int source, int tag, MPI_Comm comm, bool wait=false) {
+        probe_count()++;
+
+        if(wait) {
+            MPI_Probe(source, tag, comm, &_mpi_status);
+            _msg_state = MSG_WAITING;
+        } else {
+            MPI_Iprobe(source, tag, comm, &_msg_state, &_mpi_status);
+        }
+    }
+
+    // Status of a message that was delivered locally, without
+    // passing through the MPI pipeline.
+    Status(int source, int tag):
+        _mpi_status(), _msg_state(MSG_WAITING)
+    {
+        _mpi_status.MPI_SOURCE = source;
+        _mpi_status.MPI_TAG    = tag;
     }
 
 
@@ -51,6 +70,13 @@ public:
     }
 
 
+    // The number of probes made on this process so far.
+    static long& probe_count(void) {
+        static ACTOR_RANK_LOCAL long count = 0;
+        return count;
+    }
+
+
     // Message waiting status values
     enum {
         MSG_WAITING = 1,
@@ -0,0 +1,1313 @@
+#ifndef ACTOR_THREAD_MPI_H_
+#define ACTOR_THREAD_MPI_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+/**
+ * ThreadMPI
+ *
+ * ThreadMPI provides the parts of MPI used by ActorModel for ranks
+ * which are threads of a single process, so single node runs need no
+ * MPI library, mpiexec or MPI start up. It is used in place of MPI
+ * when building with -DACTOR_THREADS (see backend.h).
+ *
+ * Every rank of a communicator has a mailbox. Senders push messages
+ * onto a lock-free stack in the mailbox, and the rank owning it moves
+ * them, in the order they were sent, onto a list only it reads, where
+ * they are matched by source and tag. Collectives are built on every
+ * rank sharing a contribution, with a barrier either side.
+ *
+ * Shared windows are plain memory, since every rank shares the
+ * process's memory, and files are read and written with pread and
+ * pwrite.
+ *
+ * Only what ActorModel uses is provided, and only for the datatypes
+ * and operations it uses.
+ *
+ * The MPI names are declared in ThreadMPI::Interface rather than
+ * globally, and brought into use by backend.h, so including this
+ * alongside a real <mpi.h> doesn't redefine anything. The handles
+ * MPI defines as macros are constants here for the same reason.
+ */
+namespace ActorModel {
+namespace ThreadMPI {
+
+
+// A message in a mailbox
+struct Envelope {
+    int source;
+    int tag;
+    std::vector<char> data;
+
+    Envelope *next;
+};
+
+// The messages sent to one rank of a communicator
+struct Mailbox {
+    Mailbox(): intake(NULL) {}
+
+    ~Mailbox() {
+        take_in();
+        for(size_t i=0; i<pending.size(); i++) delete pending[i];
+    }
+
+    // Push a message, from any rank
+    void push(Envelope *envelope) {
+        envelope->next = intake.load(std::memory_order_relaxed);
+        while(
+            !intake.compare_exchange_weak(
+                envelope->next, envelope,
+                std::memory_order_release, std::memory_order_relaxed
+            )
+        );
+    }
+
+    // Move pushed messages onto the pending list, oldest first.
+    // Only called by the rank owning the mailbox.
+    void take_in(void) {
+        Envelope *pushed = intake.exchange(NULL, std::memory_order_acquire);
+
+        std::vector<Envelope*> newest_first;
+        for(; pushed != NULL; pushed = pushed->next) {
+            newest_first.push_back(pushed);
+        }
+
+        pending.insert(pending.end(), newest_first.rbegin(), newest_first.rend());
+    }
+
+    // Find the oldest pending message matching a source and tag
+    std::deque<Envelope*>::iterator find(int source, int tag) {
+        take_in();
+
+        std::deque<Envelope*>::iterator it = pending.begin();
+        for(; it != pending.end(); ++it) {
+            if(
+                (source < 0 || (*it)->source == source)
+                && (tag < 0 || (*it)->tag == tag)
+            ) {
+                break;
+            }
+        }
+
+        return it;
+    }
+
+    std::atomic<Envelope*> intake;
+    std::deque<Envelope*> pending;
+};
+
+struct Comm {
+    Comm(std::vector<int> const& world_ranks_in, int world_size):
+        world_ranks(world_ranks_in),
+        ranks(world_size, -1),
+        mailboxes(new Mailbox[world_ranks_in.size()]),
+        slots(world_ranks_in.size()),
+        arrived(0), generation(0),
+        references(world_ranks_in.size()),
+        sources(world_ranks_in.size()),
+        destinations(world_ranks_in.size())
+    {
+        for(size_t i=0; i<world_ranks.size(); i++) ranks[world_ranks[i]] = i;
+    }
+
+    ~Comm() {
+        delete[] mailboxes;
+    }
+
+    int size(void) const {
+        return world_ranks.size();
+    }
+
+    // The world rank of each rank, and the rank of each world rank,
+    // or -1 for those not in the communicator.
+    std::vector<int> world_ranks;
+    std::vector<int> ranks;
+
+    Mailbox *mailboxes;
+
+    // Contributions to the collective in progress
+    std::vector< std::vector<char> > slots;
+    std::mutex mutex;
+    std::condition_variable changed;
+    int arrived;
+    long generation;
+
+    // The number of ranks yet to free the communicator
+    std::atomic<int> references;
+
+    // Each rank's neighbours, for communicators with a graph
+    std::vector< std::vector<int> > sources;
+    std::vector< std::vector<int> > destinations;
+};
+
+struct Group {
+    std::vector<int> world_ranks;
+};
+
+struct Window {
+    Comm *comm;
+    std::vector<char*> segments;
+    std::vector<std::ptrdiff_t> sizes;
+};
+
+struct File {
+    int descriptor;
+    Comm *comm;
+};
+
+// A persistent buffered send. Sends are copied out when started,
+// so a started request is already complete.
+struct Request {
+    void const *data;
+    int count;
+    int datatype;
+    int rank;
+    int tag;
+    Comm *comm;
+};
+
+
+// The communicator of every rank, and the world rank of this thread.
+inline Comm*& world(void) {
+    static Comm *comm = NULL;
+    return comm;
+}
+
+inline int& world_rank(void) {
+    static thread_local int rank = 0;
+    return rank;
+}
+
+inline Comm* self(void) {
+    static thread_local Comm *comm = NULL;
+    if(comm == NULL) {
+        comm = new Comm(std::vector<int>(1, world_rank()), world()->size());
+    }
+
+    return comm;
+}
+
+inline int rank_in(Comm *comm) {
+    return comm->ranks[world_rank()];
+}
+
+
+// Wait for every rank of a communicator
+inline void barrier(Comm *comm) {
+    std::unique_lock<std::mutex> lock(comm->mutex);
+
+    long generation = comm->generation;
+    if(++comm->arrived == comm->size()) {
+        comm->arrived = 0;
+        comm->generation++;
+        comm->changed.notify_all();
+    } else {
+        while(comm->generation == generation) comm->changed.wait(lock);
+    }
+}
+
+// Share bytes from every rank with every rank, in rank order
+inline std::vector< std::vector<char> > share(
+    Comm *comm, void const *bytes, size_t count
+) {
+    char const *begin = static_cast<char const*>(bytes);
+    {
+        std::lock_guard<std::mutex> lock(comm->mutex);
+        comm->slots[rank_in(comm)].assign(begin, begin + count);
+    }
+    barrier(comm);
+
+    std::vector< std::vector<char> > shared;
+    {
+        std::lock_guard<std::mutex> lock(comm->mutex);
+        shared = comm->slots;
+    }
+    barrier(comm);
+
+    return shared;
+}
+
+// Send a block of bytes to each destination, and receive a block from
+// each source, where every rank's destinations and sources agree.
+// Counts and offsets are in bytes.
+inline void exchange_blocks(
+    Comm *comm,
+    std::vector<int> const& destinations, char const *send,
+    int const *send_counts, int const *send_offsets,
+    std::vector<int> const& sources, char *receive,
+    int const *receive_counts, int const *receive_offsets
+) {
+    // Tag each block with its destination
+    std::vector<char> blocks;
+    for(size_t i=0; i<destinations.size(); i++) {
+        int header[2] = {destinations[i], send_counts[i]};
+        char const *header_bytes = reinterpret_cast<char const*>(header);
+
+        blocks.insert(
+            blocks.end(), header_bytes, header_bytes + sizeof(header)
+        );
+        blocks.insert(
+            blocks.end(),
+            send + send_offsets[i], send + send_offsets[i] + send_counts[i]
+        );
+    }
+
+    std::vector< std::vector<char> > shared =
+        share(comm, blocks.empty() ? NULL : &blocks[0], blocks.size());
+
+    int rank = rank_in(comm);
+    for(size_t i=0; i<sources.size(); i++) {
+        std::vector<char> const& from = shared[sources[i]];
+
+        size_t offset = 0;
+        while(offset < from.size()) {
+            int header[2];
+            std::memcpy(header, &from[offset], sizeof(header));
+            offset += sizeof(header);
+
+            if(header[0] == rank) {
+                int count = std::min(header[1], receive_counts[i]);
+                if(count > 0) {
+                    std::memcpy(
+                        receive + receive_offsets[i], &from[offset], count
+                    );
+                }
+                break;
+            }
+
+            offset += header[1];
+        }
+    }
+}
+
+
+// Datatypes and reduction operations
+enum Datatype { BYTE = 1, CHAR, INT, LONG, LONG_LONG, FLOAT, DOUBLE };
+enum Op { SUM = 1, MAX, MIN, LAND };
+
+inline size_t size_of(int datatype) {
+    switch(datatype) {
+        case INT:       return sizeof(int);
+        case LONG:      return sizeof(long);
+        case LONG_LONG: return sizeof(long long);
+        case FLOAT:     return sizeof(float);
+        case DOUBLE:    return sizeof(double);
+        default:        return 1;
+    }
+}
+
+template<class T>
+void combine(T *result, T const *values, int count, int op) {
+    for(int i=0; i<count; i++) {
+        switch(op) {
+            case SUM:  result[i] = result[i] + values[i]; break;
+            case MAX:  if(result[i] < values[i]) result[i] = values[i]; break;
+            case MIN:  if(values[i] < result[i]) result[i] = values[i]; break;
+            case LAND: result[i] = (result[i] && values[i]); break;
+        }
+    }
+}
+
+// Reduce the contributions of ranks [0, last) into result, in
+// rank order.
+inline void reduce(
+    std::vector< std::vector<char> > const& shared, size_t last,
+    void *result, int count, int datatype, int op
+) {
+    std::memcpy(result, &shared[0][0], count*size_of(datatype));
+
+    for(size_t rank=1; rank<last; rank++) {
+        void const *values = &shared[rank][0];
+
+        switch(datatype) {
+            case INT:
+                combine(
+                    static_cast<int*>(result),
+                    static_cast<int const*>(values), count, op
+                );
+                break;
+            case LONG:
+                combine(
+                    static_cast<long*>(result),
+                    static_cast<long const*>(values), count, op
+                );
+                break;
+            case LONG_LONG:
+                combine(
+                    static_cast<long long*>(result),
+                    static_cast<long long const*>(values), count, op
+                );
+                break;
+            case FLOAT:
+                combine(
+                    static_cast<float*>(result),
+                    static_cast<float const*>(values), count, op
+                );
+                break;
+            case DOUBLE:
+                combine(
+                    static_cast<double*>(result),
+                    static_cast<double const*>(values), count, op
+                );
+                break;
+            default:
+                combine(
+                    static_cast<char*>(result),
+                    static_cast<char const*>(values), count, op
+                );
+        }
+    }
+}
+
+
+// Run rank_main on count threads, each a rank of MPI_COMM_WORLD.
+// Returns the first non-zero return value, if any.
+inline int run(int count, int (*rank_main)(int, char**), int argc, char **argv) {
+    std::vector<int> world_ranks(count);
+    for(int i=0; i<count; i++) world_ranks[i] = i;
+    world() = new Comm(world_ranks, count);
+
+    std::vector<int> results(count, 0);
+    std::vector<std::thread> threads;
+    for(int i=0; i<count; i++) {
+        threads.push_back(std::thread([=, &results]() {
+            world_rank() = i;
+            results[i] = rank_main(argc, argv);
+        }));
+    }
+
+    int result = 0;
+    for(int i=0; i<count; i++) {
+        threads[i].join();
+        if(result == 0) result = results[i];
+    }
+
+    delete world();
+    world() = NULL;
+
+    return result;
+}
+
+
+}  // namespace ThreadMPI
+}  // namespace ActorModel
+
+
+/*
+ * The MPI interface
+ */
+
+// A real <mpi.h> included first defines many of these names as macros,
+// which are set aside while they're declared here.
+#pragma push_macro("MPI_COMM_WORLD")
+#undef MPI_COMM_WORLD
+#pragma push_macro("MPI_COMM_SELF")
+#undef MPI_COMM_SELF
+#pragma push_macro("MPI_COMM_NULL")
+#undef MPI_COMM_NULL
+#pragma push_macro("MPI_STATUS_IGNORE")
+#undef MPI_STATUS_IGNORE
+#pragma push_macro("MPI_STATUSES_IGNORE")
+#undef MPI_STATUSES_IGNORE
+#pragma push_macro("MPI_REQUEST_NULL")
+#undef MPI_REQUEST_NULL
+#pragma push_macro("MPI_UNWEIGHTED")
+#undef MPI_UNWEIGHTED
+#pragma push_macro("MPI_WEIGHTS_EMPTY")
+#undef MPI_WEIGHTS_EMPTY
+#pragma push_macro("MPI_SUCCESS")
+#undef MPI_SUCCESS
+#pragma push_macro("MPI_ERR_OTHER")
+#undef MPI_ERR_OTHER
+#pragma push_macro("MPI_ANY_SOURCE")
+#undef MPI_ANY_SOURCE
+#pragma push_macro("MPI_ANY_TAG")
+#undef MPI_ANY_TAG
+#pragma push_macro("MPI_UNDEFINED")
+#undef MPI_UNDEFINED
+#pragma push_macro("MPI_INFO_NULL")
+#undef MPI_INFO_NULL
+#pragma push_macro("MPI_COMM_TYPE_SHARED")
+#undef MPI_COMM_TYPE_SHARED
+#pragma push_macro("MPI_MODE_NOCHECK")
+#undef MPI_MODE_NOCHECK
+#pragma push_macro("MPI_MODE_CREATE")
+#undef MPI_MODE_CREATE
+#pragma push_macro("MPI_MODE_RDONLY")
+#undef MPI_MODE_RDONLY
+#pragma push_macro("MPI_MODE_WRONLY")
+#undef MPI_MODE_WRONLY
+#pragma push_macro("MPI_BYTE")
+#undef MPI_BYTE
+#pragma push_macro("MPI_CHAR")
+#undef MPI_CHAR
+#pragma push_macro("MPI_INT")
+#undef MPI_INT
+#pragma push_macro("MPI_LONG")
+#undef MPI_LONG
+#pragma push_macro("MPI_LONG_LONG")
+#undef MPI_LONG_LONG
+#pragma push_macro("MPI_FLOAT")
+#undef MPI_FLOAT
+#pragma push_macro("MPI_DOUBLE")
+#undef MPI_DOUBLE
+#pragma push_macro("MPI_SUM")
+#undef MPI_SUM
+#pragma push_macro("MPI_MAX")
+#undef MPI_MAX
+#pragma push_macro("MPI_MIN")
+#undef MPI_MIN
+#pragma push_macro("MPI_LAND")
+#undef MPI_LAND
+
+namespace ActorModel {
+namespace ThreadMPI {
+namespace Interface {
+
+
+typedef ActorModel::ThreadMPI::Comm* MPI_Comm;
+typedef ActorModel::ThreadMPI::Group* MPI_Group;
+typedef ActorModel::ThreadMPI::Window* MPI_Win;
+typedef ActorModel::ThreadMPI::File* MPI_File;
+typedef ActorModel::ThreadMPI::Request* MPI_Request;
+typedef int MPI_Datatype;
+typedef int MPI_Op;
+typedef int MPI_Info;
+typedef std::ptrdiff_t MPI_Aint;
+typedef long long MPI_Offset;
+
+struct MPI_Status {
+    int MPI_SOURCE;
+    int MPI_TAG;
+    int MPI_ERROR;
+
+    size_t bytes;
+};
+
+// The world and self communicators differ between ranks, so they're
+// looked up whenever they're used as a communicator.
+struct WorldComm {
+    operator MPI_Comm() const { return ActorModel::ThreadMPI::world(); }
+};
+struct SelfComm {
+    operator MPI_Comm() const { return ActorModel::ThreadMPI::self(); }
+};
+
+const WorldComm MPI_COMM_WORLD = WorldComm();
+const SelfComm MPI_COMM_SELF = SelfComm();
+MPI_Comm const MPI_COMM_NULL = NULL;
+MPI_Status* const MPI_STATUS_IGNORE = NULL;
+MPI_Status* const MPI_STATUSES_IGNORE = NULL;
+MPI_Request const MPI_REQUEST_NULL = NULL;
+int* const MPI_UNWEIGHTED = NULL;
+int* const MPI_WEIGHTS_EMPTY = NULL;
+
+const int MPI_SUCCESS = 0;
+const int MPI_ERR_OTHER = 16;
+const int MPI_ANY_SOURCE = -1;
+const int MPI_ANY_TAG = -1;
+const int MPI_UNDEFINED = -32766;
+const int MPI_INFO_NULL = 0;
+const int MPI_COMM_TYPE_SHARED = 1;
+const int MPI_MODE_NOCHECK = 1;
+const int MPI_MODE_CREATE = 1;
+const int MPI_MODE_RDONLY = 2;
+const int MPI_MODE_WRONLY = 4;
+
+const MPI_Datatype MPI_BYTE = ActorModel::ThreadMPI::BYTE;
+const MPI_Datatype MPI_CHAR = ActorModel::ThreadMPI::CHAR;
+const MPI_Datatype MPI_INT = ActorModel::ThreadMPI::INT;
+const MPI_Datatype MPI_LONG = ActorModel::ThreadMPI::LONG;
+const MPI_Datatype MPI_LONG_LONG = ActorModel::ThreadMPI::LONG_LONG;
+const MPI_Datatype MPI_FLOAT = ActorModel::ThreadMPI::FLOAT;
+const MPI_Datatype MPI_DOUBLE = ActorModel::ThreadMPI::DOUBLE;
+
+const MPI_Op MPI_SUM = ActorModel::ThreadMPI::SUM;
+const MPI_Op MPI_MAX = ActorModel::ThreadMPI::MAX;
+const MPI_Op MPI_MIN = ActorModel::ThreadMPI::MIN;
+const MPI_Op MPI_LAND = ActorModel::ThreadMPI::LAND;
+
+
+/*
+ * Set up
+ */
+
+inline int MPI_Init(int*, char***) { return MPI_SUCCESS; }
+inline int MPI_Finalize(void) { return MPI_SUCCESS; }
+inline int MPI_Buffer_attach(void*, int) { return MPI_SUCCESS; }
+
+inline int MPI_Abort(MPI_Comm, int code) {
+    std::exit(code);
+}
+
+inline double MPI_Wtime(void) {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+
+/*
+ * Communicators and groups
+ */
+
+inline int MPI_Comm_rank(MPI_Comm comm, int *rank) {
+    *rank = ActorModel::ThreadMPI::rank_in(comm);
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Comm_size(MPI_Comm comm, int *size) {
+    *size = comm->size();
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Comm_dup(MPI_Comm comm, MPI_Comm *new_comm) {
+    using namespace ActorModel::ThreadMPI;
+
+    Comm *created = NULL;
+    if(rank_in(comm) == 0) {
+        created = new Comm(comm->world_ranks, comm->ranks.size());
+    }
+
+    std::vector< std::vector<char> > shared =
+        share(comm, &created, sizeof(Comm*));
+    std::memcpy(new_comm, &shared[0][0], sizeof(Comm*));
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Comm_split(
+    MPI_Comm comm, int color, int key, MPI_Comm *new_comm
+) {
+    using namespace ActorModel::ThreadMPI;
+
+    int colour_and_key[2] = {color, key};
+    std::vector< std::vector<char> > shared =
+        share(comm, colour_and_key, sizeof(colour_and_key));
+
+    // The ranks sharing this colour, ordered by key then rank
+    std::vector< std::pair<int, int> > members;
+    for(int rank=0; rank<comm->size(); rank++) {
+        int other[2];
+        std::memcpy(other, &shared[rank][0], sizeof(other));
+
+        if(other[0] == color) {
+            members.push_back(std::make_pair(other[1], rank));
+        }
+    }
+    std::sort(members.begin(), members.end());
+
+    // The first member makes the communicator for the rest
+    Comm *created = NULL;
+    if(color != MPI_UNDEFINED && members[0].second == rank_in(comm)) {
+        std::vector<int> world_ranks;
+        for(size_t i=0; i<members.size(); i++) {
+            world_ranks.push_back(comm->world_ranks[members[i].second]);
+        }
+
+        created = new Comm(world_ranks, comm->ranks.size());
+    }
+
+    shared = share(comm, &created, sizeof(Comm*));
+
+    *new_comm = MPI_COMM_NULL;
+    if(color != MPI_UNDEFINED) {
+        std::memcpy(new_comm, &shared[members[0].second][0], sizeof(Comm*));
+    }
+
+    return MPI_SUCCESS;
+}
+
+// Every rank shares the node
+inline int MPI_Comm_split_type(
+    MPI_Comm comm, int, int, MPI_Info, MPI_Comm *new_comm
+) {
+    return MPI_Comm_dup(comm, new_comm);
+}
+
+inline int MPI_Comm_free(MPI_Comm *comm) {
+    if(--(*comm)->references == 0) delete *comm;
+    *comm = NULL;
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Comm_group(MPI_Comm comm, MPI_Group *group) {
+    *group = new ActorModel::ThreadMPI::Group;
+    (*group)->world_ranks = comm->world_ranks;
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Group_translate_ranks(
+    MPI_Group from, int count, int const *ranks, MPI_Group to, int *to_ranks
+) {
+    for(int i=0; i<count; i++) {
+        int world_rank = from->world_ranks[ranks[i]];
+
+        to_ranks[i] = MPI_UNDEFINED;
+        for(size_t j=0; j<to->world_ranks.size(); j++) {
+            if(to->world_ranks[j] == world_rank) to_ranks[i] = j;
+        }
+    }
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Group_free(MPI_Group *group) {
+    delete *group;
+    *group = NULL;
+
+    return MPI_SUCCESS;
+}
+
+
+/*
+ * Point to point
+ */
+
+inline int MPI_Bsend(
+    void const *data, int count, MPI_Datatype datatype,
+    int rank, int tag, MPI_Comm comm
+) {
+    using namespace ActorModel::ThreadMPI;
+
+    Envelope *envelope = new Envelope;
+    envelope->source = rank_in(comm);
+    envelope->tag = tag;
+
+    char const *bytes = static_cast<char const*>(data);
+    envelope->data.assign(bytes, bytes + count*size_of(datatype));
+
+    comm->mailboxes[rank].push(envelope);
+
+    return MPI_SUCCESS;
+}
+
+inline void set_status(
+    MPI_Status *status, ActorModel::ThreadMPI::Envelope const *envelope
+) {
+    if(status == MPI_STATUS_IGNORE) return;
+
+    status->MPI_SOURCE = envelope->source;
+    status->MPI_TAG = envelope->tag;
+    status->MPI_ERROR = MPI_SUCCESS;
+    status->bytes = envelope->data.size();
+}
+
+inline int MPI_Iprobe(
+    int source, int tag, MPI_Comm comm, int *flag, MPI_Status *status
+) {
+    using namespace ActorModel::ThreadMPI;
+
+    Mailbox& mailbox = comm->mailboxes[rank_in(comm)];
+    std::deque<Envelope*>::iterator found = mailbox.find(source, tag);
+
+    *flag = (found != mailbox.pending.end());
+    if(*flag) set_status(status, *found);
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status *status) {
+    int flag = 0;
+    while(MPI_Iprobe(source, tag, comm, &flag, status), !flag) {
+        std::this_thread::yield();
+    }
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Recv(
+    void *data, int count, MPI_Datatype datatype,
+    int source, int tag, MPI_Comm comm, MPI_Status *status
+) {
+    using namespace ActorModel::ThreadMPI;
+
+    MPI_Probe(source, tag, comm, MPI_STATUS_IGNORE);
+
+    Mailbox& mailbox = comm->mailboxes[rank_in(comm)];
+    std::deque<Envelope*>::iterator found = mailbox.find(source, tag);
+    Envelope *envelope = *found;
+    mailbox.pending.erase(found);
+
+    size_t bytes = std::min(envelope->data.size(), count*size_of(datatype));
+    if(bytes > 0) std::memcpy(data, &envelope->data[0], bytes);
+
+    set_status(status, envelope);
+    delete envelope;
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Get_count(
+    MPI_Status const *status, MPI_Datatype datatype, int *count
+) {
+    size_t size = ActorModel::ThreadMPI::size_of(datatype);
+
+    *count = (status->bytes % size == 0) ? status->bytes/size : MPI_UNDEFINED;
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Bsend_init(
+    void const *data, int count, MPI_Datatype datatype,
+    int rank, int tag, MPI_Comm comm, MPI_Request *request
+) {
+    *request = new ActorModel::ThreadMPI::Request;
+
+    (*request)->data = data;
+    (*request)->count = count;
+    (*request)->datatype = datatype;
+    (*request)->rank = rank;
+    (*request)->tag = tag;
+    (*request)->comm = comm;
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Start(MPI_Request *request) {
+    return MPI_Bsend(
+        (*request)->data, (*request)->count, (*request)->datatype,
+        (*request)->rank, (*request)->tag, (*request)->comm
+    );
+}
+
+inline int MPI_Startall(int count, MPI_Request *requests) {
+    for(int i=0; i<count; i++) MPI_Start(&requests[i]);
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Waitall(int, MPI_Request*, MPI_Status*) {
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Request_free(MPI_Request *request) {
+    delete *request;
+    *request = MPI_REQUEST_NULL;
+
+    return MPI_SUCCESS;
+}
+
+
+/*
+ * Collectives
+ */
+
+inline int MPI_Barrier(MPI_Comm comm) {
+    ActorModel::ThreadMPI::barrier(comm);
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Bcast(
+    void *data, int count, MPI_Datatype datatype, int root, MPI_Comm comm
+) {
+    using namespace ActorModel::ThreadMPI;
+
+    size_t bytes = count*size_of(datatype);
+    bool is_root = (rank_in(comm) == root);
+
+    std::vector< std::vector<char> > shared =
+        share(comm, data, is_root ? bytes : 0);
+    if(!is_root && bytes > 0) std::memcpy(data, &shared[root][0], bytes);
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Allreduce(
+    void const *values, void *result, int count,
+    MPI_Datatype datatype, MPI_Op op, MPI_Comm comm
+) {
+    using namespace ActorModel::ThreadMPI;
+
+    std::vector< std::vector<char> > shared =
+        share(comm, values, count*size_of(datatype));
+    reduce(shared, shared.size(), result, count, datatype, op);
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Reduce(
+    void const *values, void *result, int count,
+    MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm
+) {
+    using namespace ActorModel::ThreadMPI;
+
+    std::vector< std::vector<char> > shared =
+        share(comm, values, count*size_of(datatype));
+    if(rank_in(comm) == root) {
+        reduce(shared, shared.size(), result, count, datatype, op);
+    }
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Exscan(
+    void const *values, void *result, int count,
+    MPI_Datatype datatype, MPI_Op op, MPI_Comm comm
+) {
+    using namespace ActorModel::ThreadMPI;
+
+    std::vector< std::vector<char> > shared =
+        share(comm, values, count*size_of(datatype));
+
+    int rank = rank_in(comm);
+    if(rank > 0) reduce(shared, rank, result, count, datatype, op);
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Gatherv(
+    void const *values, int count, MPI_Datatype datatype,
+    void *result, int const *counts, int const *offsets,
+    MPI_Datatype result_datatype, int root, MPI_Comm comm
+) {
+    using namespace ActorModel::ThreadMPI;
+
+    std::vector< std::vector<char> > shared =
+        share(comm, values, count*size_of(datatype));
+    if(rank_in(comm) != root) return MPI_SUCCESS;
+
+    size_t size = size_of(result_datatype);
+    for(size_t rank=0; rank<shared.size(); rank++) {
+        if(counts[rank] > 0) {
+            std::memcpy(
+                static_cast<char*>(result) + offsets[rank]*size,
+                &shared[rank][0], counts[rank]*size
+            );
+        }
+    }
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Allgather(
+    void const *values, int count, MPI_Datatype datatype,
+    void *result, int, MPI_Datatype, MPI_Comm comm
+) {
+    using namespace ActorModel::ThreadMPI;
+
+    size_t bytes = count*size_of(datatype);
+    std::vector< std::vector<char> > shared = share(comm, values, bytes);
+
+    for(size_t rank=0; rank<shared.size(); rank++) {
+        if(bytes > 0) {
+            std::memcpy(
+                static_cast<char*>(result) + rank*bytes,
+                &shared[rank][0], bytes
+            );
+        }
+    }
+
+    return MPI_SUCCESS;
+}
+
+// The root shares its counts and offsets along with its values, since
+// they're only given on the root.
+inline int MPI_Scatterv(
+    void const *values, int const *counts, int const *offsets,
+    MPI_Datatype datatype,
+    void *result, int, MPI_Datatype, int root, MPI_Comm comm
+) {
+    using namespace ActorModel::ThreadMPI;
+
+    size_t size = size_of(datatype);
+    int rank = rank_in(comm);
+
+    std::vector<char> bytes;
+    if(rank == root) {
+        int total = 0;
+        for(int i=0; i<comm->size(); i++) {
+            total = std::max(total, offsets[i] + counts[i]);
+        }
+
+        char const *counts_bytes = reinterpret_cast<char const*>(counts);
+        char const *offsets_bytes = reinterpret_cast<char const*>(offsets);
+        char const *values_bytes = static_cast<char const*>(values);
+
+        bytes.insert(
+            bytes.end(), counts_bytes, counts_bytes + comm->size()*sizeof(int)
+        );
+        bytes.insert(
+            bytes.end(), offsets_bytes, offsets_bytes + comm->size()*sizeof(int)
+        );
+        bytes.insert(bytes.end(), values_bytes, values_bytes + total*size);
+    }
+
+    std::vector< std::vector<char> > shared =
+        share(comm, bytes.empty() ? NULL : &bytes[0], bytes.size());
+    std::vector<char> const& from = shared[root];
+
+    int count;
+    int offset;
+    std::memcpy(&count, &from[rank*sizeof(int)], sizeof(int));
+    std::memcpy(
+        &offset, &from[(comm->size() + rank)*sizeof(int)], sizeof(int)
+    );
+
+    if(count > 0) {
+        std::memcpy(
+            result, &from[2*comm->size()*sizeof(int) + offset*size],
+            count*size
+        );
+    }
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Scatter(
+    void const *values, int count, MPI_Datatype datatype,
+    void *result, int result_count, MPI_Datatype result_datatype,
+    int root, MPI_Comm comm
+) {
+    std::vector<int> counts(comm->size(), count);
+    std::vector<int> offsets(comm->size());
+    for(int rank=0; rank<comm->size(); rank++) {
+        offsets[rank] = rank*count;
+    }
+
+    return MPI_Scatterv(
+        values, &counts[0], &offsets[0], datatype,
+        result, result_count, result_datatype, root, comm
+    );
+}
+
+inline int MPI_Alltoall(
+    void const *values, int count, MPI_Datatype datatype,
+    void *result, int, MPI_Datatype, MPI_Comm comm
+) {
+    using namespace ActorModel::ThreadMPI;
+
+    int bytes = count*size_of(datatype);
+
+    std::vector<int> ranks(comm->size());
+    std::vector<int> counts(comm->size(), bytes);
+    std::vector<int> offsets(comm->size());
+    for(int rank=0; rank<comm->size(); rank++) {
+        ranks[rank] = rank;
+        offsets[rank] = rank*bytes;
+    }
+
+    exchange_blocks(
+        comm, ranks, static_cast<char const*>(values), &counts[0], &offsets[0],
+        ranks, static_cast<char*>(result), &counts[0], &offsets[0]
+    );
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Gather(
+    void const *values, int count, MPI_Datatype datatype,
+    void *result, int result_count, MPI_Datatype result_datatype,
+    int root, MPI_Comm comm
+) {
+    std::vector<int> counts(comm->size(), result_count);
+    std::vector<int> offsets(comm->size());
+    for(int rank=0; rank<comm->size(); rank++) {
+        offsets[rank] = rank*result_count;
+    }
+
+    return MPI_Gatherv(
+        values, count, datatype, result, &counts[0], &offsets[0],
+        result_datatype, root, comm
+    );
+}
+
+
+/*
+ * Graph communicators and neighbourhood collectives. Neighbourhood
+ * collectives finish before returning.
+ */
+
+inline int MPI_Dist_graph_create_adjacent(
+    MPI_Comm comm,
+    int source_count, int const *sources, int const*,
+    int destination_count, int const *destinations, int const*,
+    MPI_Info, int, MPI_Comm *graph_comm
+) {
+    MPI_Comm_dup(comm, graph_comm);
+
+    int rank = ActorModel::ThreadMPI::rank_in(comm);
+    (*graph_comm)->sources[rank].assign(sources, sources + source_count);
+    (*graph_comm)->destinations[rank].assign(
+        destinations, destinations + destination_count
+    );
+
+    return MPI_SUCCESS;
+}
+
+// Ranks are never reordered, so the graph only needs to be kept
+// for graphs used in neighbourhood collectives.
+inline int MPI_Dist_graph_create(
+    MPI_Comm comm, int, int const*, int const*, int const*, int const*,
+    MPI_Info, int, MPI_Comm *graph_comm
+) {
+    return MPI_Comm_dup(comm, graph_comm);
+}
+
+inline int MPI_Neighbor_alltoallv(
+    void const *values, int const *counts, int const *offsets,
+    MPI_Datatype datatype,
+    void *result, int const *result_counts, int const *result_offsets,
+    MPI_Datatype result_datatype, MPI_Comm comm
+) {
+    using namespace ActorModel::ThreadMPI;
+
+    int rank = rank_in(comm);
+    std::vector<int> const& destinations = comm->destinations[rank];
+    std::vector<int> const& sources = comm->sources[rank];
+
+    // Work in bytes
+    size_t size = size_of(datatype);
+    std::vector<int> send_counts(destinations.size());
+    std::vector<int> send_offsets(destinations.size());
+    for(size_t i=0; i<destinations.size(); i++) {
+        send_counts[i] = counts[i]*size;
+        send_offsets[i] = offsets[i]*size;
+    }
+
+    size_t result_size = size_of(result_datatype);
+    std::vector<int> receive_counts(sources.size());
+    std::vector<int> receive_offsets(sources.size());
+    for(size_t i=0; i<sources.size(); i++) {
+        receive_counts[i] = result_counts[i]*result_size;
+        receive_offsets[i] = result_offsets[i]*result_size;
+    }
+
+    exchange_blocks(
+        comm,
+        destinations, static_cast<char const*>(values),
+        send_counts.empty() ? NULL : &send_counts[0],
+        send_offsets.empty() ? NULL : &send_offsets[0],
+        sources, static_cast<char*>(result),
+        receive_counts.empty() ? NULL : &receive_counts[0],
+        receive_offsets.empty() ? NULL : &receive_offsets[0]
+    );
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Neighbor_alltoall(
+    void const *values, int count, MPI_Datatype datatype,
+    void *result, int result_count, MPI_Datatype result_datatype,
+    MPI_Comm comm
+) {
+    int rank = ActorModel::ThreadMPI::rank_in(comm);
+    size_t destination_count = comm->destinations[rank].size();
+    size_t source_count = comm->sources[rank].size();
+
+    std::vector<int> counts(destination_count, count);
+    std::vector<int> offsets(destination_count);
+    for(size_t i=0; i<destination_count; i++) offsets[i] = i*count;
+
+    std::vector<int> result_counts(source_count, result_count);
+    std::vector<int> result_offsets(source_count);
+    for(size_t i=0; i<source_count; i++) result_offsets[i] = i*result_count;
+
+    return MPI_Neighbor_alltoallv(
+        values,
+        counts.empty() ? NULL : &counts[0],
+        offsets.empty() ? NULL : &offsets[0], datatype,
+        result,
+        result_counts.empty() ? NULL : &result_counts[0],
+        result_offsets.empty() ? NULL : &result_offsets[0], result_datatype,
+        comm
+    );
+}
+
+
+/*
+ * Shared windows. Every rank already shares memory.
+ */
+
+inline int MPI_Win_allocate_shared(
+    MPI_Aint size, int, MPI_Info, MPI_Comm comm, void *base, MPI_Win *window
+) {
+    using namespace ActorModel::ThreadMPI;
+
+    char *segment = new char[size > 0 ? size : 1];
+    std::memcpy(base, &segment, sizeof(char*));
+
+    MPI_Aint shared_segment[2];
+    std::memcpy(&shared_segment[0], &segment, sizeof(char*));
+    shared_segment[1] = size;
+
+    std::vector< std::vector<char> > shared =
+        share(comm, shared_segment, sizeof(shared_segment));
+
+    *window = new Window;
+    (*window)->comm = comm;
+    for(size_t rank=0; rank<shared.size(); rank++) {
+        std::memcpy(shared_segment, &shared[rank][0], sizeof(shared_segment));
+
+        char *rank_segment;
+        std::memcpy(&rank_segment, &shared_segment[0], sizeof(char*));
+
+        (*window)->segments.push_back(rank_segment);
+        (*window)->sizes.push_back(shared_segment[1]);
+    }
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Win_shared_query(
+    MPI_Win window, int rank, MPI_Aint *size, int *displacement_unit,
+    void *base
+) {
+    *size = window->sizes[rank];
+    *displacement_unit = 1;
+    std::memcpy(base, &window->segments[rank], sizeof(char*));
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Win_lock_all(int, MPI_Win) { return MPI_SUCCESS; }
+inline int MPI_Win_unlock_all(MPI_Win) { return MPI_SUCCESS; }
+
+inline int MPI_Win_sync(MPI_Win) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return MPI_SUCCESS;
+}
+
+inline int MPI_Win_free(MPI_Win *window) {
+    ActorModel::ThreadMPI::barrier((*window)->comm);
+
+    int rank = ActorModel::ThreadMPI::rank_in((*window)->comm);
+    delete[] (*window)->segments[rank];
+    delete *window;
+    *window = NULL;
+
+    return MPI_SUCCESS;
+}
+
+
+/*
+ * Files
+ */
+
+inline int MPI_File_open(
+    MPI_Comm comm, char const *path, int mode, MPI_Info, MPI_File *file
+) {
+    int flags = (mode & MPI_MODE_WRONLY) ? O_WRONLY : O_RDONLY;
+    if(mode & MPI_MODE_CREATE) flags |= O_CREAT;
+
+    int descriptor = open(path, flags, 0644);
+
+    // Opening is collective, so every rank fails if any does
+    int failed = (descriptor < 0);
+    int any_failed;
+    MPI_Allreduce(&failed, &any_failed, 1, MPI_INT, MPI_MAX, comm);
+
+    if(any_failed) {
+        if(descriptor >= 0) close(descriptor);
+        return MPI_ERR_OTHER;
+    }
+
+    *file = new ActorModel::ThreadMPI::File;
+    (*file)->descriptor = descriptor;
+    (*file)->comm = comm;
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_File_close(MPI_File *file) {
+    close((*file)->descriptor);
+    ActorModel::ThreadMPI::barrier((*file)->comm);
+
+    delete *file;
+    *file = NULL;
+
+    return MPI_SUCCESS;
+}
+
+inline int MPI_File_delete(char const *path, MPI_Info) {
+    return (unlink(path) == 0) ? MPI_SUCCESS : MPI_ERR_OTHER;
+}
+
+inline int MPI_File_write_at(
+    MPI_File file, MPI_Offset offset, void const *data, int count,
+    MPI_Datatype datatype, MPI_Status*
+) {
+    size_t bytes = count*ActorModel::ThreadMPI::size_of(datatype);
+    ssize_t written = pwrite(file->descriptor, data, bytes, offset);
+
+    return (written == static_cast<ssize_t>(bytes)) ? MPI_SUCCESS : MPI_ERR_OTHER;
+}
+
+inline int MPI_File_write_at_all(
+    MPI_File file, MPI_Offset offset, void const *data, int count,
+    MPI_Datatype datatype, MPI_Status *status
+) {
+    return MPI_File_write_at(file, offset, data, count, datatype, status);
+}
+
+inline int MPI_File_read_at(
+    MPI_File file, MPI_Offset offset, void *data, int count,
+    MPI_Datatype datatype, MPI_Status*
+) {
+    size_t bytes = count*ActorModel::ThreadMPI::size_of(datatype);
+    ssize_t read = pread(file->descriptor, data, bytes, offset);
+
+    return (read == static_cast<ssize_t>(bytes)) ? MPI_SUCCESS : MPI_ERR_OTHER;
+}
+
+inline int MPI_File_read_at_all(
+    MPI_File file, MPI_Offset offset, void *data, int count,
+    MPI_Datatype datatype, MPI_Status *status
+) {
+    return MPI_File_read_at(file, offset, data, count, datatype, status);
+}
+
+
+
+}  // namespace Interface
+}  // namespace ThreadMPI
+}  // namespace ActorModel
+
+#pragma pop_macro("MPI_COMM_WORLD")
+#pragma pop_macro("MPI_COMM_SELF")
+#pragma pop_macro("MPI_COMM_NULL")
+#pragma pop_macro("MPI_STATUS_IGNORE")
+#pragma pop_macro("MPI_STATUSES_IGNORE")
+#pragma pop_macro("MPI_REQUEST_NULL")
+#pragma pop_macro("MPI_UNWEIGHTED")
+#pragma pop_macro("MPI_WEIGHTS_EMPTY")
+#pragma pop_macro("MPI_SUCCESS")
+#pragma pop_macro("MPI_ERR_OTHER")
+#pragma pop_macro("MPI_ANY_SOURCE")
+#pragma pop_macro("MPI_ANY_TAG")
+#pragma pop_macro("MPI_UNDEFINED")
+#pragma pop_macro("MPI_INFO_NULL")
+#pragma pop_macro("MPI_COMM_TYPE_SHARED")
+#pragma pop_macro("MPI_MODE_NOCHECK")
+#pragma pop_macro("MPI_MODE_CREATE")
+#pragma pop_macro("MPI_MODE_RDONLY")
+#pragma pop_macro("MPI_MODE_WRONLY")
+#pragma pop_macro("MPI_BYTE")
+#pragma pop_macro("MPI_CHAR")
+#pragma pop_macro("MPI_INT")
+#pragma pop_macro("MPI_LONG")
+#pragma pop_macro("MPI_LONG_LONG")
+#pragma pop_macro("MPI_FLOAT")
+#pragma pop_macro("MPI_DOUBLE")
+#pragma pop_macro("MPI_SUM")
+#pragma pop_macro("MPI_MAX")
+#pragma pop_macro("MPI_MIN")
+#pragma pop_macro("MPI_LAND")
+
+
+#endif  // ACTOR_THREAD_MPI_H_
@@ -0,0 +1,171 @@
+#ifndef ACTOR_TIMERS_H_
+#define ACTOR_TIMERS_H_
+
+#include "./backend.h"
+#include <queue>
+#include <vector>
+#include <set>
+
+
+namespace ActorModel {
+
+
+/**
+ * Timers
+ *
+ * The timers class keeps the timers set by actors on a process in a
+ * heap ordered by when they are due.
+ *
+ * Timers are measured in seconds of MPI_Wtime. When a timer is due,
+ * the Director delivers a message with the timer's tag to the actor
+ * that set it, waking it if it is waiting for a message.
+ * Periodic timers are put back on the heap each time they fire.
+ *
+ * Timer ids are counted on each process and interleaved by rank, so
+ * they stay unique if timers from several processes are put together
+ * when restarting from a checkpoint, without taking up gids.
+ */
+class Timers {
+public:
+
+    Timers(MPI_Comm comm_in=MPI_COMM_WORLD): _timer_count(0) {
+        MPI_Comm_rank(comm_in, &_comm_rank);
+        MPI_Comm_size(comm_in, &_comm_size);
+    }
+
+    // A timer set by an actor.
+    struct Timer {
+        double due;
+        double period;
+
+        int timer_id;
+        int gid;
+        int tag;
+    };
+
+
+    // The current time, as used by the timers.
+    static double now(void) {
+        return MPI_Wtime();
+    }
+
+    // Set a timer for the actor with the given gid to fire once after
+    // delay seconds, or, if period is positive, every period seconds
+    // after that. Returns the id of the timer.
+    int schedule(int gid, int tag, double delay, double period=0.0) {
+        Timer timer;
+
+        timer.due = now() + delay;
+        timer.period = period;
+        timer.timer_id = _timer_count*_comm_size + _comm_rank;
+        _timer_count++;
+        timer.gid = gid;
+        timer.tag = tag;
+
+        _timers.push(timer);
+        _pending.insert(timer.timer_id);
+
+        return timer.timer_id;
+    }
+
+    // Stop a timer from firing again. Timers that have already fired
+    // for the last time are left alone.
+    void cancel(int timer_id) {
+        if(_pending.erase(timer_id) != 0) _cancelled.insert(timer_id);
+    }
+
+    // Get the next timer that is due, if any.
+    // Periodic timers are rescheduled as they are taken.
+    bool pop_expired(Timer *expired) {
+        double current_time = now();
+
+        while(!_timers.empty() && _timers.top().due <= current_time) {
+            Timer timer = _timers.top();
+            _timers.pop();
+
+            if(_cancelled.count(timer.timer_id) != 0) {
+                _cancelled.erase(timer.timer_id);
+                continue;
+            }
+
+            if(timer.period > 0.0) {
+                Timer next = timer;
+                next.due += timer.period;
+
+                _timers.push(next);
+            } else {
+                _pending.erase(timer.timer_id);
+            }
+
+            *expired = timer;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    // The number of timers waiting to fire.
+    size_t size(void) {
+        return _timers.size();
+    }
+
+    // Get every timer still to fire, for a checkpoint.
+    // The due times are given as the time left until they are due.
+    std::vector<Timer> pending(void) const {
+        std::priority_queue<Timer, std::vector<Timer>, LaterThan> timers =
+            _timers;
+        std::vector<Timer> pending;
+
+        double current_time = now();
+        while(!timers.empty()) {
+            Timer timer = timers.top();
+            timers.pop();
+
+            if(_cancelled.count(timer.timer_id) != 0) continue;
+
+            timer.due -= current_time;
+            pending.push_back(timer);
+        }
+
+        return pending;
+    }
+
+    // Put back a timer taken from a checkpoint by pending.
+    void restore(Timer timer) {
+        timer.due += now();
+        _timers.push(timer);
+        _pending.insert(timer.timer_id);
+
+        // Keep new ids clear of the ones read back
+        int restored_count = timer.timer_id/_comm_size + 1;
+        if(restored_count > _timer_count) _timer_count = restored_count;
+    }
+
+
+private:
+
+    // Order the heap so the earliest timer is on top.
+    struct LaterThan {
+        bool operator()(Timer const& a, Timer const& b) const {
+            return a.due > b.due;
+        }
+    };
+
+    std::priority_queue<Timer, std::vector<Timer>, LaterThan> _timers;
+
+    // Ids of timers still to fire, and of those cancelled but still
+    // on the heap.
+    std::set<int> _pending;
+    std::set<int> _cancelled;
+
+    int _comm_rank;
+    int _comm_size;
+    int _timer_count;
+};
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_TIMERS_H_
@@ -0,0 +1,58 @@
+#ifndef ACTOR_TOMBSTONES_H_
+#define ACTOR_TOMBSTONES_H_
+
+#include <vector>
+#include <cstddef>
+
+
+namespace ActorModel {
+
+
+/**
+ * Tombstones
+ *
+ * A set of the gids of actors that have died on a process, so messages
+ * still on their way to them can be recognised and dropped rather than
+ * kept for an actor that will never take them.
+ *
+ * Gids are handed out in order from 0 by every process in turn, so
+ * the set is a bit per gid up to the largest buried, which stays small
+ * next to the actors it stands for.
+ */
+class Tombstones {
+public:
+
+    Tombstones(): _count(0) {}
+
+    // Mark a gid as dead.
+    void bury(int gid) {
+        if(gid < 0) return;
+
+        if(static_cast<size_t>(gid) >= _dead.size()) _dead.resize(gid+1);
+
+        if(!_dead[gid]) {
+            _dead[gid] = true;
+            _count++;
+        }
+    }
+
+    // Check if a gid has been marked as dead.
+    bool is_dead(int gid) const {
+        return gid >= 0 && static_cast<size_t>(gid) < _dead.size() && _dead[gid];
+    }
+
+    // The number of gids marked as dead.
+    size_t size(void) const {
+        return _count;
+    }
+
+private:
+    std::vector<bool> _dead;
+    size_t _count;
+};
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_TOMBSTONES_H_
@@ -0,0 +1,320 @@
+#ifndef ACTOR_TRACE_H_
+#define ACTOR_TRACE_H_
+
+#include "./backend.h"
+#include <map>
+#include <vector>
+#include <string>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <climits>
+
+#include "./statistics.h"
+
+
+// Tracing is compiled in by defining ACTOR_TRACE, eg -DACTOR_TRACE.
+// Without it, every trace call is an empty function.
+#ifdef ACTOR_TRACE
+#define ACTOR_TRACE_ENABLED 1
+#else
+#define ACTOR_TRACE_ENABLED 0
+#endif
+
+// The number of events kept on each process. Older events are
+// overwritten once the buffer is full.
+#ifndef ACTOR_TRACE_BUFFER_SIZE
+#define ACTOR_TRACE_BUFFER_SIZE 65536
+#endif
+
+// Trace files are written to <prefix>.<rank>.json
+#ifndef ACTOR_TRACE_PREFIX
+#define ACTOR_TRACE_PREFIX "actor_trace"
+#endif
+
+
+namespace ActorModel {
+
+
+/**
+ * Trace
+ *
+ * The trace class records timestamped events on each process into a
+ * fixed size ring buffer, and writes them out in the Chrome trace
+ * event format, which can be opened in Perfetto or chrome://tracing.
+ *
+ * Each process writes its own file, as a JSON array of events with one
+ * event per line, so they can be merged with
+ *  jq -s add actor_trace.*.json > actor_trace.json
+ *
+ * Messages between actors are drawn as flows from the send to the
+ * receive. Messages between a pair of ranks to a given actor arrive in
+ * the order they were sent, so both ends can number them the same way
+ * without adding anything to the message. The numbering for an actor
+ * is forgotten when it dies. Only the process it died on can tell, so
+ * other processes still hold a count for each dead actor they sent to.
+ *
+ * Only one thread per process is expected to record events.
+ */
+class Trace {
+public:
+
+    /*
+     * Recording events
+     */
+
+    // Start a new trace. The clocks on each process are lined up with a
+    // barrier, so this is a collective routine over comm.
+    static void start(MPI_Comm comm) {
+        if(!ACTOR_TRACE_ENABLED) return;
+
+        Trace& trace = instance();
+
+        MPI_Barrier(comm);
+        trace._epoch = MPI_Wtime();
+        MPI_Comm_rank(comm, &trace._rank);
+
+        trace._next_event = 0;
+        trace._event_count = 0;
+        trace._sent.clear();
+        trace._received.clear();
+    }
+
+    // Start and end a named span of time, eg a barrier.
+    static void begin(char const *name, int gid=-1) {
+        if(!ACTOR_TRACE_ENABLED) return;
+        instance().record('B', name, gid);
+    }
+
+    static void end(char const *name, int gid=-1) {
+        if(!ACTOR_TRACE_ENABLED) return;
+        instance().record('E', name, gid);
+    }
+
+    // Start and end a run of the main function of an actor.
+    // The type name is the mangled name from typeid.
+    static void begin_run(int gid, char const *type_name) {
+        if(!ACTOR_TRACE_ENABLED) return;
+        instance().record('B', type_name, gid, -1, -1, 0, true);
+    }
+
+    static void end_run(int gid, char const *type_name) {
+        if(!ACTOR_TRACE_ENABLED) return;
+        instance().record('E', type_name, gid, -1, -1, 0, true);
+    }
+
+    // A message was sent to the actor with gid on rank.
+    static void send(int gid, int rank, int receiver_gid) {
+        if(!ACTOR_TRACE_ENABLED) return;
+
+        Trace& trace = instance();
+        long sequence = trace._sent[std::make_pair(receiver_gid, rank)]++;
+
+        trace.record('i', "send", gid, rank, receiver_gid);
+        trace.record('s', "message", gid, rank, receiver_gid, sequence);
+    }
+
+    // A message for the actor with gid was taken from the MPI pipeline.
+    static void receive(int gid, int source_rank) {
+        if(!ACTOR_TRACE_ENABLED) return;
+
+        Trace& trace = instance();
+        long sequence = trace._received[std::make_pair(gid, source_rank)]++;
+
+        trace.record('i', "receive", gid, source_rank, gid);
+        trace.record('f', "message", gid, source_rank, gid, sequence);
+    }
+
+    // A birth was requested for the actor with child_gid on rank.
+    static void birth_request(int rank, int child_gid) {
+        if(!ACTOR_TRACE_ENABLED) return;
+
+        Trace& trace = instance();
+        trace.record('i', "birth request", -1, rank, child_gid);
+        trace.record('s', "birth", -1, rank, child_gid, child_gid);
+    }
+
+    // A requested actor was born on this process.
+    static void birth(int child_gid) {
+        if(!ACTOR_TRACE_ENABLED) return;
+
+        Trace& trace = instance();
+        trace.record('i', "birth", child_gid);
+        trace.record('f', "birth", child_gid, -1, child_gid, child_gid);
+    }
+
+
+    // The actor with gid died on this process, so no more messages
+    // will be sent to or received by it here.
+    static void forget(int gid) {
+        if(!ACTOR_TRACE_ENABLED) return;
+
+        Trace& trace = instance();
+        forget(trace._sent, gid);
+        forget(trace._received, gid);
+    }
+
+
+    /*
+     * Writing events
+     */
+
+    // Write the recorded events for this process to
+    // <prefix>.<rank>.json and clear them.
+    static void write(char const *prefix=ACTOR_TRACE_PREFIX) {
+        if(!ACTOR_TRACE_ENABLED) return;
+
+        Trace& trace = instance();
+
+        std::ostringstream filename;
+        filename << prefix << "." << trace._rank << ".json";
+
+        std::ofstream out(filename.str().c_str());
+        out << "[" << std::endl;
+
+        size_t first = (trace._event_count < trace._events.size()) ?
+            0 : trace._next_event;
+
+        for(size_t i=0; i<trace._event_count; i++) {
+            if(i > 0) out << "," << std::endl;
+
+            trace.write_event(
+                out, trace._events[(first + i) % trace._events.size()]
+            );
+        }
+        out << std::endl << "]" << std::endl;
+
+        trace._next_event = 0;
+        trace._event_count = 0;
+    }
+
+
+private:
+
+    struct Event {
+        double time;
+        char const *name;
+        char phase;
+        bool is_run;
+
+        int gid;
+        int peer_rank;
+        int peer_gid;
+        long sequence;
+    };
+
+    Trace():
+        _events(ACTOR_TRACE_ENABLED ? ACTOR_TRACE_BUFFER_SIZE : 0),
+        _next_event(0), _event_count(0),
+        _epoch(0.0), _rank(0)
+    {}
+
+    static Trace& instance(void) {
+        static ACTOR_RANK_LOCAL Trace trace;
+        return trace;
+    }
+
+    void record(
+        char phase, char const *name, int gid,
+        int peer_rank=-1, int peer_gid=-1, long sequence=0,
+        bool is_run=false
+    ) {
+        Event& event = _events[_next_event];
+
+        event.time = MPI_Wtime();
+        event.name = name;
+        event.phase = phase;
+        event.is_run = is_run;
+        event.gid = gid;
+        event.peer_rank = peer_rank;
+        event.peer_gid = peer_gid;
+        event.sequence = sequence;
+
+        _next_event = (_next_event + 1) % _events.size();
+        if(_event_count < _events.size()) _event_count++;
+    }
+
+    void write_event(std::ostream& out, Event const& event) {
+        double microseconds = (event.time - _epoch)*1e6;
+
+        out << "{\"name\":\"" << event_name(event) << "\""
+            << ",\"ph\":\"" << event.phase << "\""
+            << ",\"ts\":" << std::fixed << std::setprecision(3)
+            << microseconds
+            << ",\"pid\":" << _rank << ",\"tid\":0";
+
+        switch(event.phase) {
+            case 's':
+            case 'f': {
+                // Flows are matched by name and id across processes
+                int sender_rank = (event.phase == 's') ? _rank : event.peer_rank;
+                int receiver_rank = (event.phase == 's') ? event.peer_rank : _rank;
+
+                out << ",\"cat\":\"" << event.name << "\""
+                    << ",\"id\":\"";
+                if(std::string(event.name) == "birth") {
+                    out << event.sequence;
+                } else {
+                    out << sender_rank << "." << receiver_rank << "."
+                        << event.peer_gid << "." << event.sequence;
+                }
+                out << "\"";
+
+                if(event.phase == 'f') out << ",\"bp\":\"e\"";
+            } break;
+
+            case 'i': {
+                out << ",\"s\":\"t\"";
+            } // fall through
+
+            default: {
+                out << ",\"args\":{\"gid\":" << event.gid;
+                if(event.peer_rank >= 0 || event.peer_gid >= 0) {
+                    out << ",\"peer_rank\":" << event.peer_rank
+                        << ",\"peer_gid\":" << event.peer_gid;
+                }
+                out << "}";
+            }
+        }
+
+        out << "}";
+    }
+
+    // Remove the counts for every rank of the given gid.
+    typedef std::map<std::pair<int, int>, long> FlowCounts;
+    static void forget(FlowCounts& counts, int gid) {
+        counts.erase(
+            counts.lower_bound(std::make_pair(gid, INT_MIN)),
+            counts.upper_bound(std::make_pair(gid, INT_MAX))
+        );
+    }
+
+    // Type names are recorded mangled, and only demangled on writing.
+    static std::string event_name(Event const& event) {
+        if(event.is_run) {
+            return "run " + Statistics::demangle(event.name);
+        }
+
+        return event.name;
+    }
+
+
+    std::vector<Event> _events;
+    size_t _next_event;
+    size_t _event_count;
+
+    double _epoch;
+    int _rank;
+
+    // The number of messages sent to and received from
+    // each (gid, rank) pair, for numbering flows.
+    FlowCounts _sent;
+    FlowCounts _received;
+};
+
+
+}  // namespace ActorModel
+
+
+#endif  // ACTOR_TRACE_H_
@@ -1,6 +1,13 @@
 #include "./super_quick_test.h"
 
+#include <sstream>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <typeinfo>
+
 #include "../src/actor.h"
+#include "../src/actor_batch.h"
 #include "../src/director.h"
 
 using namespace ActorModel;
@@ -211,6 +218,75 @@ void test_compound_message(void) {
 }
 
 
+/*
+ * Test shared memory transport
+ */
+void test_shared_transport(void) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    int send_rank = (rank+1)%size;
+    int recv_rank = (rank-1+size)%size;
+
+    // Use a small ring, so messages are split up and have to wait
+    // for room.
+    SharedTransport::ring_bytes() = 256;
+    {
+        SharedTransport transport;
+
+        // The tests run on a single node
+        REQUIRE(transport.is_local(send_rank));
+
+        const int message_count = 50;
+        for(int i=0; i<message_count; i++) {
+            std::vector<int> data(i*10, i);
+            transport.send(
+                send_rank, i%3, &i, sizeof(int),
+                data.empty() ? NULL : &data[0], data.size()*sizeof(int)
+            );
+        }
+
+        // Messages arrive in the order they were sent. Keep receiving
+        // until this process's own messages have all been written, too.
+        CompoundMessage message;
+        int received = 0;
+        while(received < message_count || !transport.is_flushed()) {
+            if(!transport.receive(MPI_ANY_TAG, &message)) continue;
+
+            REQUIRE(message.source() == recv_rank);
+            REQUIRE(message.tag() == received%3);
+            REQUIRE(message.metadata<int>() == received);
+            REQUIRE(message.data_size<int>() == received*10);
+
+            std::vector<int> data(received*10);
+            if(!data.empty()) message.data<int>(&data[0], data.size());
+            REQUIRE(data == std::vector<int>(received*10, received));
+
+            received++;
+        }
+
+        REQUIRE(transport.in_flight() == 0);
+
+        // Messages are picked out by tag
+        int metadata = 0;
+        int data = 1;
+        transport.send(rank, 1, &metadata, sizeof(int), &data, sizeof(int));
+        data = 2;
+        transport.send(rank, 2, &metadata, sizeof(int), &data, sizeof(int));
+
+        REQUIRE(transport.receive(2, &message));
+        REQUIRE(message.data<int>() == 2);
+        REQUIRE(transport.receive(1, &message));
+        REQUIRE(message.data<int>() == 1);
+        REQUIRE(!transport.receive(MPI_ANY_TAG, &message));
+
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+    SharedTransport::ring_bytes() = 16384;
+}
+
+
 void test_global_ids(void) {
     MPI_Comm comm;
     MPI_Comm_dup(MPI_COMM_WORLD, &comm);
@@ -290,7 +366,7 @@ void test_actor_inheritance(void) {
 
 
 
-int checkTestActorFactory=0;
+ACTOR_RANK_LOCAL int checkTestActorFactory=0;
 
 class TestActorFactory1: public Actor {
     void main(void){}
@@ -556,27 +632,1427 @@ void test_actor_birth_and_death(void) {
 }
 
 
-int main(int argc, char* argv[]) {
-    Director::initialize(&argc, &argv);
-    Director::set_buffer_size(1000*sizeof(int));
+class TestGroupMember: public Actor {
+public:
+    void main(void) {
+        Message message;
 
-    INIT_SQT();
+        if(get_message(&message)) {
+            // Echo the message back to whoever sent it
+            int value = message.data<int>();
+            send_message<int>(message.sender(), value, message.tag());
 
-    RUN_TEST(test_message);
+            die();
+        }
+    }
+};
 
-    RUN_TEST(test_compound_message);
+class TestGroupManager: public Actor {
+public:
+    TestGroupManager():
+        initialized(false), received_count(0), tags_match(true), sum(0)
+    {}
 
-    RUN_TEST(test_global_ids);
+    void main(void) {
+        if(!initialized) {
+            for(int i=0; i<member_count; i++) {
+                group.add(give_birth<TestGroupMember>());
+            }
 
-    RUN_TEST(test_actor_inheritance);
+            send_to_group<int>(group, 7, 3);
 
-    RUN_TEST(test_actor_factory);
+            initialized = true;
+        }
 
-    RUN_TEST(test_distributed_factory);
+        Message message;
+        while(get_message(&message)) {
+            tags_match &= (message.tag() == 3);
+            sum += message.data<int>();
+            received_count++;
+        }
 
-    RUN_TEST(test_actor_communication);
+        if(received_count == member_count) die();
+    }
 
-    RUN_TEST(test_actor_birth_and_death);
+    bool initialized;
+    Group group;
+    int member_count;
 
-    Director::finalize();
+    int received_count;
+    bool tags_match;
+    int sum;
+};
+
+
+void test_group_messaging(void) {
+    Director director;
+
+    director.register_actor<TestGroupMember>();
+
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    int member_count = 5*size;
+
+    TestGroupManager *actor;
+
+    if(director.is_root()) {
+        actor = director.add_actor<TestGroupManager>();
+        actor->member_count = member_count;
+    }
+
+    director.run();
+
+    if(director.is_root()) {
+        REQUIRE(actor->received_count == member_count);
+        REQUIRE(actor->tags_match);
+        REQUIRE(actor->sum == 7*member_count);
+    }
+}
+
+
+class TestCollectiveMember: public Actor {
+public:
+    void main(void) {
+        Message message;
+
+        if(get_message(&message)) {
+            // Contribute this actor's gid, times the requested factor
+            int factor = message.data<int>();
+            contribute<int>(message, factor*id().gid());
+
+            die();
+        }
+    }
+};
+
+class TestCollectiveManager: public Actor {
+public:
+    TestCollectiveManager():
+        initialized(false), gathered(false), reduced(false)
+    {}
+
+    enum { GATHER, REDUCE };
+
+    void main(void) {
+        if(!initialized) {
+            for(int i=0; i<member_count; i++) {
+                gather_group_ids.add(give_birth<TestCollectiveMember>());
+                reduce_group_ids.add(give_birth<TestCollectiveMember>());
+            }
+
+            gather_group<int>(gather_group_ids, 2, 0, GATHER);
+            reduce_group<Sum<int>, int>(reduce_group_ids, 3, 0, REDUCE);
+
+            initialized = true;
+        }
+
+        Message message;
+        while(get_message(&message)) {
+            switch(message.tag()) {
+                case GATHER: {
+                    gather_result.resize(message.data_size<int>());
+                    message.data<int>(
+                        &gather_result[0], gather_result.size()
+                    );
+
+                    gathered = true;
+                } break;
+
+                case REDUCE: {
+                    reduce_result = message.data<int>();
+
+                    reduced = true;
+                } break;
+            }
+        }
+
+        if(gathered && reduced) die();
+    }
+
+    bool initialized;
+    int member_count;
+
+    Group gather_group_ids;
+    Group reduce_group_ids;
+
+    bool gathered;
+    std::vector<int> gather_result;
+
+    bool reduced;
+    int reduce_result;
+};
+
+
+void test_group_collectives(void) {
+    Director director;
+
+    director.register_actor<TestCollectiveMember>();
+    director.register_reduction<Sum<int> >();
+
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    TestCollectiveManager *actor;
+
+    if(director.is_root()) {
+        actor = director.add_actor<TestCollectiveManager>();
+        actor->member_count = 5*size;
+    }
+
+    director.run();
+
+    if(director.is_root()) {
+        Group& gather_group = actor->gather_group_ids;
+        Group& reduce_group = actor->reduce_group_ids;
+
+        // Gathered values should arrive in group order
+        REQUIRE(actor->gathered);
+        REQUIRE(actor->gather_result.size() == gather_group.size());
+        for(size_t i=0; i<gather_group.size(); i++) {
+            REQUIRE(actor->gather_result[i] == 2*gather_group[i].gid());
+        }
+
+        int expected_sum = 0;
+        for(size_t i=0; i<reduce_group.size(); i++) {
+            expected_sum += 3*reduce_group[i].gid();
+        }
+
+        REQUIRE(actor->reduced);
+        REQUIRE(actor->reduce_result == expected_sum);
+    }
+}
+
+
+// Number of requests each kind of ask sends
+/*
+ * A sender sends arrays of 3 values to a receiver on the last rank
+ * over a channel, which should arrive whole and in order.
+ */
+const int channel_message_count = 100;
+
+// The number of channel messages received in order on this process.
+ACTOR_RANK_LOCAL int channel_received = 0;
+
+class TestChannelReceiver: public Actor {
+public:
+    enum { VALUES };
+
+    void main(void) {
+        Message message;
+        while(get_message(&message)) {
+            int values[3];
+            message.data<int>(values, 3);
+
+            if(
+                message.tag() == VALUES && message.data_size<int>() == 3
+                && values[0] == channel_received
+                && values[1] == 2*channel_received
+                && values[2] == 3*channel_received
+            ) {
+                channel_received++;
+            }
+
+            if(channel_received == channel_message_count) die();
+        }
+
+        wait_for_message();
+    }
+};
+
+class TestChannelSender: public Actor {
+public:
+    TestChannelSender(): sent(0) {}
+
+    void main(void) {
+        if(sent == 0) {
+            int size;
+            MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+            receiver = give_birth<TestChannelReceiver>(size - 1);
+        }
+
+        if(!channel.is_open()) {
+            channel = open_channel<int>(
+                receiver, TestChannelReceiver::VALUES, 3
+            );
+        }
+
+        // Send one message per tick, reusing the channel each time
+        int values[3] = {sent, 2*sent, 3*sent};
+        channel.send(values);
+
+        sent++;
+        if(sent == channel_message_count) die();
+
+        // Messages sent before a channel is closed still arrive
+        if(sent == channel_message_count/2) {
+            close_channel(channel);
+            REQUIRE(!channel.is_open());
+        }
+    }
+
+    Id receiver;
+    Channel<int> channel;
+    int sent;
+};
+
+
+void test_channels(void) {
+    // Send through MPI, rather than shared memory, so the channel
+    // uses persistent sends.
+    Director::set_shared_ring_size(0);
+
+    channel_received = 0;
+    {
+        Director director;
+        director.register_actor<TestChannelReceiver>();
+
+        if(director.is_root()) director.add_actor<TestChannelSender>();
+
+        director.run();
+    }
+
+    int received;
+    MPI_Allreduce(
+        &channel_received, &received, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD
+    );
+    REQUIRE(received == channel_message_count);
+
+    Director::set_shared_ring_size(16384);
+}
+
+
+ACTOR_RANK_LOCAL int ask_request_count = 20;
+
+class TestAskResponder: public Actor {
+public:
+    TestAskResponder(): answered(0) {}
+
+    void main(void) {
+        Message message;
+
+        while(get_message(&message)) {
+            REQUIRE(message.is_request());
+
+            // Reply with double the request
+            reply<int>(message, 2*message.data<int>());
+            answered++;
+        }
+
+        if(answered == 2*ask_request_count) die();
+    }
+
+    int answered;
+};
+
+class TestAskManager: public Actor {
+public:
+    TestAskManager():
+        initialized(false), unexpected_message(false),
+        handled_count(0), handled_sum(0)
+    {}
+
+    enum { DOUBLE };
+
+    void main(void) {
+        if(!initialized) {
+            responder = give_birth<TestAskResponder>();
+
+            // Pipeline all requests without waiting for any replies
+            for(int i=0; i<ask_request_count; i++) {
+                futures.push_back(ask<int>(responder, i, DOUBLE));
+                ask(responder, i, DOUBLE, &TestAskManager::handle_reply);
+            }
+
+            initialized = true;
+        }
+
+        // No reply should be returned as a regular message
+        Message message;
+        while(get_message(&message)) {
+            unexpected_message = true;
+        }
+
+        bool all_ready = true;
+        for(size_t i=0; i<futures.size(); i++) {
+            all_ready &= futures[i].ready();
+        }
+
+        if(all_ready && handled_count == ask_request_count) {
+            for(size_t i=0; i<futures.size(); i++) {
+                future_results.push_back(futures[i].get());
+            }
+
+            die();
+        }
+    }
+
+    void handle_reply(int value) {
+        handled_count++;
+        handled_sum += value;
+    }
+
+    bool initialized;
+    Id responder;
+    bool unexpected_message;
+
+    std::vector<Future<int> > futures;
+    std::vector<int> future_results;
+
+    int handled_count;
+    int handled_sum;
+};
+
+
+void test_ask(void) {
+    Director director;
+
+    director.register_actor<TestAskResponder>();
+
+    int count = ask_request_count;
+
+    TestAskManager *actor;
+
+    if(director.is_root()) {
+        actor = director.add_actor<TestAskManager>();
+    }
+
+    director.run();
+
+    if(director.is_root()) {
+        REQUIRE(!actor->unexpected_message);
+
+        REQUIRE(actor->future_results.size() == static_cast<size_t>(count));
+        for(int i=0; i<count; i++) {
+            REQUIRE(actor->future_results[i] == 2*i);
+        }
+
+        REQUIRE(actor->handled_count == count);
+        REQUIRE(actor->handled_sum == count*(count-1));
+    }
+}
+
+
+void run_exchange(Exchange::Mode mode) {
+    // Send through MPI, rather than shared memory, so messages
+    // between processes are staged for the exchange.
+    Director::set_shared_ring_size(0);
+
+    channel_received = 0;
+    {
+        Director director;
+        director.register_actor<TestChannelReceiver>();
+        director.register_actor<TestAskResponder>();
+        director.set_exchange_mode(mode);
+
+        TestAskManager *ask_manager;
+        if(director.is_root()) {
+            director.add_actor<TestChannelSender>();
+            ask_manager = director.add_actor<TestAskManager>();
+        }
+
+        director.run();
+
+        // Messages sent through the exchange arrive whole and in order
+        if(director.is_root()) {
+            REQUIRE(!ask_manager->unexpected_message);
+            REQUIRE(ask_manager->handled_count == ask_request_count);
+            REQUIRE(
+                ask_manager->future_results.size()
+                == static_cast<size_t>(ask_request_count)
+            );
+        }
+
+        // The graph is only built as new processes are sent to
+        int size;
+        MPI_Comm_size(MPI_COMM_WORLD, &size);
+        REQUIRE(director.get_exchange().graph_builds() <= size);
+    }
+
+    int received;
+    MPI_Allreduce(
+        &channel_received, &received, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD
+    );
+    REQUIRE(received == channel_message_count);
+
+    Director::set_shared_ring_size(16384);
+}
+
+void test_exchange(void) {
+    run_exchange(Exchange::DIRECT);
+
+    // Pretend every two processes share a node, so there's more
+    // than one node to route between
+    Exchange::ranks_per_node() = 2;
+    run_exchange(Exchange::THROUGH_LEADERS);
+    Exchange::ranks_per_node() = 0;
+}
+
+
+void test_reorder_by_traffic(void) {
+    int rank;
+    int size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Profile which processes talk to each other
+    std::vector<long> traffic;
+    channel_received = 0;
+    {
+        Director director;
+        director.register_actor<TestChannelReceiver>();
+
+        if(director.is_root()) director.add_actor<TestChannelSender>();
+
+        director.run();
+
+        traffic = director.get_traffic();
+    }
+
+    REQUIRE(traffic.size() == static_cast<size_t>(size));
+    if(rank == 0) {
+        REQUIRE(
+            traffic[size-1]
+            == static_cast<long>(channel_message_count*3*sizeof(int))
+        );
+    }
+
+    // Run again with the processes placed by traffic
+    MPI_Comm reordered = Director::reorder_by_traffic(MPI_COMM_WORLD, traffic);
+
+    int reordered_size;
+    MPI_Comm_size(reordered, &reordered_size);
+    REQUIRE(reordered_size == size);
+
+    channel_received = 0;
+    {
+        Director director(reordered);
+        director.register_actor<TestChannelReceiver>();
+
+        if(director.is_root()) director.add_actor<TestChannelSender>();
+
+        director.run();
+    }
+
+    int received;
+    MPI_Allreduce(
+        &channel_received, &received, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD
+    );
+    REQUIRE(received == channel_message_count);
+
+    MPI_Comm_free(&reordered);
+}
+
+
+/*
+ * Actor placement tests
+ */
+const int placement_pair_count = 4;
+const int placement_message_count = 10;
+
+// Messages between pairs that crossed processes, seen on this process.
+ACTOR_RANK_LOCAL int placement_crossings = 0;
+
+class TestPlacementReceiver: public Actor {
+public:
+    TestPlacementReceiver(): received(0) {}
+
+    void main(void) {
+        int rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+        Message message;
+        while(get_message(&message)) {
+            if(message.sender().process() != rank) placement_crossings++;
+
+            received++;
+            if(received == placement_message_count) {
+                die();
+                return;
+            }
+        }
+
+        wait_for_message();
+    }
+
+    int received;
+};
+
+class TestPlacementSender: public Actor {
+public:
+    void main(void) {
+        Message message;
+        if(!get_message(&message)) {
+            wait_for_message();
+            return;
+        }
+
+        Id receiver = message.data<Id>();
+        for(int i=0; i<placement_message_count; i++) {
+            send_message<int>(receiver, i, 0);
+        }
+
+        die();
+    }
+};
+
+// Give birth to pairs of actors which talk to each other and to
+// nothing else, left to be placed by the director.
+class TestPlacementParent: public Actor {
+public:
+    void main(void) {
+        for(int i=0; i<placement_pair_count; i++) {
+            Id sender = give_birth<TestPlacementSender>();
+            Id receiver = give_birth<TestPlacementReceiver>();
+
+            send_message<Id>(sender, receiver, 0);
+        }
+
+        die();
+    }
+};
+
+int run_placement(bool is_profiling, std::string const& read_path) {
+    placement_crossings = 0;
+    {
+        Director director;
+        director.register_actor<TestPlacementSender>();
+        director.register_actor<TestPlacementReceiver>();
+
+        director.set_placement_profiling(is_profiling);
+        if(!read_path.empty()) REQUIRE(director.read_placement(read_path));
+
+        if(director.is_root()) director.add_actor<TestPlacementParent>();
+
+        director.run();
+
+        if(is_profiling) {
+            REQUIRE(director.write_placement("actor_test.placement"));
+        }
+    }
+
+    int crossings;
+    MPI_Allreduce(
+        &placement_crossings, &crossings, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD
+    );
+
+    return crossings;
+}
+
+void test_placement(void) {
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Balanced births put each pair on different processes
+    int crossings = run_placement(true, "");
+    if(size > 1) {
+        REQUIRE(crossings == placement_pair_count*placement_message_count);
+    }
+
+    if(super_quick_test_rank == 0) {
+        std::ifstream in("actor_test.placement");
+        std::string placement(
+            (std::istreambuf_iterator<char>(in)),
+            std::istreambuf_iterator<char>()
+        );
+        REQUIRE(placement.find("TestPlacementSender") != std::string::npos);
+    }
+
+    // Births placed by the profile keep each pair together
+    REQUIRE(run_placement(false, "actor_test.placement") == 0);
+
+    // Lineages are the same in every run, so the placement
+    // still applies
+    Placement placement;
+    REQUIRE(placement.read("actor_test.placement"));
+    REQUIRE(placement.size() == 1 + 2*placement_pair_count);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    if(super_quick_test_rank == 0) std::remove("actor_test.placement");
+}
+
+void test_partition(void) {
+    // Two triangles joined by a light edge, split in two
+    std::vector<Placement::Edge> edges;
+    int ends[7][2] = {{0,1}, {1,2}, {2,0}, {3,4}, {4,5}, {5,3}, {2,3}};
+    for(int i=0; i<7; i++) {
+        Placement::Edge edge;
+        edge.from = ends[i][0];
+        edge.to = ends[i][1];
+        edge.weight = (i == 6 ? 1 : 100);
+        edges.push_back(edge);
+    }
+
+    // Keep the second triangle on part 0
+    std::vector<int> fixed(6, -1);
+    fixed[4] = 0;
+
+    std::vector<int> part = Placement::partition(6, edges, fixed, 2);
+    REQUIRE(part[3] == 0 && part[4] == 0 && part[5] == 0);
+    REQUIRE(part[0] == 1 && part[1] == 1 && part[2] == 1);
+}
+
+
+/*
+ * Flow control tests
+ */
+const int flow_window = 8;
+const int flow_message_count = 200;
+
+// The most messages a consumer had waiting in its mailbox, and how
+// many it took, on this process.
+ACTOR_RANK_LOCAL int flow_most_waiting = 0;
+ACTOR_RANK_LOCAL int flow_received = 0;
+
+// Times a producer was told a send would be held, on this process.
+ACTOR_RANK_LOCAL int flow_would_block = 0;
+
+// How many messages a producer had sent when it was first told the
+// mailbox was full, on this process.
+ACTOR_RANK_LOCAL int flow_first_full = 0;
+
+// A slow consumer, taking one message each run.
+class TestFlowConsumer: public Actor {
+public:
+    void main(void) {
+        flow_most_waiting =
+            std::max(flow_most_waiting, static_cast<int>(mailbox_size()));
+
+        Message message;
+        if(!get_message(&message)) {
+            wait_for_message();
+            return;
+        }
+
+        flow_received++;
+        if(flow_received == flow_message_count) die();
+    }
+};
+
+class TestFlowProducer: public Actor {
+public:
+    enum Mode { FLOOD, TRY, FLOOD_GROUP };
+
+    TestFlowProducer(): mode(FLOOD), has_consumer(false), sent(0) {}
+
+    void main(void) {
+        if(!has_consumer) {
+            int size;
+            MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+            consumer = give_birth<TestFlowConsumer>(size-1);
+            group.add(consumer);
+            has_consumer = true;
+        }
+
+        // Either send until the mailbox is full and be held up, or
+        // send what can be sent each run
+        while(sent < flow_message_count) {
+            if(mode == TRY) {
+                if(!try_send_message<int>(consumer, sent, 0)) {
+                    flow_would_block++;
+                    return;
+                }
+            } else {
+                try {
+                    if(mode == FLOOD) {
+                        send_message<int>(consumer, sent, 0);
+                    } else {
+                        send_to_group<int>(group, &sent, 1, 0);
+                    }
+                } catch(MailboxFull&) {
+                    if(flow_first_full == 0) flow_first_full = sent;
+                    return;
+                }
+            }
+
+            sent++;
+        }
+
+        die();
+    }
+
+    Mode mode;
+    bool has_consumer;
+    int sent;
+    Id consumer;
+    Group group;
+};
+
+void run_flow_control(TestFlowProducer::Mode mode) {
+    flow_most_waiting = 0;
+    flow_received = 0;
+    flow_would_block = 0;
+    flow_first_full = 0;
+    {
+        Director director;
+        director.register_actor<TestFlowConsumer>();
+
+        if(director.is_root()) {
+            director.add_actor<TestFlowProducer>()->mode = mode;
+        }
+
+        director.run();
+    }
+
+    int results[4] = {
+        flow_most_waiting, flow_received, flow_would_block, flow_first_full
+    };
+    int totals[4];
+    MPI_Allreduce(results, totals, 4, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+    REQUIRE(totals[0] <= flow_window);
+    REQUIRE(totals[1] == flow_message_count);
+    REQUIRE((mode == TestFlowProducer::TRY) == (totals[2] > 0));
+
+    // A window is sent and another held before the mailbox is full
+    if(mode != TestFlowProducer::TRY) {
+        REQUIRE(totals[3] == 2*flow_window);
+    }
+}
+
+void test_flow_control(void) {
+    Director::set_mailbox_window(flow_window);
+
+    run_flow_control(TestFlowProducer::FLOOD);
+    run_flow_control(TestFlowProducer::TRY);
+    run_flow_control(TestFlowProducer::FLOOD_GROUP);
+
+    Director::set_mailbox_window(0);
+}
+
+
+/*
+ * Dead letter tests
+ */
+const int dead_letter_count = 10;
+
+// Takes one message and dies, leaving the rest as dead letters.
+class TestShortLived: public Actor {
+public:
+    void main(void) {
+        Message message;
+        if(get_message(&message)) {
+            die();
+        } else {
+            wait_for_message();
+        }
+    }
+};
+
+class TestDeadLetterSender: public Actor {
+public:
+    void main(void) {
+        int size;
+        MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+        Id short_lived = give_birth<TestShortLived>(size-1);
+        for(int i=0; i<dead_letter_count; i++) {
+            send_message<int>(short_lived, i, 0);
+        }
+
+        die();
+    }
+};
+
+long run_dead_letters(void) {
+    long dead_letters;
+    {
+        Director director;
+        director.register_actor<TestShortLived>();
+
+        if(director.is_root()) director.add_actor<TestDeadLetterSender>();
+
+        director.run();
+
+        long local = director.get_rank_counters().dead_letters;
+        MPI_Allreduce(
+            &local, &dead_letters, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD
+        );
+    }
+
+    return dead_letters;
+}
+
+void test_dead_letters(void) {
+    REQUIRE(run_dead_letters() == dead_letter_count-1);
+
+    // Dropped messages hand back their credit, so a sender held up
+    // on an actor that has died still finishes. Half the letters are
+    // held, which is as many as the window lets a sender hold.
+    Director::set_mailbox_window(dead_letter_count/2);
+    REQUIRE(run_dead_letters() == dead_letter_count-1);
+    Director::set_mailbox_window(0);
+}
+
+
+class TestWaitingActor: public Actor {
+public:
+    TestWaitingActor(): run_count(0) {}
+
+    void main(void) {
+        run_count++;
+
+        Message message;
+        if(get_message(&message)) {
+            die();
+        } else {
+            wait_for_message();
+        }
+    }
+
+    int run_count;
+};
+
+class TestWakingActor: public Actor {
+public:
+    TestWakingActor(): run_count(0) {}
+
+    void main(void) {
+        run_count++;
+
+        // Wake the waiting actor after a good while
+        if(run_count == 100) {
+            bool ignore = true;
+            send_message<bool>(waiting_actor, ignore, 0);
+
+            die();
+        }
+    }
+
+    Id waiting_actor;
+    int run_count;
+};
+
+
+void test_wait_for_message(void) {
+    Director director;
+
+    if(director.is_root()) {
+        TestWaitingActor *waiting = director.add_actor<TestWaitingActor>();
+        TestWakingActor *waking = director.add_actor<TestWakingActor>();
+
+        waking->waiting_actor = waiting->id();
+
+        director.run();
+
+        // Run once to start waiting, and once when woken
+        REQUIRE(waiting->is_dead());
+        REQUIRE(waiting->run_count == 2);
+    } else {
+        director.run();
+    }
+}
+
+
+class TestTimerActor: public Actor {
+public:
+    TestTimerActor():
+        initialized(false), run_count(0), tick_count(0), end_time(0.0)
+    {}
+
+    enum { ONCE, EVERY };
+
+    void main(void) {
+        run_count++;
+
+        if(!initialized) {
+            start_time = MPI_Wtime();
+
+            schedule_after(0.05, ONCE);
+            every_timer = schedule_every(0.01, EVERY);
+
+            initialized = true;
+        }
+
+        Message message;
+        while(get_message(&message)) {
+            switch(message.tag()) {
+                case EVERY: {
+                    REQUIRE(message.data<int>() == every_timer);
+                    tick_count++;
+                } break;
+
+                case ONCE: {
+                    end_time = MPI_Wtime();
+                    cancel_timer(every_timer);
+                    die();
+                } break;
+            }
+        }
+
+        wait_for_message();
+    }
+
+    bool initialized;
+    int every_timer;
+
+    int run_count;
+    int tick_count;
+
+    double start_time;
+    double end_time;
+};
+
+
+void test_timers(void) {
+    Director director;
+
+    if(director.is_root()) {
+        TestTimerActor *actor = director.add_actor<TestTimerActor>();
+
+        director.run();
+
+        REQUIRE(actor->is_dead());
+        REQUIRE(actor->end_time - actor->start_time >= 0.05);
+
+        // The periodic timer should have fired around 5 times
+        REQUIRE(actor->tick_count >= 3);
+
+        // The actor should only be run when a timer fires
+        REQUIRE(actor->run_count <= actor->tick_count + 2);
+    } else {
+        director.run();
+    }
+}
+
+
+/*
+ * Statistics tests
+ */
+class TestCounterActor: public Actor {
+public:
+    TestCounterActor(): received(0), metadata_bytes(0) {}
+
+    enum { COUNT };
+
+    void main(void) {
+        if(counters().runs == 0) {
+            for(int i=0; i<10; i++) {
+                send_message<int>(id(), i, COUNT);
+            }
+
+            return;
+        }
+
+        Message message;
+        while(get_message(&message)) {
+            received++;
+            metadata_bytes = message.metadata_size();
+        }
+
+        if(received == 10) die();
+    }
+
+    int received;
+    size_t metadata_bytes;
+};
+
+// A batch that messages its first member every run, and never dies.
+class TestCounterBatch: public ActorBatch {
+public:
+    void main(void) {
+        Message message;
+        size_t index;
+        while(get_member_message(&message, &index));
+
+        int ignore = 0;
+        send_message<int>(member_id(0), ignore, 0);
+    }
+
+    void remove_member_data(size_t) {}
+};
+
+
+void test_statistics(void) {
+    Director director;
+
+    TestCounterActor *actor = NULL;
+    if(director.is_root()) {
+        actor = director.add_actor<TestCounterActor>();
+    }
+
+    director.run();
+
+    if(director.is_root()) {
+        REQUIRE(actor->is_dead());
+
+        ActorCounters const& counters = actor->counters();
+        REQUIRE(counters.messages_sent == 10);
+        REQUIRE(counters.bytes_sent == 10*sizeof(int));
+        REQUIRE(counters.messages_received == 10);
+        REQUIRE(counters.bytes_received == 10*sizeof(int));
+        REQUIRE(counters.runs >= 2);
+        REQUIRE(counters.empty_polls >= 1);
+
+        // Untimed messages don't carry a send time
+        REQUIRE(actor->metadata_bytes == sizeof(Actor::Message::MetaData));
+
+        Statistics statistics = director.get_statistics();
+        ActorCounters& type_counters =
+            statistics.type(typeid(TestCounterActor).name());
+        REQUIRE(type_counters.births == 1);
+        REQUIRE(type_counters.deaths == 1);
+        REQUIRE(type_counters.messages_sent == 10);
+    }
+
+    RankCounters const& rank_counters = director.get_rank_counters();
+    REQUIRE(rank_counters.ticks > 0);
+    REQUIRE(rank_counters.sync_probes > 0);
+
+    std::ostringstream summary;
+    director.print_statistics(summary);
+
+    if(director.is_root()) {
+        REQUIRE(summary.str().find("TestCounterActor") != std::string::npos);
+    } else {
+        REQUIRE(summary.str().empty());
+    }
+}
+
+void test_batch_statistics(void) {
+    TestCounterBatch *batch = NULL;
+    {
+        Director director;
+
+        if(director.is_root()) {
+            batch = director.add_actor<TestCounterBatch>();
+            for(int i=0; i<3; i++) batch->add_member();
+        }
+
+        director.run(5);
+
+        // A batch is counted once, not again for each of its members
+        if(director.is_root()) {
+            REQUIRE(batch->counters().runs == 5);
+
+            Statistics statistics = director.get_statistics();
+            ActorCounters& type_counters =
+                statistics.type(typeid(TestCounterBatch).name());
+            REQUIRE(type_counters.runs == 5);
+            REQUIRE(type_counters.messages_sent == 5);
+        }
+    }
+    delete batch;
+}
+
+
+void test_message_timing(void) {
+    Director::set_message_timing(true);
+    {
+        Director director;
+
+        TestCounterActor *actor = NULL;
+        if(director.is_root()) {
+            actor = director.add_actor<TestCounterActor>();
+        }
+
+        director.run();
+
+        if(director.is_root()) {
+            REQUIRE(
+                actor->metadata_bytes
+                == sizeof(Actor::Message::TimedMetaData)
+            );
+
+            Statistics statistics = director.get_statistics();
+            Latency& latency = statistics.latency(
+                typeid(TestCounterActor).name(), TestCounterActor::COUNT
+            );
+
+            // Messages are taken no sooner than they arrive
+            REQUIRE(latency.delivery.count() == 10);
+            REQUIRE(latency.queueing.count() == 10);
+            REQUIRE(latency.delivery.max() >= latency.queueing.max());
+            REQUIRE(latency.delivery.min() >= 0.0);
+        }
+
+        std::ostringstream summary;
+        director.print_statistics(summary);
+
+        if(director.is_root()) {
+            REQUIRE(summary.str().find("latency") != std::string::npos);
+        }
+    }
+    Director::set_message_timing(false);
+}
+
+void test_histogram(void) {
+    // 1 to 1000 microseconds
+    Histogram histogram;
+    for(int i=1; i<=1000; i++) histogram.record(i*1e-6);
+
+    REQUIRE(histogram.count() == 1000);
+    REQUIRE(histogram.min() == 1e-6);
+    REQUIRE(histogram.max() == 1e-3);
+
+    // Percentiles are within a bucket of the true value
+    REQUIRE(histogram.percentile(50) >= 500e-6);
+    REQUIRE(histogram.percentile(50) <= 500e-6*1.07);
+    REQUIRE(histogram.percentile(99) >= 990e-6);
+    REQUIRE(histogram.percentile(100) == 1e-3);
+
+    // Histograms add, including through packing
+    std::vector<char> buffer;
+    histogram.pack(buffer);
+
+    size_t offset = 0;
+    Histogram unpacked = Histogram::unpack(buffer, &offset);
+    REQUIRE(offset == buffer.size());
+
+    unpacked.add(histogram);
+    REQUIRE(unpacked.count() == 2000);
+    REQUIRE(unpacked.percentile(50) == histogram.percentile(50));
+}
+
+
+/*
+ * Actor batch tests
+ */
+class TestBatch: public ActorBatch {
+public:
+    TestBatch(): run_count(0) {}
+
+    enum { ADD, ACK, STOP };
+
+    // Add a member along with its fields
+    size_t add(void) {
+        size_t index = add_member();
+        values.push_back(0);
+
+        return index;
+    }
+
+    void main(void) {
+        run_count++;
+
+        Message message;
+        size_t index;
+        while(get_member_message(&message, &index)) {
+            if(message.tag() == STOP) {
+                die();
+                return;
+            }
+
+            values[index] += message.data<int>();
+            send_member_message<int>(index, message.sender(), index, ACK);
+        }
+
+        wait_for_message();
+    }
+
+    void remove_member_data(size_t index) {
+        values[index] = values.back();
+        values.pop_back();
+    }
+
+    int run_count;
+    std::vector<int> values;
+};
+
+class TestBatchSender: public Actor {
+public:
+    TestBatchSender(): sent(false), acks(0), senders_match(true) {}
+
+    void main(void) {
+        if(!sent) {
+            for(size_t i=0; i<members.size(); i++) {
+                send_message<int>(members[i], i+1, TestBatch::ADD);
+            }
+            sent = true;
+        }
+
+        Message message;
+        while(get_message(&message)) {
+            int index = message.data<int>();
+
+            senders_match &= (message.sender().gid() == members[index].gid());
+            acks++;
+        }
+
+        if(acks == static_cast<int>(members.size())) {
+            bool stop = true;
+            send_message<bool>(members[0], stop, TestBatch::STOP);
+            die();
+        }
+    }
+
+    std::vector<Id> members;
+
+    bool sent;
+    int acks;
+    bool senders_match;
+};
+
+// Removes its second member on its first run, then waits to be stopped.
+class TestShrinkingBatch: public ActorBatch {
+public:
+    enum { STOP };
+
+    void main(void) {
+        if(size() == 2) remove_member(1);
+
+        Message message;
+        size_t index;
+        while(get_member_message(&message, &index)) {
+            if(message.tag() == STOP) {
+                die();
+                return;
+            }
+        }
+
+        wait_for_message();
+    }
+};
+
+// Messages the removed member, then stops the batch.
+class TestShrinkingSender: public Actor {
+public:
+    TestShrinkingSender(): run_count(0) {}
+
+    void main(void) {
+        run_count++;
+        if(run_count < 10) return;
+
+        int ignore = 0;
+        send_message<int>(removed, ignore, 0);
+
+        bool stop = true;
+        send_message<bool>(kept, stop, TestShrinkingBatch::STOP);
+
+        die();
+    }
+
+    Id kept;
+    Id removed;
+    int run_count;
+};
+
+
+void test_actor_batch(void) {
+    Director director;
+
+    if(director.is_root()) {
+        TestBatch *batch = director.add_actor<TestBatch>();
+        TestBatchSender *sender = director.add_actor<TestBatchSender>();
+
+        for(int i=0; i<8; i++) {
+            size_t index = batch->add();
+            sender->members.push_back(batch->member_id(index));
+        }
+
+        director.run();
+
+        // Every member should have been messaged individually,
+        // and answered as itself
+        REQUIRE(batch->is_dead());
+        REQUIRE(sender->acks == 8);
+        REQUIRE(sender->senders_match);
+        for(int i=0; i<8; i++) {
+            REQUIRE(batch->values[i] == i+1);
+        }
+
+        // Removing a member moves the last member into its place
+        int last_gid = batch->member_id(7).gid();
+        int removed_gid = batch->member_id(2).gid();
+
+        batch->remove_member(2);
+
+        REQUIRE(batch->size() == 7);
+        REQUIRE(batch->member_index(removed_gid) == -1);
+        REQUIRE(batch->member_index(last_gid) == 2);
+        REQUIRE(batch->values[2] == 8);
+    } else {
+        director.run();
+    }
+
+    // A removed member is dead, so messages for it are dropped
+    {
+        Director shrinking_director;
+
+        if(shrinking_director.is_root()) {
+            TestShrinkingBatch *batch =
+                shrinking_director.add_actor<TestShrinkingBatch>();
+            TestShrinkingSender *sender =
+                shrinking_director.add_actor<TestShrinkingSender>();
+
+            sender->kept = batch->member_id(batch->add_member());
+            sender->removed = batch->member_id(batch->add_member());
+
+            shrinking_director.run();
+
+            REQUIRE(batch->is_dead());
+            REQUIRE(shrinking_director.get_rank_counters().dead_letters == 1);
+        } else {
+            shrinking_director.run();
+        }
+    }
+}
+
+
+int run_tests(int argc, char* argv[]) {
+    Director::initialize(&argc, &argv);
+    Director::set_buffer_size(1000*sizeof(int));
+
+    INIT_SQT();
+
+    RUN_TEST(test_message);
+
+    RUN_TEST(test_compound_message);
+
+    RUN_TEST(test_shared_transport);
+
+    RUN_TEST(test_global_ids);
+
+    RUN_TEST(test_actor_inheritance);
+
+    RUN_TEST(test_actor_factory);
+
+    RUN_TEST(test_distributed_factory);
+
+    RUN_TEST(test_actor_communication);
+
+    RUN_TEST(test_actor_birth_and_death);
+
+    RUN_TEST(test_group_messaging);
+
+    RUN_TEST(test_group_collectives);
+
+    RUN_TEST(test_channels);
+
+    RUN_TEST(test_ask);
+
+    RUN_TEST(test_exchange);
+
+    RUN_TEST(test_reorder_by_traffic);
+
+    RUN_TEST(test_placement);
+
+    RUN_TEST(test_partition);
+
+    RUN_TEST(test_flow_control);
+
+    RUN_TEST(test_dead_letters);
+
+    RUN_TEST(test_wait_for_message);
+
+    RUN_TEST(test_timers);
+
+    RUN_TEST(test_statistics);
+    RUN_TEST(test_batch_statistics);
+
+    RUN_TEST(test_message_timing);
+
+    RUN_TEST(test_histogram);
+
+    RUN_TEST(test_actor_batch);
+
+    Director::finalize();
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    return run_ranks(run_tests, argc, argv);
 }
@@ -0,0 +1,204 @@
+#include "./super_quick_test.h"
+
+#include <cstdio>
+
+#include "../src/director.h"
+
+using namespace ActorModel;
+
+
+/*
+ * Two actors, on different ranks where possible, pass a count back
+ * and forth until it reaches a limit. A checkpoint is taken part way,
+ * and restarting from it should finish the count as if the run had
+ * never stopped, on the same or a different number of processes.
+ */
+
+const int count_limit = 200;
+
+// The count seen by the actor that finished it on this process.
+ACTOR_RANK_LOCAL int final_count = 0;
+
+class TestCheckpointPingPong: public Actor {
+public:
+    TestCheckpointPingPong(): is_first(false), has_started(false) {}
+
+    void main(void) {
+        if(is_first && !has_started) {
+            int size;
+            MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+            Id partner = give_birth<TestCheckpointPingPong>(1 % size);
+            send_message<int>(partner, 0, 0);
+            has_started = true;
+        }
+
+        Message message;
+        while(get_message(&message)) {
+            int count = message.data<int>();
+
+            if(count >= count_limit) {
+                final_count = count;
+                die();
+                return;
+            }
+
+            send_message<int>(message.sender(), count+1, 0);
+
+            if(count+1 >= count_limit) {
+                die();
+                return;
+            }
+        }
+
+        wait_for_message();
+    }
+
+    bool save(CheckpointWriter& out) {
+        out.write(is_first);
+        out.write(has_started);
+
+        return true;
+    }
+
+    void restore(CheckpointReader& in) {
+        in.read(is_first);
+        in.read(has_started);
+    }
+
+    bool is_first;
+    bool has_started;
+};
+
+// An actor that doesn't opt in to checkpoints.
+class TestNoCheckpoint: public Actor {
+public:
+    void main(void) {
+        wait_for_message();
+    }
+};
+
+
+char const *checkpoint_file = "checkpoint_test.ckpt";
+
+// The largest final count over every process.
+int global_final_count(void) {
+    int global_count;
+    MPI_Allreduce(
+        &final_count, &global_count, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD
+    );
+
+    return global_count;
+}
+
+void test_checkpoint_restart(void) {
+    // Run part way and take a checkpoint
+    final_count = 0;
+    {
+        Director director;
+        director.register_actor<TestCheckpointPingPong>();
+
+        if(director.is_root()) {
+            director.add_actor<TestCheckpointPingPong>()->is_first = true;
+        }
+
+        director.run(20);
+
+        REQUIRE(director.checkpoint(checkpoint_file));
+        REQUIRE(director.get_global_load() == 2);
+
+        director.run();
+    }
+    REQUIRE(global_final_count() == count_limit);
+
+    // Restart on the same processes
+    final_count = 0;
+    {
+        Director director;
+        director.register_actor<TestCheckpointPingPong>();
+
+        REQUIRE(director.restart(checkpoint_file));
+        REQUIRE(director.get_global_load() == 2);
+
+        director.run();
+    }
+    REQUIRE(global_final_count() == count_limit);
+
+    // Restart everything on the root alone
+    final_count = 0;
+    if(super_quick_test_rank == 0) {
+        Director director(MPI_COMM_SELF);
+        director.register_actor<TestCheckpointPingPong>();
+
+        REQUIRE(director.restart(checkpoint_file));
+        REQUIRE(director.get_load() == 2);
+
+        director.run();
+    }
+    REQUIRE(global_final_count() == count_limit);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    if(super_quick_test_rank == 0) std::remove(checkpoint_file);
+}
+
+void test_periodic_checkpoint(void) {
+    // Run part way, taking a checkpoint every tick, and stop
+    final_count = 0;
+    {
+        Director director;
+        director.register_actor<TestCheckpointPingPong>();
+        director.set_checkpoint_interval(checkpoint_file, 1e-9);
+
+        if(director.is_root()) {
+            director.add_actor<TestCheckpointPingPong>()->is_first = true;
+        }
+
+        director.run(20);
+    }
+    REQUIRE(global_final_count() == 0);
+
+    // Pick up from the last checkpoint
+    {
+        Director director;
+        director.register_actor<TestCheckpointPingPong>();
+
+        REQUIRE(director.restart(checkpoint_file));
+        director.run();
+    }
+    REQUIRE(global_final_count() == count_limit);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    if(super_quick_test_rank == 0) std::remove(checkpoint_file);
+}
+
+void test_checkpoint_refused(void) {
+    Director director;
+    director.register_actor<TestCheckpointPingPong>();
+    director.register_actor<TestNoCheckpoint>();
+
+    if(director.is_root()) director.add_actor<TestNoCheckpoint>();
+    director.run(2);
+
+    REQUIRE(!director.checkpoint(checkpoint_file));
+    REQUIRE(!director.restart(checkpoint_file));
+}
+
+
+int run_tests(int argc, char* argv[]) {
+    Director::initialize(&argc, &argv);
+    Director::set_buffer_size(100000);
+
+    INIT_SQT();
+
+    RUN_TEST(test_checkpoint_restart);
+    RUN_TEST(test_periodic_checkpoint);
+    RUN_TEST(test_checkpoint_refused);
+
+    Director::finalize();
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    return run_ranks(run_tests, argc, argv);
+}
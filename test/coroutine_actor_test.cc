@@ -0,0 +1,101 @@
+#include "./super_quick_test.h"
+
+#include "../src/coroutine_actor.h"
+#include "../src/director.h"
+
+using namespace ActorModel;
+
+
+class TestCoroutineEcho: public CoroutineActor {
+public:
+    enum { PING, STOP };
+
+    Task body(void) {
+        while(true) {
+            Message message = co_await receive();
+
+            if(message.tag() == STOP) break;
+
+            // Answer pings with one more than was sent
+            reply<int>(message, message.data<int>() + 1);
+        }
+    }
+};
+
+class TestCoroutineClient: public CoroutineActor {
+public:
+    TestCoroutineClient(): sum(0), tags_in_order(false) {}
+
+    enum { FIRST=10, SECOND };
+
+    Task body(void) {
+        Id echo = give_birth<TestCoroutineEcho>();
+
+        // Each ask suspends the body until its reply arrives
+        for(int i=0; i<ping_count; i++) {
+            sum += co_await ask<int>(echo, i, TestCoroutineEcho::PING);
+        }
+
+        bool ignore = true;
+        send_message<bool>(echo, ignore, TestCoroutineEcho::STOP);
+
+        // Receive by tag, out of the order the messages were sent in
+        Id me = id();
+        send_message<int>(me, 2, SECOND);
+        send_message<int>(me, 1, FIRST);
+
+        Message first = co_await receive(FIRST);
+        Message second = co_await receive(SECOND);
+
+        tags_in_order = (first.data<int>() == 1 && second.data<int>() == 2);
+    }
+
+    int ping_count;
+    int sum;
+    bool tags_in_order;
+};
+
+
+void test_coroutine_actor(void) {
+    Director director;
+
+    director.register_actor<TestCoroutineEcho>();
+
+    int ping_count = 10;
+
+    TestCoroutineClient *actor;
+
+    if(director.is_root()) {
+        actor = director.add_actor<TestCoroutineClient>();
+        actor->ping_count = ping_count;
+    }
+
+    director.run();
+
+    if(director.is_root()) {
+        REQUIRE(actor->is_dead());
+
+        // sum of i+1 for i in [0, ping_count)
+        REQUIRE(actor->sum == ping_count*(ping_count+1)/2);
+
+        REQUIRE(actor->tags_in_order);
+    }
+}
+
+
+int run_tests(int argc, char* argv[]) {
+    Director::initialize(&argc, &argv);
+    Director::set_buffer_size(1000*sizeof(int));
+
+    INIT_SQT();
+
+    RUN_TEST(test_coroutine_actor);
+
+    Director::finalize();
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    return run_ranks(run_tests, argc, argv);
+}
@@ -0,0 +1,185 @@
+#include "./super_quick_test.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "../src/director.h"
+
+using namespace ActorModel;
+
+
+/*
+ * This test is run twice, first with no arguments to record a run,
+ * then with the argument "replay" to replay it. Actors on every rank
+ * send messages at random times to a receiver on rank 0, which notes
+ * the order it sees them, and its timer firing, in each run of its
+ * main function. The replayed run should see exactly the same.
+ */
+
+const int messages_per_sender = 20;
+const int messages_per_child = 5;
+const int senders_per_rank = 2;
+
+// The receiver, known on every rank.
+ACTOR_RANK_LOCAL Id receiver_id;
+
+
+// Busy wait for a random time, so messages arrive differently
+// in every run.
+void jitter(void) {
+    double end = MPI_Wtime() + (std::rand()%200)*1e-6;
+    while(MPI_Wtime() < end);
+}
+
+class TestReplayReceiver: public Actor {
+public:
+    enum { DATA, TICK };
+
+    TestReplayReceiver(): expected(0), received(0) {}
+
+    void main(void) {
+        if(counters().runs == 0) schedule_every(0.001, TICK);
+
+        Message message;
+        while(get_message(&message)) {
+            if(message.tag() == TICK) {
+                seen.push_back(-1);
+            } else {
+                seen.push_back(message.data<int>());
+                received++;
+            }
+        }
+        seen.push_back(-2);
+
+        if(received == expected) {
+            die();
+            return;
+        }
+
+        wait_for_message();
+    }
+
+    int expected;
+    int received;
+    std::vector<int> seen;
+};
+
+class TestReplayChild: public Actor {
+public:
+    TestReplayChild(): sent(0) {}
+
+    void main(void) {
+        jitter();
+        send_message<int>(receiver_id, 1000000 + id().gid()*100 + sent, 0);
+
+        sent++;
+        if(sent == messages_per_child) die();
+    }
+
+    int sent;
+};
+
+class TestReplaySender: public Actor {
+public:
+    TestReplaySender(): sent(0) {}
+
+    void main(void) {
+        jitter();
+        send_message<int>(receiver_id, id().gid()*100 + sent, 0);
+
+        sent++;
+        if(sent == messages_per_sender) {
+            give_birth<TestReplayChild>();
+            die();
+        }
+    }
+
+    int sent;
+};
+
+
+char const *order_file = "replay_test.order";
+ACTOR_RANK_LOCAL bool replaying = false;
+
+void test_replay(void) {
+    int rank;
+    int size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    std::srand(static_cast<unsigned>(MPI_Wtime()*1e6) + rank);
+
+    Director director;
+    director.register_actor<TestReplayChild>();
+    director.set_replay_mode(
+        replaying ? Replay::REPLAY : Replay::RECORD, "replay_test"
+    );
+
+    TestReplayReceiver *receiver = NULL;
+    if(director.is_root()) {
+        receiver = director.add_actor<TestReplayReceiver>();
+        receiver->expected =
+            size*senders_per_rank*(messages_per_sender + messages_per_child);
+        receiver_id = receiver->id();
+    }
+    MPI_Bcast(&receiver_id, sizeof(Id), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+    for(int i=0; i<senders_per_rank; i++) {
+        director.add_actor<TestReplaySender>();
+    }
+
+    director.run();
+
+    if(!director.is_root()) return;
+
+    REQUIRE(receiver->is_dead());
+    REQUIRE(receiver->received == receiver->expected);
+
+    if(!replaying) {
+        std::ofstream out(order_file);
+        for(size_t i=0; i<receiver->seen.size(); i++) {
+            out << receiver->seen[i] << "\n";
+        }
+        return;
+    }
+
+    std::vector<int> recorded;
+    std::ifstream in(order_file);
+    int value;
+    while(in >> value) recorded.push_back(value);
+
+    REQUIRE(recorded == receiver->seen);
+}
+
+
+int run_tests(int argc, char* argv[]) {
+    Director::initialize(&argc, &argv);
+    Director::set_buffer_size(100000);
+
+    INIT_SQT();
+
+    replaying = (argc > 1 && std::strcmp(argv[1], "replay") == 0);
+
+    RUN_TEST(test_replay);
+
+    // Clean up once the recording has been replayed
+    if(replaying) {
+        MPI_Barrier(MPI_COMM_WORLD);
+
+        char log_file[64];
+        std::sprintf(log_file, "replay_test.%d.log", super_quick_test_rank);
+        std::remove(log_file);
+        if(super_quick_test_rank == 0) std::remove(order_file);
+    }
+
+    Director::finalize();
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    return run_ranks(run_tests, argc, argv);
+}
@@ -1,16 +1,16 @@
 #include <iostream>
 #include <cmath>
 
-#include <mpi.h>
+#include "../src/backend.h"
 
 /**
  * super_quick_test is a super lightweight (and super ugly) test framework
  * for use with MPI.
  */
 
-bool super_quick_test_check;
-MPI_Comm super_quick_test_comm;
-int super_quick_test_rank;
+ACTOR_RANK_LOCAL bool super_quick_test_check;
+ACTOR_RANK_LOCAL MPI_Comm super_quick_test_comm;
+ACTOR_RANK_LOCAL int super_quick_test_rank;
 
 #define INIT_SQT() { \
     MPI_Comm_dup(MPI_COMM_WORLD, &super_quick_test_comm); \
@@ -0,0 +1,117 @@
+#include "./super_quick_test.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#define ACTOR_TRACE
+#define ACTOR_TRACE_PREFIX "trace_test"
+
+#include "../src/director.h"
+
+using namespace ActorModel;
+
+
+class TestTraceEcho: public Actor {
+public:
+    enum { PING };
+
+    void main(void) {
+        Message message;
+        while(get_message(&message)) {
+            reply<int>(message, message.data<int>());
+            die();
+        }
+
+        wait_for_message();
+    }
+};
+
+class TestTracePinger: public Actor {
+public:
+    TestTracePinger(): asked(false) {}
+
+    void main(void) {
+        if(!asked) {
+            Id echo = give_birth<TestTraceEcho>();
+            reply_value = ask<int>(echo, 1, TestTraceEcho::PING);
+            asked = true;
+        }
+
+        if(reply_value.ready()) {
+            reply_value.get();
+            die();
+        }
+    }
+
+    bool asked;
+    Future<int> reply_value;
+};
+
+
+// Read in the trace written by this process, and remove it.
+std::string read_trace(int rank) {
+    std::ostringstream filename;
+    filename << "trace_test." << rank << ".json";
+
+    std::ifstream in(filename.str().c_str());
+    std::stringstream contents;
+    contents << in.rdbuf();
+    in.close();
+
+    std::remove(filename.str().c_str());
+
+    return contents.str();
+}
+
+
+void test_trace(void) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    {
+        Director director;
+        director.register_actor<TestTraceEcho>();
+        director.register_actor<TestTracePinger>();
+
+        if(director.is_root()) {
+            director.add_actor<TestTracePinger>();
+        }
+
+        director.run();
+    }
+
+    std::string trace = read_trace(rank);
+
+    REQUIRE(trace.find("[") == 0);
+    REQUIRE(trace.rfind("}\n]\n") == trace.size() - 4);
+    REQUIRE(trace.find("\"name\":\"sync\"") != std::string::npos);
+
+    if(rank == 0) {
+        REQUIRE(trace.find("\"name\":\"run TestTracePinger\"") != std::string::npos);
+        REQUIRE(trace.find("\"name\":\"birth request\"") != std::string::npos);
+
+        // The request starts a flow, and the reply ends one
+        REQUIRE(trace.find("\"ph\":\"s\"") != std::string::npos);
+        REQUIRE(trace.find("\"ph\":\"f\"") != std::string::npos);
+    }
+}
+
+
+int run_tests(int argc, char* argv[]) {
+    Director::initialize(&argc, &argv);
+    Director::set_buffer_size(1000*sizeof(int));
+
+    INIT_SQT();
+
+    RUN_TEST(test_trace);
+
+    Director::finalize();
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    return run_ranks(run_tests, argc, argv);
+}